@@ -0,0 +1,205 @@
+// Bounding volume hierarchy on spheres whose radii span orders of
+// magnitude, where a uniform grid or column size fits none of them. Moves a
+// gas with reflecting walls frame by frame and times AabbTree::update()
+// plus findContacts() against SweepAndPrune::update(), reporting how often
+// the tree refitted and rebuilt, and checks that both find the same
+// contacts. Then times a batch of picking rays and a frustum culling query
+// on the same tree and checks samples of both against brute force.
+//
+// Usage: aabb-tree-benchmark [particles] [frames] [radius ratio] [rays]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "AabbTree.h"
+#include "BenchmarkCommon.h"
+#include "CounterRandom.h"
+#include "ParticleSystem.h"
+#include "SweepAndPrune.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2025;
+    const double MIN_RADIUS = 0.1;
+    const double VOLUME_FRACTION = 0.1;
+    const double FRAME_STEP = 0.01;
+    const std::size_t CHECKED_RAYS = 200;
+
+    // Log-uniform radii in [MIN_RADIUS, ratio MIN_RADIUS], from a stream the gas factory leaves free
+    std::vector<double> makeRadii(std::size_t count, double ratio)
+    {
+        const CounterRandom random(SEED);
+        std::vector<double> radii(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            double u[2];
+            random.uniform(i, 4, u);
+            radii[i] = MIN_RADIUS * std::pow(ratio, u[0]);
+        }
+        return radii;
+    }
+
+    // Pairs as sorted (lower, higher) keys, for comparing broad phases
+    std::vector<std::uint64_t> canonical(const std::vector<CollisionPair> &pairs)
+    {
+        std::vector<std::uint64_t> keys;
+        keys.reserve(pairs.size());
+        for (const CollisionPair &pair : pairs)
+        {
+            keys.push_back(static_cast<std::uint64_t>(std::min(pair.i, pair.j)) << 32 | std::max(pair.i, pair.j));
+        }
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Nearest sphere along a ray by testing every particle
+    RayHit bruteRaycast(const ParticleSystem &system, const Ray &ray)
+    {
+        RayHit best;
+        const Vector3Array &p = system.getPositions();
+        const double a = ray.direction.getX() * ray.direction.getX() + ray.direction.getY() * ray.direction.getY() + ray.direction.getZ() * ray.direction.getZ();
+        for (std::size_t i = 0; i < system.size(); i++)
+        {
+            const double o[3] = {ray.origin.getX() - p.x[i], ray.origin.getY() - p.y[i], ray.origin.getZ() - p.z[i]};
+            const double b = o[0] * ray.direction.getX() + o[1] * ray.direction.getY() + o[2] * ray.direction.getZ();
+            const double r = system.getRadius(i);
+            const double c = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] - r * r;
+            const double discriminant = b * b - a * c;
+            if (discriminant < 0.0)
+            {
+                continue;
+            }
+            const double t = c <= 0.0 ? 0.0 : (-b - std::sqrt(discriminant)) / a;
+            if (t >= 0.0 && t <= ray.maxDistance && (!best.isHit() || t < best.distance))
+            {
+                best.particle = static_cast<std::uint32_t>(i);
+                best.distance = t;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t count = argc > 1 ? static_cast<std::size_t>(std::atof(argv[1])) : 200000;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+    const double ratio = argc > 3 ? std::atof(argv[3]) : 100.0;
+    const std::size_t rayCount = argc > 4 ? static_cast<std::size_t>(std::atof(argv[4])) : 100000;
+
+    Benchmark::GasOptions gas;
+    gas.volumeFraction = VOLUME_FRACTION;
+    gas.seed = SEED;
+    double box = 0.0;
+    ParticleSystem system = Benchmark::makeGas(makeRadii(count, ratio), gas, box);
+    std::printf("threads: %zu, %zu spheres of radius %g to %g, volume fraction %g, box %.1f\n", ThreadPool::global().size(), count, MIN_RADIUS,
+                MIN_RADIUS * ratio, VOLUME_FRACTION, box);
+
+    AabbTree tree;
+    SweepAndPrune sweepAndPrune;
+    std::vector<CollisionPair> contacts;
+    auto start = std::chrono::steady_clock::now();
+    tree.update(system);
+    const double buildMilliseconds = millisecondsSince(start);
+    std::printf("initial build: %.2f ms, %zu nodes, SAH cost %.1f\n", buildMilliseconds, tree.nodeCount(), tree.getStatistics().cost);
+    tree.resetStatistics();
+
+    double treeMilliseconds = 0.0, sweepMilliseconds = 0.0, contactCount = 0.0, escapes = 0.0;
+    std::size_t mismatches = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        Benchmark::advance(system, box, FRAME_STEP);
+        start = std::chrono::steady_clock::now();
+        tree.update(system);
+        tree.findContacts(contacts);
+        treeMilliseconds += millisecondsSince(start);
+        escapes += static_cast<double>(tree.getStatistics().escapes);
+
+        start = std::chrono::steady_clock::now();
+        sweepAndPrune.update(system);
+        sweepMilliseconds += millisecondsSince(start);
+
+        contactCount += static_cast<double>(contacts.size());
+        if (canonical(contacts) != canonical(sweepAndPrune.getContacts()))
+        {
+            mismatches++;
+        }
+    }
+    const AabbTreeStatistics &statistics = tree.getStatistics();
+    std::printf("%12s %12s %10s %10s %8s %10s %10s\n", "tree ms", "sap ms", "contacts", "escapes", "refits", "rebuilds", "cost");
+    std::printf("%12.2f %12.2f %10.0f %10.0f %8zu %10zu %10.1f\n", treeMilliseconds / frames, sweepMilliseconds / frames, contactCount / frames,
+                escapes / frames, statistics.refits, statistics.rebuilds, statistics.cost);
+    std::printf("contacts: %s on %d frames\n", mismatches == 0 ? "tree and sweep-and-prune match" : "MISMATCH", frames - static_cast<int>(mismatches));
+
+    // Picking: rays from random points in random directions
+    const CounterRandom random(SEED + 1);
+    std::vector<Ray> rays(rayCount);
+    for (std::size_t q = 0; q < rayCount; q++)
+    {
+        double u[4], n[4];
+        random.uniform(q, 0, u);
+        random.uniform(q, 1, u + 2);
+        random.normal(q, 2, n);
+        random.normal(q, 3, n + 2);
+        rays[q].origin = Vector3d(u[0] * box, u[1] * box, u[2] * box);
+        rays[q].direction = Vector3d(n[0], n[1], n[2]);
+    }
+    std::vector<RayHit> hits;
+    start = std::chrono::steady_clock::now();
+    tree.raycast(rays, hits);
+    const double rayMilliseconds = millisecondsSince(start);
+    std::size_t picked = 0, rayMismatches = 0;
+    for (const RayHit &hit : hits)
+    {
+        picked += hit.isHit() ? 1 : 0;
+    }
+    for (std::size_t q = 0; q < std::min(CHECKED_RAYS, rayCount); q++)
+    {
+        const RayHit reference = bruteRaycast(system, rays[q]);
+        if (reference.isHit() != hits[q].isHit() || (reference.isHit() && std::fabs(reference.distance - hits[q].distance) > 1e-9 * box))
+        {
+            rayMismatches++;
+        }
+    }
+    std::printf("picking: %zu rays in %.2f ms (%.0f ns/ray), %zu hits, %zu of %zu checked against brute force %s\n", rayCount, rayMilliseconds,
+                1e6 * rayMilliseconds / std::max<std::size_t>(rayCount, 1), picked, std::min(CHECKED_RAYS, rayCount),
+                std::min(CHECKED_RAYS, rayCount), rayMismatches == 0 ? "match" : "MISMATCH");
+
+    // Culling: a view frustum from the middle of the -z face towards +z with a 60 degree opening
+    const double c = box / 2.0, s = std::sqrt(0.75), h = 0.5;
+    const std::vector<Plane> frustum = {{Vector3d(s, 0, h), -s * c},
+                                        {Vector3d(-s, 0, h), s * c},
+                                        {Vector3d(0, s, h), -s * c},
+                                        {Vector3d(0, -s, h), s * c},
+                                        {Vector3d(0, 0, 1), 0.0},
+                                        {Vector3d(0, 0, -1), box}};
+    std::vector<std::uint32_t> visible;
+    start = std::chrono::steady_clock::now();
+    tree.queryPlanes(frustum, visible);
+    const double cullMilliseconds = millisecondsSince(start);
+    std::size_t reference = 0;
+    const Vector3Array &p = system.getPositions();
+    for (std::size_t i = 0; i < system.size(); i++)
+    {
+        bool inside = true;
+        for (const Plane &plane : frustum)
+        {
+            const double length = std::sqrt(plane.normal.getX() * plane.normal.getX() + plane.normal.getY() * plane.normal.getY() + plane.normal.getZ() * plane.normal.getZ());
+            inside = inside && plane.normal.getX() * p.x[i] + plane.normal.getY() * p.y[i] + plane.normal.getZ() * p.z[i] + plane.offset >= -system.getRadius(i) * length;
+        }
+        reference += inside ? 1 : 0;
+    }
+    std::printf("culling: %zu of %zu visible in %.2f ms, brute force %zu (%s)\n", visible.size(), count, cullMilliseconds, reference,
+                visible.size() == reference ? "match" : "MISMATCH");
+    return 0;
+}
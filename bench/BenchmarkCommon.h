@@ -0,0 +1,230 @@
+#pragma once
+
+// Scenes and measurements shared by the command line benchmarks
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include "ConservationMonitor.h"
+#include "CounterRandom.h"
+#include "ForceModel.h"
+#include "Integrator.h"
+#include "ParticleSystem.h"
+
+namespace Benchmark
+{
+    // Lennard-Jones fcc lattice constant at the triple point density
+    const double LJ_LATTICE_CONSTANT = 1.6796;
+
+    const double PI = 3.14159265358979323846;
+
+    // Volume of the unit sphere
+    const double UNIT_SPHERE_VOLUME = 4.0 * PI / 3.0;
+
+    // How makeLattice() perturbs the perfect lattice
+    struct LatticeOptions
+    {
+        double jitter = 0.0;      // each coordinate displaced uniformly by up to this share of the lattice constant
+        double temperature = 0.0; // Maxwell-Boltzmann velocities at this kT; 0 leaves the particles at rest
+        std::uint64_t seed = 2024;
+    };
+
+    // fcc lattice of `cells`^3 unit cells with lattice constant a, of
+    // unit-mass neutral particles. Random draws are keyed by particle index,
+    // so the same options give the same system on any thread count.
+    inline ParticleSystem makeLattice(int cells, double a, const LatticeOptions &options = LatticeOptions())
+    {
+        static const double basis[4][3] = {{0.0, 0.0, 0.0}, {0.5, 0.5, 0.0}, {0.5, 0.0, 0.5}, {0.0, 0.5, 0.5}};
+        const CounterRandom random(options.seed);
+        const double sigma = std::sqrt(options.temperature);
+        ParticleSystem system;
+        system.reserve(4 * static_cast<std::size_t>(cells) * cells * cells);
+        for (int x = 0; x < cells; x++)
+        {
+            for (int y = 0; y < cells; y++)
+            {
+                for (int z = 0; z < cells; z++)
+                {
+                    for (const double *b : basis)
+                    {
+                        const std::size_t i = system.size();
+                        double u[4] = {0.5, 0.5, 0.5, 0.5}, n[4] = {0.0, 0.0, 0.0, 0.0};
+                        if (options.jitter > 0.0)
+                        {
+                            random.uniform(i, 2, u);
+                            random.uniform(i, 3, u + 2);
+                        }
+                        if (options.temperature > 0.0)
+                        {
+                            random.normal(i, 0, n);
+                            random.normal(i, 1, n + 2);
+                        }
+                        const double d = 2.0 * options.jitter * a;
+                        const Vector3 position(static_cast<Real>((x + b[0]) * a + d * (u[0] - 0.5)), static_cast<Real>((y + b[1]) * a + d * (u[1] - 0.5)),
+                                               static_cast<Real>((z + b[2]) * a + d * (u[2] - 0.5)));
+                        const Vector3 velocity(static_cast<Real>(sigma * n[0]), static_cast<Real>(sigma * n[1]), static_cast<Real>(sigma * n[2]));
+                        system.add(position, velocity, Vector3(), Vector3(1, 1, 1), Real(1), Real(0.01), Real(0), "");
+                    }
+                }
+            }
+        }
+        return system;
+    }
+
+    // How makeGas() fills its box
+    struct GasOptions
+    {
+        double volumeFraction = 0.2; // sphere volume over box volume
+        double speed = 1.0;          // standard deviation of every velocity component
+        int massClasses = 1;         // masses 1, 2, ..., massClasses cycled over the particles
+        std::uint64_t seed = 2024;
+    };
+
+    // Neutral spheres of the given radii at uniformly random positions in the
+    // cube [0, box)^3, sized for the volume fraction, with Gaussian velocities.
+    // Draws use streams 0 to 3 of each particle; callers may key others from 4 on.
+    inline ParticleSystem makeGas(const std::vector<double> &radii, const GasOptions &options, double &box)
+    {
+        const CounterRandom random(options.seed);
+        double volume = 0.0;
+        for (double r : radii)
+        {
+            volume += UNIT_SPHERE_VOLUME * r * r * r;
+        }
+        box = std::cbrt(volume / options.volumeFraction);
+        ParticleSystem system;
+        system.reserve(radii.size());
+        for (std::size_t i = 0; i < radii.size(); i++)
+        {
+            double u[4], n[4];
+            random.uniform(i, 0, u);
+            random.uniform(i, 1, u + 2);
+            random.normal(i, 2, n);
+            random.normal(i, 3, n + 2);
+            const Vector3 position(static_cast<Real>(u[0] * box), static_cast<Real>(u[1] * box), static_cast<Real>(u[2] * box));
+            const Vector3 velocity(static_cast<Real>(options.speed * n[0]), static_cast<Real>(options.speed * n[1]), static_cast<Real>(options.speed * n[2]));
+            system.add(position, velocity, Vector3(), Vector3(1, 1, 1), static_cast<Real>(1 + i % options.massClasses), static_cast<Real>(radii[i]), Real(0),
+                       "");
+        }
+        return system;
+    }
+
+    // Free flight over time h with specular reflection at the walls of [0, box)^3
+    inline void advance(ParticleSystem &system, double box, double h)
+    {
+        AlignedVector<Real> *positions[3] = {&system.getPositions().x, &system.getPositions().y, &system.getPositions().z};
+        AlignedVector<Real> *velocities[3] = {&system.getVelocities().x, &system.getVelocities().y, &system.getVelocities().z};
+        for (int a = 0; a < 3; a++)
+        {
+            AlignedVector<Real> &p = *positions[a];
+            AlignedVector<Real> &v = *velocities[a];
+            for (std::size_t i = 0; i < system.size(); i++)
+            {
+                p[i] += static_cast<Real>(v[i] * h);
+                if ((p[i] < 0 && v[i] < 0) || (p[i] >= box && v[i] > 0))
+                {
+                    v[i] = -v[i];
+                }
+            }
+        }
+    }
+
+    // Total kinetic energy; the total momentum goes to `momentum`
+    inline double kineticEnergy(const ParticleSystem &system, double momentum[3])
+    {
+        const Vector3Array &v = system.getVelocities();
+        double energy = 0.0;
+        momentum[0] = momentum[1] = momentum[2] = 0.0;
+        for (std::size_t i = 0; i < system.size(); i++)
+        {
+            const double m = system.getMasses()[i];
+            energy += 0.5 * m * (static_cast<double>(v.x[i]) * v.x[i] + static_cast<double>(v.y[i]) * v.y[i] + static_cast<double>(v.z[i]) * v.z[i]);
+            momentum[0] += m * v.x[i];
+            momentum[1] += m * v.y[i];
+            momentum[2] += m * v.z[i];
+        }
+        return energy;
+    }
+
+    // Gaussian cloud of unit-mass ions and electrons with unit charges
+    inline ParticleSystem makePlasma(std::size_t n, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        ParticleSystem system;
+        system.reserve(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const Vector3 position(static_cast<Real>(normal(rng)), static_cast<Real>(normal(rng)), static_cast<Real>(normal(rng)));
+            const Real charge = (i & 1) ? Real(-1) : Real(1);
+            system.add(position, Vector3(), Vector3(), Vector3(1, 1, 1), Real(1), Real(0.01), charge, "");
+        }
+        return system;
+    }
+
+    // Best wall time of `repeats` force evaluations, in milliseconds
+    inline double timeForces(ForceModel &forces, ParticleSystem &system, int repeats)
+    {
+        double best = 0.0;
+        for (int r = 0; r < repeats; r++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            forces.computeAccelerations(system);
+            const auto stop = std::chrono::steady_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+            best = (r == 0 || ms < best) ? ms : best;
+        }
+        return best;
+    }
+
+    struct MonitoredRun
+    {
+        double milliseconds;
+        double energyDrift; // relative, over the whole run
+    };
+
+    // `steps` timed steps of `deltaTime` under a ConservationMonitor that
+    // never raises alarms; afterStep() runs inside the timed loop after
+    // every step, for the caller's own bookkeeping
+    template <typename AfterStep>
+    MonitoredRun runMonitored(Integrator &integrator, ParticleSystem &system, ForceModel &forces, int steps, double deltaTime, AfterStep afterStep)
+    {
+        ConservationTolerances tolerances;
+        tolerances.energy = tolerances.momentum = std::numeric_limits<double>::infinity();
+        ConservationMonitor monitor(tolerances);
+        integrator.setMonitor(&monitor);
+        const auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+        {
+            integrator.step(system, forces, deltaTime);
+            afterStep();
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        integrator.setMonitor(nullptr);
+        return {std::chrono::duration<double, std::milli>(stop - start).count(), monitor.energyDrift()};
+    }
+
+    inline MonitoredRun runMonitored(Integrator &integrator, ParticleSystem &system, ForceModel &forces, int steps, double deltaTime)
+    {
+        return runMonitored(integrator, system, forces, steps, deltaTime, [] {});
+    }
+
+    // |a - a_ref| / |a_ref| over all particles
+    inline double relativeError(const ParticleSystem &system, const ParticleSystem &reference)
+    {
+        double error = 0.0, norm = 0.0;
+        for (std::size_t i = 0; i < system.size(); i++)
+        {
+            const Vector3 a = system[i].getAcceleration();
+            const Vector3 ref = reference[i].getAcceleration();
+            const Vector3 d = a - ref;
+            error += d.dot(d);
+            norm += ref.dot(ref);
+        }
+        return norm > 0.0 ? std::sqrt(error / norm) : 0.0;
+    }
+}
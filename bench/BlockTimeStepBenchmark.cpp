@@ -0,0 +1,168 @@
+// Block time steps on an atom-plus-ion-cloud scene: a few hydrogen-like
+// atoms, whose electrons need a small step, inside a large cloud of slow
+// ions. Runs velocity Verlet at the step the electrons need and block time
+// stepping with the same finest step, and reports the wall time, the number
+// of particle accelerations computed, the relative energy drift, the
+// finest level used in any step and how often a particle wanted a finer
+// step than maxLevel allows. The softening is the ion radius, so close ion
+// pairs stay resolvable; the defaults keep both drifts below the monitor's
+// 1e-3 tolerance.
+//
+// Usage: block-timestep-benchmark [ions] [atoms] [block steps]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "BenchmarkCommon.h"
+#include "CoulombForce.h"
+#include "CounterRandom.h"
+#include "Integrator.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2024;
+    const double CLOUD_RADIUS = 5.0;
+    const double ORBIT_RADIUS = 0.05;
+    const double ION_MASS = 50.0;
+    const double NUCLEUS_MASS = 1836.0;
+    const double ION_SPEED = 0.05;
+    const double SOFTENING = 0.02;
+
+    // Normal 3-vector of particle `n` from stream `stream`
+    Vector3d normal3(const CounterRandom &random, std::uint64_t n, std::uint64_t stream)
+    {
+        double v[4];
+        random.normal(n, 2 * stream, v);
+        random.normal(n, 2 * stream + 1, v + 2);
+        return Vector3d(v[0], v[1], v[2]);
+    }
+
+    // Point uniformly distributed in the cloud sphere
+    Vector3d inCloud(const CounterRandom &random, std::uint64_t n)
+    {
+        double u[2];
+        random.uniform(n, 0, u);
+        const Vector3d direction = normal3(random, n, 1).normalize();
+        return direction * (CLOUD_RADIUS * std::cbrt(u[0]));
+    }
+
+    ParticleSystem makeScene(std::size_t ions, std::size_t atoms)
+    {
+        const CounterRandom random(SEED);
+        ParticleSystem system;
+        system.reserve(ions + 2 * atoms);
+        for (std::size_t i = 0; i < ions; i++)
+        {
+            const Vector3d position = inCloud(random, i);
+            const Vector3d velocity = normal3(random, i, 2) * ION_SPEED;
+            system.add(Vector3(position), Vector3(velocity), Vector3(), Vector3(1, 1, 1), static_cast<Real>(ION_MASS), Real(0.02),
+                       (i & 1) ? Real(-1) : Real(1), "");
+        }
+
+        // Electron in a circular orbit around its nucleus in the softened
+        // potential, the pair moving with the cloud
+        const double reducedMass = NUCLEUS_MASS / (NUCLEUS_MASS + 1.0);
+        const double softened = ORBIT_RADIUS * ORBIT_RADIUS + SOFTENING * SOFTENING;
+        const double orbitSpeed = ORBIT_RADIUS * std::sqrt(1.0 / (reducedMass * softened * std::sqrt(softened)));
+        for (std::size_t a = 0; a < atoms; a++)
+        {
+            const std::uint64_t n = ions + a;
+            const Vector3d center = inCloud(random, n);
+            const Vector3d drift = normal3(random, n, 2) * ION_SPEED;
+            const Vector3d offset = normal3(random, n, 3).normalize() * ORBIT_RADIUS;
+            const Vector3d along = offset.cross(normal3(random, n, 4)).normalize() * orbitSpeed;
+            system.add(Vector3(center), Vector3(Vector3d(drift - along * (1.0 - reducedMass))), Vector3(), Vector3(1, 0, 0),
+                       static_cast<Real>(NUCLEUS_MASS), Real(0.02), Real(1), "");
+            system.add(Vector3(Vector3d(center + offset)), Vector3(Vector3d(drift + along * reducedMass)), Vector3(), Vector3(0, 0, 1),
+                       Real(1), Real(0.01), Real(-1), "");
+        }
+        return system;
+    }
+
+    struct Result
+    {
+        double milliseconds;
+        std::size_t accelerations;
+        double energyDrift;
+        int deepestLevel;    // block time steps only: finest level used in any step
+        std::size_t clamped; // block time steps only: level choices held at maxLevel
+    };
+
+    // `steps` steps of `deltaTime`; `accelerations` counts particle accelerations computed
+    Result run(Integrator &integrator, ParticleSystem &system, ForceModel &forces, int steps, double deltaTime)
+    {
+        const BlockTimeStepIntegrator *block = dynamic_cast<const BlockTimeStepIntegrator *>(&integrator);
+        Result result = {0.0, 0, 0.0, 0, 0};
+        auto count = [&]()
+        {
+            if (block)
+            {
+                result.accelerations += block->getActiveEvaluations();
+                result.deepestLevel = std::max(result.deepestLevel, block->getDeepestLevel());
+                result.clamped += block->getClampedSelections();
+            }
+            else
+            {
+                result.accelerations += system.size() * integrator.forceEvaluationsPerStep();
+            }
+        };
+        const Benchmark::MonitoredRun monitored = Benchmark::runMonitored(integrator, system, forces, steps, deltaTime, count);
+        result.milliseconds = monitored.milliseconds;
+        result.energyDrift = monitored.energyDrift;
+        return result;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t ions = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000;
+    const std::size_t atoms = argc > 2 ? static_cast<std::size_t>(std::strtoull(argv[2], nullptr, 10)) : 20;
+    const int blockSteps = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    CoulombParameters coulomb;
+    coulomb.coulombConstant = 1.0;
+    coulomb.softening = SOFTENING;
+    BlockTimeStepParameters parameters;
+    parameters.maxLevel = 8;
+    parameters.lengthScale = 0.01; // a fifth of the orbit radius
+    const double deltaTime = 0.01;
+
+    std::printf("threads: %zu, %zu ions, %zu atoms, %d steps of %g\n", ThreadPool::global().size(), ions, atoms, blockSteps, deltaTime);
+    std::printf("%12s %12s %16s %14s %12s\n", "integrator", "step", "accelerations", "time (ms)", "energy drift");
+
+    // Block time steps first, to find the finest level used in any step
+    ParticleSystem blockSystem = makeScene(ions, atoms);
+    CoulombForce blockForces(coulomb);
+    BlockTimeStepIntegrator block(parameters);
+    const Result blocked = run(block, blockSystem, blockForces, blockSteps, deltaTime);
+    std::size_t levelCounts[32] = {};
+    for (std::uint8_t level : block.getLevels())
+    {
+        levelCounts[level]++;
+    }
+    std::printf("%12s %12g %16zu %14.1f %12.2e\n", block.name(), deltaTime, blocked.accelerations, blocked.milliseconds, blocked.energyDrift);
+
+    // Velocity Verlet with the finest step of the block run
+    const int finest = blocked.deepestLevel;
+    const double fineStep = std::ldexp(deltaTime, -finest);
+    ParticleSystem globalSystem = makeScene(ions, atoms);
+    CoulombForce globalForces(coulomb);
+    VelocityVerletIntegrator verlet;
+    const Result global = run(verlet, globalSystem, globalForces, blockSteps << finest, fineStep);
+    std::printf("%12s %12g %16zu %14.1f %12.2e\n", verlet.name(), fineStep, global.accelerations, global.milliseconds, global.energyDrift);
+
+    std::printf("levels at the end:");
+    for (int level = 0; level <= parameters.maxLevel; level++)
+    {
+        std::printf(" %d: %zu", level, levelCounts[level]);
+    }
+    std::printf("\ndeepest level: %d, level choices clamped at maxLevel: %zu%s\n", finest, blocked.clamped,
+                blocked.clamped > 0 ? " (UNDER-RESOLVED: raise maxLevel)" : "");
+    std::printf("force evaluations saved: %.1fx, speedup: %.1fx\n",
+                static_cast<double>(global.accelerations) / blocked.accelerations, global.milliseconds / blocked.milliseconds);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Hard-sphere collisions of a gas of equal spheres in a box with
+// reflecting walls. Advances the particles frame by frame and times
+// CollisionSystem::resolve(): detection (sweep-and-prune broad phase and
+// narrow phase) and response. Reports the time per frame, the candidate
+// pairs and contacts per frame, how often the order had to be rebuilt and
+// the change of kinetic energy, and checks the contacts of the first and
+// the last frame against a linked-cell pair search.
+//
+// Usage: collision-benchmark [particles] [frames] [restitution]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "BenchmarkCommon.h"
+#include "CellGrid.h"
+#include "Collisions.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const double RADIUS = 0.5;
+    const double VOLUME_FRACTION = 0.2;
+    const double FRAME_STEP = 0.01;
+
+    // Compare the broad phase's contacts at the current positions with a linked-cell pair search
+    void check(const char *label, SweepAndPrune &broadPhase, const ParticleSystem &system)
+    {
+        broadPhase.update(system);
+        CellGrid grid(2.0 * RADIUS);
+        grid.build(system);
+        std::size_t reference = 0;
+        grid.forEachPair([&](std::uint32_t, std::uint32_t, double, double, double, double)
+                         { reference++; });
+        const std::size_t found = broadPhase.getStatistics().contacts;
+        std::printf("%s contacts: sweep-and-prune %zu, cell grid %zu (%s)\n", label, found, reference, found == reference ? "match" : "MISMATCH");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t count = argc > 1 ? static_cast<std::size_t>(std::atof(argv[1])) : 1000000;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+    const double restitution = argc > 3 ? std::atof(argv[3]) : 1.0;
+
+    // Equal spheres of three masses
+    Benchmark::GasOptions gas;
+    gas.volumeFraction = VOLUME_FRACTION;
+    gas.massClasses = 3;
+    double box = 0.0;
+    ParticleSystem system = Benchmark::makeGas(std::vector<double>(count, RADIUS), gas, box);
+    std::printf("threads: %zu, %zu spheres of radius %g, volume fraction %g, box %.1f\n", ThreadPool::global().size(), count, RADIUS,
+                VOLUME_FRACTION, box);
+
+    CollisionParameters parameters;
+    parameters.restitution = restitution;
+    CollisionSystem collisions(parameters);
+    check("first frame", collisions.getSweepAndPrune(), system);
+    collisions.getSweepAndPrune().resetStatistics();
+
+    double momentumBefore[3], momentumAfter[3];
+    const double energyBefore = Benchmark::kineticEnergy(system, momentumBefore);
+    double milliseconds = 0.0, candidates = 0.0, contacts = 0.0, impulses = 0.0, dissipated = 0.0;
+    for (int f = 0; f < frames; f++)
+    {
+        Benchmark::advance(system, box, FRAME_STEP);
+        const auto start = std::chrono::steady_clock::now();
+        collisions.resolve(system);
+        const auto stop = std::chrono::steady_clock::now();
+        milliseconds += std::chrono::duration<double, std::milli>(stop - start).count();
+        candidates += static_cast<double>(collisions.getSweepAndPrune().getStatistics().candidates);
+        contacts += static_cast<double>(collisions.getStatistics().contacts);
+        impulses += static_cast<double>(collisions.getStatistics().impulses);
+        dissipated += collisions.getStatistics().dissipatedEnergy;
+    }
+    const double energyAfter = Benchmark::kineticEnergy(system, momentumAfter);
+    const SweepAndPruneStatistics statistics = collisions.getSweepAndPrune().getStatistics();
+    double momentumChange = 0.0;
+    for (int a = 0; a < 3; a++)
+    {
+        momentumChange = std::fmax(momentumChange, std::fabs(momentumAfter[a] - momentumBefore[a]));
+    }
+
+    std::printf("%10s %12s %12s %12s %10s %14s\n", "ms/frame", "candidates", "contacts", "impulses", "full sorts", "moves/particle");
+    std::printf("%10.2f %12.0f %12.0f %12.0f %10zu %14.3f\n", milliseconds / frames, candidates / frames, contacts / frames, impulses / frames,
+                statistics.fullSorts, static_cast<double>(statistics.moves) / (static_cast<double>(count) * frames));
+    Benchmark::advance(system, box, FRAME_STEP);
+    check("last frame", collisions.getSweepAndPrune(), system);
+    std::printf("kinetic energy: %.6e -> %.6e (relative change %.2e, dissipated %.2e), |dP| = %.2e (walls exchange momentum)\n", energyBefore,
+                energyAfter, (energyAfter - energyBefore) / energyBefore, dissipated / energyBefore, momentumChange);
+    return 0;
+}
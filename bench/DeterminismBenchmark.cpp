@@ -0,0 +1,110 @@
+// Cost of the bitwise-reproducible mode: runs the same velocity Verlet
+// trajectory with the fast (per-thread buffer) and the deterministic force
+// accumulation, and reports the time per step plus a hash of the final
+// state. Deterministic hashes match for every ATOM_THREADS value; the fast
+// ones generally do not.
+//
+// Usage: determinism-benchmark [lattice cells per axis] [steps] [coulomb particles]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "BenchmarkCommon.h"
+#include "CoulombForce.h"
+#include "Integrator.h"
+#include "PairPotentialForce.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2024;
+
+    // FNV-1a over the bytes of positions and velocities
+    std::uint64_t stateHash(const ParticleSystem &system)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](const AlignedVector<Real> &values)
+        {
+            for (Real v : values)
+            {
+                unsigned char bytes[sizeof(Real)];
+                std::memcpy(bytes, &v, sizeof(Real));
+                for (unsigned char b : bytes)
+                {
+                    hash = (hash ^ b) * 1099511628211ull;
+                }
+            }
+        };
+        for (const Vector3Array *a : {&system.getPositions(), &system.getVelocities()})
+        {
+            mix(a->x);
+            mix(a->y);
+            mix(a->z);
+        }
+        return hash;
+    }
+
+    // Milliseconds per step of `steps` velocity Verlet steps
+    double run(ParticleSystem &system, ForceModel &forces, int steps, double dt)
+    {
+        VelocityVerletIntegrator integrator;
+        const auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+        {
+            integrator.step(system, forces, dt);
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / steps;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int cells = argc > 1 ? std::atoi(argv[1]) : 24;
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 50;
+    const std::size_t plasmaCount = argc > 3 ? static_cast<std::size_t>(std::strtoull(argv[3], nullptr, 10)) : 8000;
+    const ForceAccumulation modes[] = {ForceAccumulation::ThreadBuffers, ForceAccumulation::Deterministic};
+
+    std::printf("threads: %zu\n", ThreadPool::global().size());
+    std::printf("%14s %10s %14s %14s %10s %18s\n", "workload", "particles", "mode", "ms / step", "overhead", "state hash");
+
+    // Lennard-Jones liquid from a melting fcc lattice, periodic box
+    const double a = Benchmark::LJ_LATTICE_CONSTANT;
+    PairPotentialParameters lj;
+    lj.domain = Domain::periodicBox(Vector3d(0, 0, 0), Vector3d(cells * a, cells * a, cells * a));
+    Benchmark::LatticeOptions melting;
+    melting.temperature = 1.5;
+    melting.seed = SEED;
+    double fastTime = 0.0;
+    for (ForceAccumulation mode : modes)
+    {
+        lj.accumulation = mode;
+        PairPotentialForce pair(lj);
+        pair.setLennardJones(0, 1.0, 1.0);
+        ParticleSystem system = Benchmark::makeLattice(cells, a, melting);
+        const double time = run(system, pair, steps, 0.002);
+        fastTime = mode == ForceAccumulation::ThreadBuffers ? time : fastTime;
+        std::printf("%14s %10zu %14s %14.2f %9.1f%% %18llx\n", "lennard-jones", system.size(), forceAccumulationName(mode), time,
+                    100.0 * (time / fastTime - 1.0), static_cast<unsigned long long>(stateHash(system)));
+    }
+
+    // Direct Coulomb on a neutral plasma
+    CoulombParameters coulomb;
+    coulomb.coulombConstant = 1.0;
+    coulomb.softening = 1e-2;
+    for (ForceAccumulation mode : modes)
+    {
+        CoulombForce direct(coulomb);
+        direct.setAccumulation(mode);
+        ParticleSystem system = Benchmark::makePlasma(plasmaCount, static_cast<unsigned>(SEED));
+        const int plasmaSteps = std::max(1, steps / 10);
+        const double time = run(system, direct, plasmaSteps, 1e-4);
+        fastTime = mode == ForceAccumulation::ThreadBuffers ? time : fastTime;
+        std::printf("%14s %10zu %14s %14.2f %9.1f%% %18llx\n", "coulomb", system.size(), forceAccumulationName(mode), time,
+                    100.0 * (time / fastTime - 1.0), static_cast<unsigned long long>(stateHash(system)));
+    }
+    return 0;
+}
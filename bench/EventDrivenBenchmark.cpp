@@ -0,0 +1,137 @@
+// Event-driven hard-sphere gas in a periodic box. Starts the spheres on a
+// cubic lattice with Maxwellian velocities, lets the lattice melt for
+// WARMUP time units, runs EventDrivenSimulation for a number of frames and
+// reports collisions and events per second, the cell crossings and stale
+// events per collision, the drift of kinetic energy and momentum, and the
+// collision rate against the Enskog prediction. At the end a linked-cell
+// search checks that no two spheres overlap: no collision was missed.
+// Below restitution 1 the gas cools, and the impacts made elastic to
+// prevent inelastic collapse are reported.
+//
+// Usage: event-driven-benchmark [particles] [volume fraction] [duration] [frames] [restitution]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "BenchmarkCommon.h"
+#include "CellGrid.h"
+#include "CounterRandom.h"
+#include "Domain.h"
+#include "EventDrivenSimulation.h"
+#include "ParticleSystem.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2026;
+    const double RADIUS = 0.5;
+    const double OVERLAP_TOLERANCE = 1e-9; // relative to the diameter
+    const double WARMUP = 2.0;             // a few collision times at the default volume fraction
+
+    // Spheres on a cubic lattice filling a periodic box sized for the volume
+    // fraction, with unit-temperature Maxwellian velocities of zero total momentum
+    ParticleSystem makeGas(std::size_t count, double volumeFraction, double &box)
+    {
+        const CounterRandom random(SEED);
+        box = std::cbrt(count * Benchmark::UNIT_SPHERE_VOLUME * RADIUS * RADIUS * RADIUS / volumeFraction);
+        const std::size_t side = static_cast<std::size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+        const double spacing = box / side;
+        ParticleSystem system;
+        system.reserve(count);
+        double momentum[3] = {0.0, 0.0, 0.0};
+        for (std::size_t i = 0; i < count; i++)
+        {
+            double n[4];
+            random.normal(i, 0, n);
+            random.normal(i, 1, n + 2);
+            const Vector3 position(static_cast<Real>((i % side + 0.5) * spacing), static_cast<Real>((i / side % side + 0.5) * spacing),
+                                   static_cast<Real>((i / (side * side) + 0.5) * spacing));
+            system.add(position, Vector3(static_cast<Real>(n[0]), static_cast<Real>(n[1]), static_cast<Real>(n[2])), Vector3(), Vector3(1, 1, 1), Real(1),
+                       static_cast<Real>(RADIUS), Real(0), "");
+            momentum[0] += n[0];
+            momentum[1] += n[1];
+            momentum[2] += n[2];
+        }
+        Vector3Array &v = system.getVelocities();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            v.x[i] -= static_cast<Real>(momentum[0] / count);
+            v.y[i] -= static_cast<Real>(momentum[1] / count);
+            v.z[i] -= static_cast<Real>(momentum[2] / count);
+        }
+        return system;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t count = argc > 1 ? static_cast<std::size_t>(std::atof(argv[1])) : 100000;
+    const double volumeFraction = argc > 2 ? std::atof(argv[2]) : 0.1;
+    const double duration = argc > 3 ? std::atof(argv[3]) : 10.0;
+    const int frames = argc > 4 ? std::atoi(argv[4]) : 10;
+    const double restitution = argc > 5 ? std::atof(argv[5]) : 1.0;
+
+    double box = 0.0;
+    ParticleSystem system = makeGas(count, volumeFraction, box);
+    const Domain domain = Domain::periodicBox(Vector3d(0, 0, 0), Vector3d(box, box, box));
+    std::printf("%zu spheres of radius %g, volume fraction %g, periodic box %.2f\n", count, RADIUS, volumeFraction, box);
+
+    double momentumBefore[3], momentumAfter[3];
+    const double energyBefore = Benchmark::kineticEnergy(system, momentumBefore);
+    EventDrivenParameters parameters;
+    parameters.restitution = restitution;
+    EventDrivenSimulation simulation(domain, parameters);
+
+    // The first call builds the cells and the queue; it is timed separately
+    auto start = std::chrono::steady_clock::now();
+    simulation.advance(system, 0.0);
+    const double loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    simulation.advance(system, WARMUP);
+    simulation.resetStatistics();
+
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        simulation.advance(system, duration / frames);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const EventDrivenStatistics &statistics = simulation.getStatistics();
+    const double collisions = static_cast<double>(statistics.collisions);
+    const double events = collisions + statistics.wallCollisions + statistics.cellCrossings + statistics.staleEvents;
+
+    const double energyAfter = Benchmark::kineticEnergy(system, momentumAfter);
+    double momentumChange = 0.0;
+    for (int a = 0; a < 3; a++)
+    {
+        momentumChange = std::fmax(momentumChange, std::fabs(momentumAfter[a] - momentumBefore[a]));
+    }
+
+    // Enskog: Gamma = 4 n sigma^2 chi sqrt(pi T / m) per particle, chi from Carnahan-Starling
+    const double sigma = 2.0 * RADIUS;
+    const double density = count / (box * box * box);
+    const double temperature = 2.0 * energyBefore / (3.0 * count);
+    const double chi = (1.0 - volumeFraction / 2.0) / std::pow(1.0 - volumeFraction, 3.0);
+    const double enskog = 0.5 * count * 4.0 * density * sigma * sigma * chi * std::sqrt(Benchmark::PI * temperature) * duration;
+
+    // No two spheres may overlap at the end
+    CellGrid grid(sigma);
+    grid.build(system, domain);
+    std::size_t overlaps = 0;
+    const double limit = sigma * (1.0 - OVERLAP_TOLERANCE);
+    grid.forEachPair([&](std::uint32_t, std::uint32_t, double, double, double, double r2)
+                     { overlaps += r2 < limit * limit ? 1 : 0; });
+
+    std::printf("setup: %.2f ms (cells and first predictions)\n", loadMilliseconds);
+    std::printf("%12s %14s %14s %12s %12s %14s\n", "collisions", "collisions/s", "events/s", "crossings", "stale", "Enskog ratio");
+    std::printf("%12.0f %14.3e %14.3e %12.2f %12.2f %14.3f\n", collisions, collisions / seconds, events / seconds,
+                statistics.cellCrossings / std::fmax(collisions, 1.0), statistics.staleEvents / std::fmax(collisions, 1.0), collisions / enskog);
+    std::printf("kinetic energy: %.6e -> %.6e (relative change %.2e), |dP| = %.2e\n", energyBefore, energyAfter,
+                (energyAfter - energyBefore) / energyBefore, momentumChange);
+    if (restitution < 1.0)
+    {
+        std::printf("impacts made elastic against inelastic collapse: %zu\n", statistics.elasticImpacts);
+    }
+    std::printf("overlapping pairs at the end: %zu (%s)\n", overlaps, overlaps == 0 ? "none missed" : "MISSED COLLISIONS");
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Compares the fast multipole backend against direct summation on a
+// neutral plasma cloud: wall time per force evaluation and relative RMS
+// acceleration error for several expansion orders.
+//
+// Usage: fmm-benchmark [particle counts...]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "BenchmarkCommon.h"
+#include "CoulombForce.h"
+#include "FastMultipoleForce.h"
+#include "ParticleSystem.h"
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::size_t> counts;
+    for (int i = 1; i < argc; i++)
+    {
+        counts.push_back(static_cast<std::size_t>(std::strtoull(argv[i], nullptr, 10)));
+    }
+    if (counts.empty())
+    {
+        counts = {1000, 4000, 16000, 64000};
+    }
+
+    CoulombParameters parameters;
+    parameters.coulombConstant = 1.0;
+    parameters.softening = 1e-3;
+    const int orders[] = {2, 4, 6, 8};
+
+    std::printf("%10s %8s %12s %12s %10s\n", "particles", "method", "time [ms]", "rel. error", "speedup");
+    for (std::size_t n : counts)
+    {
+        const int repeats = n <= 16000 ? 3 : 1;
+        ParticleSystem reference = Benchmark::makePlasma(n, 42);
+        CoulombForce direct(parameters);
+        const double directTime = Benchmark::timeForces(direct, reference, repeats);
+        std::printf("%10zu %8s %12.2f %12s %10s\n", n, "direct", directTime, "-", "1.00");
+
+        for (int order : orders)
+        {
+            FastMultipoleParameters fmmParameters;
+            fmmParameters.expansionOrder = order;
+            FastMultipoleForce fmm(parameters, fmmParameters);
+            ParticleSystem system = Benchmark::makePlasma(n, 42);
+            const double time = Benchmark::timeForces(fmm, system, repeats);
+            char label[16];
+            std::snprintf(label, sizeof(label), "fmm p=%d", order);
+            std::printf("%10zu %8s %12.2f %12.3e %10.2f\n", n, label, time, Benchmark::relativeError(system, reference), directTime / time);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Compares the parallel force accumulation strategies (per-thread buffers
+// and coloring) against serial accumulation on the two pair-force backends:
+// direct Coulomb summation on a plasma cloud and Lennard-Jones on a periodic
+// fcc lattice. Reports wall time per force evaluation, speedup over serial
+// and the relative RMS deviation from the serial accelerations.
+//
+// Usage: accumulation-benchmark [coulomb particles] [lattice cells per axis]
+// Threads come from the shared pool; vary ATOM_THREADS to measure scaling.
+
+#include <cstdio>
+#include <cstdlib>
+#include "BenchmarkCommon.h"
+#include "CoulombForce.h"
+#include "PairPotentialForce.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const ForceAccumulation strategies[] = {ForceAccumulation::Serial, ForceAccumulation::ThreadBuffers, ForceAccumulation::Coloring};
+
+    void printRow(const char *workload, std::size_t n, ForceAccumulation strategy, double time, double serialTime, double error)
+    {
+        std::printf("%14s %10zu %10s %12.2f %10.2f %12.3e\n", workload, n, forceAccumulationName(strategy), time, serialTime / time, error);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const std::size_t plasmaCount = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 32000;
+    const int latticeCells = argc > 2 ? std::atoi(argv[2]) : 32;
+
+    std::printf("threads: %zu\n", ThreadPool::global().size());
+    std::printf("%14s %10s %10s %12s %10s %12s\n", "workload", "particles", "strategy", "time [ms]", "speedup", "deviation");
+
+    CoulombParameters coulomb;
+    coulomb.coulombConstant = 1.0;
+    coulomb.softening = 1e-3;
+    CoulombForce direct(coulomb);
+    ParticleSystem plasmaReference = Benchmark::makePlasma(plasmaCount, 42);
+    double serialTime = 0.0;
+    for (ForceAccumulation strategy : strategies)
+    {
+        direct.setAccumulation(strategy);
+        ParticleSystem system = Benchmark::makePlasma(plasmaCount, 42);
+        ParticleSystem &target = strategy == ForceAccumulation::Serial ? plasmaReference : system;
+        const double time = Benchmark::timeForces(direct, target, 2);
+        serialTime = strategy == ForceAccumulation::Serial ? time : serialTime;
+        printRow("coulomb", plasmaCount, strategy, time, serialTime, Benchmark::relativeError(target, plasmaReference));
+    }
+
+    // Lennard-Jones near the triple point density, cutoff 2.5 sigma
+    const double a = Benchmark::LJ_LATTICE_CONSTANT;
+    PairPotentialParameters lj;
+    lj.domain = Domain::periodicBox(Vector3d(0, 0, 0), Vector3d(latticeCells * a, latticeCells * a, latticeCells * a));
+    Benchmark::LatticeOptions jittered;
+    jittered.jitter = 0.05;
+    jittered.seed = 7;
+    ParticleSystem latticeReference = Benchmark::makeLattice(latticeCells, a, jittered);
+    for (ForceAccumulation strategy : strategies)
+    {
+        lj.accumulation = strategy;
+        PairPotentialForce pair(lj);
+        pair.setLennardJones(0, 1.0, 1.0);
+        ParticleSystem system = Benchmark::makeLattice(latticeCells, a, jittered);
+        ParticleSystem &target = strategy == ForceAccumulation::Serial ? latticeReference : system;
+        pair.computeAccelerations(target); // builds the neighbor list outside the timing
+        const double time = Benchmark::timeForces(pair, target, 5);
+        serialTime = strategy == ForceAccumulation::Serial ? time : serialTime;
+        printRow("lennard-jones", target.size(), strategy, time, serialTime, Benchmark::relativeError(target, latticeReference));
+    }
+    return 0;
+}
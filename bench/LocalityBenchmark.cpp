@@ -0,0 +1,95 @@
+// Effect of storage order on a neighbor-list force loop: a periodic
+// Lennard-Jones liquid whose particles are stored in random order is run
+// as is and with the locality policy re-sorting it along the Morton and the
+// Hilbert curve. Reports the time per step, the locality metric (mean
+// distance between storage neighbors) at the end and the number of sorts.
+//
+// Usage: locality-benchmark [lattice cells per axis] [steps]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "BenchmarkCommon.h"
+#include "CounterRandom.h"
+#include "Integrator.h"
+#include "PairPotentialForce.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2024;
+
+    // fcc lattice of `cells`^3 unit cells with lattice constant a, thermal
+    // velocities at kT and storage shuffled into random order
+    ParticleSystem makeShuffledLiquid(int cells, double a, double kT)
+    {
+        Benchmark::LatticeOptions options;
+        options.temperature = kT;
+        options.seed = SEED;
+        ParticleSystem system = Benchmark::makeLattice(cells, a, options);
+        const CounterRandom random(SEED);
+
+        // Fisher-Yates shuffle of the storage order
+        std::vector<std::uint32_t> order(system.size());
+        for (std::size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = static_cast<std::uint32_t>(i);
+        }
+        for (std::size_t i = order.size() - 1; i > 0; i--)
+        {
+            double u[2];
+            random.uniform(i, 2, u);
+            std::swap(order[i], order[static_cast<std::size_t>(u[0] * static_cast<double>(i + 1))]);
+        }
+        system.permute(order);
+        return system;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int cells = argc > 1 ? std::atoi(argv[1]) : 24;
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 50;
+    const double a = Benchmark::LJ_LATTICE_CONSTANT;
+
+    PairPotentialParameters lj;
+    lj.domain = Domain::periodicBox(Vector3d(0, 0, 0), Vector3d(cells * a, cells * a, cells * a));
+
+    struct Run
+    {
+        const char *name;
+        bool enabled;
+        SpaceFillingCurve curve;
+    };
+    const Run runs[] = {{"unsorted", false, SpaceFillingCurve::Morton}, {"morton", true, SpaceFillingCurve::Morton}, {"hilbert", true, SpaceFillingCurve::Hilbert}};
+
+    std::printf("threads: %zu\n", ThreadPool::global().size());
+    std::printf("%10s %10s %12s %10s %8s\n", "order", "particles", "ms / step", "locality", "sorts");
+    for (const Run &run : runs)
+    {
+        ParticleSystem system = makeShuffledLiquid(cells, a, 1.5);
+        ReorderPolicy policy;
+        policy.enabled = run.enabled;
+        policy.curve = run.curve;
+        system.setReorderPolicy(policy);
+
+        PairPotentialForce pair(lj);
+        pair.setLennardJones(0, 1.0, 1.0);
+        VelocityVerletIntegrator integrator;
+        const std::uint64_t layout = system.getLayoutVersion();
+        const auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+        {
+            integrator.step(system, pair, 0.002);
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        const double time = std::chrono::duration<double, std::milli>(stop - start).count() / steps;
+        std::printf("%10s %10zu %12.2f %10.3f %8llu\n", run.name, system.size(), time, system.localityMetric(),
+                    static_cast<unsigned long long>(system.getLayoutVersion() - layout));
+    }
+    return 0;
+}
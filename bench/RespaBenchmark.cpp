@@ -0,0 +1,98 @@
+// Multiple time stepping on a charged Lennard-Jones cluster: a rock-salt
+// cube of +1/-1 ions whose stiff Lennard-Jones repulsion is the fast force
+// and whose direct Coulomb sum, most of the cost, is the slow one. Runs
+// velocity Verlet on the full force with the inner step and r-RESPA with
+// the slow force every k inner steps over the same simulated time, and
+// reports the wall time, the slow force evaluations, the speedup and the
+// relative energy drift.
+//
+// Usage: respa-benchmark [lattice cells per axis] [simulated time] [largest k]
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "BenchmarkCommon.h"
+#include "CoulombForce.h"
+#include "CounterRandom.h"
+#include "ForcePartition.h"
+#include "Integrator.h"
+#include "PairPotentialForce.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const std::uint64_t SEED = 2024;
+    const double SPACING = 1.1;
+    const double TEMPERATURE = 0.2;
+    const double INNER_STEP = 0.004;
+
+    // Simple cubic lattice of `cells`^3 sites centered on the origin, charges
+    // alternating along every axis, with Maxwell-Boltzmann velocities
+    ParticleSystem makeCluster(int cells)
+    {
+        const CounterRandom random(SEED);
+        const double sigma = std::sqrt(TEMPERATURE);
+        const double offset = 0.5 * (cells - 1) * SPACING;
+        ParticleSystem system;
+        system.reserve(static_cast<std::size_t>(cells) * cells * cells);
+        for (int x = 0; x < cells; x++)
+        {
+            for (int y = 0; y < cells; y++)
+            {
+                for (int z = 0; z < cells; z++)
+                {
+                    double n[4];
+                    random.normal(system.size(), 0, n);
+                    random.normal(system.size(), 1, n + 2);
+                    const Vector3 position(static_cast<Real>(x * SPACING - offset), static_cast<Real>(y * SPACING - offset),
+                                           static_cast<Real>(z * SPACING - offset));
+                    const Vector3 velocity(static_cast<Real>(sigma * n[0]), static_cast<Real>(sigma * n[1]), static_cast<Real>(sigma * n[2]));
+                    const bool positive = ((x + y + z) & 1) == 0;
+                    system.add(position, velocity, Vector3(), positive ? Vector3(1, 0, 0) : Vector3(0, 0, 1), Real(1), Real(0.01),
+                               positive ? Real(1) : Real(-1), "");
+                }
+            }
+        }
+        return system;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int cells = argc > 1 ? std::atoi(argv[1]) : 16;
+    const double simulatedTime = argc > 2 ? std::atof(argv[2]) : 0.8;
+    const int largestK = argc > 3 ? std::atoi(argv[3]) : 8;
+    const int innerSteps = static_cast<int>(simulatedTime / INNER_STEP + 0.5);
+
+    PairPotentialParameters lj;
+    CoulombParameters coulomb;
+    coulomb.coulombConstant = 1.0;
+
+    std::printf("threads: %zu, %d^3 ions, %d inner steps of %g\n", ThreadPool::global().size(), cells, innerSteps, INNER_STEP);
+    std::printf("%12s %4s %12s %12s %14s %10s %12s\n", "integrator", "k", "outer step", "coulomb", "time (ms)", "speedup", "energy drift");
+
+    double reference = 0.0;
+    for (int k = 1; k <= largestK; k *= 2)
+    {
+        ParticleSystem system = makeCluster(cells);
+        PairPotentialForce pair(lj);
+        pair.setLennardJones(0, 1.0, 1.0);
+        CoulombForce direct(coulomb);
+        ForcePartition partition;
+        partition.add(pair, ForceGroup::Fast);
+        partition.add(direct, ForceGroup::Slow);
+
+        // k = 1 is velocity Verlet on the full force
+        VelocityVerletIntegrator verlet;
+        RespaIntegrator respa(RespaParameters{k});
+        Integrator &integrator = k == 1 ? static_cast<Integrator &>(verlet) : respa;
+        const int steps = innerSteps / k;
+        const Benchmark::MonitoredRun result = Benchmark::runMonitored(integrator, system, partition, steps, k * INNER_STEP);
+        reference = k == 1 ? result.milliseconds : reference;
+        std::printf("%12s %4d %12g %12d %14.1f %9.2fx %12.2e\n", integrator.name(), k, k * INNER_STEP, steps + 1, result.milliseconds,
+                    reference / result.milliseconds, result.energyDrift);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "ParticleSystem.h"
+#include "SweepAndPrune.h"
+#include "Vector3.h"
+
+// Axis-aligned bounding box
+struct Aabb
+{
+    double lower[3] = {0.0, 0.0, 0.0};
+    double upper[3] = {0.0, 0.0, 0.0};
+
+    bool overlaps(const Aabb &other) const
+    {
+        return lower[0] <= other.upper[0] && other.lower[0] <= upper[0] && lower[1] <= other.upper[1] && other.lower[1] <= upper[1] &&
+               lower[2] <= other.upper[2] && other.lower[2] <= upper[2];
+    }
+    bool contains(const Aabb &other) const
+    {
+        return lower[0] <= other.lower[0] && other.upper[0] <= upper[0] && lower[1] <= other.lower[1] && other.upper[1] <= upper[1] &&
+               lower[2] <= other.lower[2] && other.upper[2] <= upper[2];
+    }
+    double surfaceArea() const
+    {
+        const double dx = upper[0] - lower[0], dy = upper[1] - lower[1], dz = upper[2] - lower[2];
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+// Ray origin + t * direction, 0 <= t <= maxDistance (direction need not be normalized)
+struct Ray
+{
+    Vector3d origin;
+    Vector3d direction;
+    double maxDistance = 1e300;
+};
+
+// First sphere along a Ray
+struct RayHit
+{
+    static constexpr std::uint32_t NONE = 0xffffffffu;
+
+    std::uint32_t particle = NONE; // storage index, NONE for a miss
+    double distance = 0.0;         // ray parameter t of the entry point
+
+    bool isHit() const { return particle != NONE; }
+};
+
+// Half space normal . x + offset >= 0; a set of them bounds a convex volume
+// such as a view frustum
+struct Plane
+{
+    Vector3d normal;
+    double offset = 0.0;
+};
+
+// When AabbTree refits and rebuilds
+struct AabbTreeParameters
+{
+    double relativeMargin = 0.25; // leaf boxes are fattened by this many radii...
+    double absoluteMargin = 0.0;  // ...plus this distance
+    double degradation = 1.5;     // rebuild once the SAH cost exceeds this multiple of its value after the last build
+};
+
+// Bookkeeping of an AabbTree
+struct AabbTreeStatistics
+{
+    std::size_t updates = 0;  // calls to update()
+    std::size_t rebuilds = 0; // SAH builds
+    std::size_t refits = 0;   // updates that refitted the boxes instead
+    std::size_t escapes = 0;  // leaves whose sphere left its fattened box, in the last update
+    double cost = 0.0;        // SAH cost: sum of the internal node areas over the root's
+};
+
+// Dynamic bounding volume hierarchy over the particles' bounding spheres,
+// for collisions, picking and culling on scenes whose particle sizes vary
+// too much for uniform grids.
+//
+// Every particle has a leaf whose box is its sphere's box fattened by a
+// margin. update() keeps the leaf while the sphere stays inside it; when
+// spheres escape, their leaves are refattened and the internal boxes
+// refitted bottom-up in one pass, without changing the topology. Refits
+// let the tree's quality decay, so once its SAH cost has grown past
+// `degradation` times its value after the last build it is rebuilt with a
+// binned surface area heuristic, in parallel.
+//
+// Nodes are stored depth first: the left child of an internal node follows
+// it and every node records the index after its subtree, so overlap
+// queries walk the array without a stack; ray casts keep one to enter the
+// nearer child first. Leaves are numbered in that order too, and the
+// spheres are copied by leaf number, so neighbours in the tree are close in
+// memory. Batched queries run in parallel over the queries; results depend
+// neither on the thread count nor on the schedule.
+class AabbTree
+{
+public:
+    explicit AabbTree(const AabbTreeParameters &parameters = AabbTreeParameters());
+
+    // Refit or rebuild for the current positions and radii. Returns true when it rebuilt.
+    bool update(const ParticleSystem &system);
+
+    // Rebuild from scratch on the next update(), e.g. after particles were teleported
+    void invalidate() { valid = false; }
+
+    // Every pair of particles whose spheres overlap, as of the last update()
+    void findContacts(std::vector<CollisionPair> &contacts) const;
+
+    // For every query box, the particles whose sphere's box overlaps it, in
+    // CSR form: the hits of box q are hits[offsets[q] .. offsets[q + 1])
+    void queryBoxes(const std::vector<Aabb> &boxes, std::vector<std::uint32_t> &offsets, std::vector<std::uint32_t> &hits) const;
+
+    // For every ray, the nearest sphere it enters (picking)
+    void raycast(const std::vector<Ray> &rays, std::vector<RayHit> &hits) const;
+
+    // Particles whose sphere is not entirely outside one of the planes (culling)
+    void queryPlanes(const std::vector<Plane> &planes, std::vector<std::uint32_t> &hits) const;
+
+    // Getters
+    const AabbTreeParameters &getParameters() const { return parameters; }
+    const AabbTreeStatistics &getStatistics() const { return statistics; }
+    std::size_t nodeCount() const { return nodes.size(); }
+
+    // Setters; new margins take effect on the next rebuild
+    void setParameters(const AabbTreeParameters &p);
+    void resetStatistics() { statistics = AabbTreeStatistics(); }
+
+private:
+    static constexpr std::uint32_t INTERNAL = 0xffffffffu;
+
+    struct Node
+    {
+        Aabb box;
+        std::uint32_t skip; // index after this node's subtree
+        std::uint32_t leaf; // rank of the leaf among the leaves in depth-first order, INTERNAL for internal nodes
+    };
+
+    AabbTreeParameters parameters;
+    AabbTreeStatistics statistics;
+    bool valid = false;
+    std::uint64_t layoutVersion = 0; // ParticleSystem::getLayoutVersion() the leaves refer to
+    double builtCost = 0.0;          // SAH cost right after the last build
+
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> order;    // particle of every leaf rank
+    std::vector<std::uint32_t> leafNode; // node of every leaf rank
+
+    // Spheres as of the last update(), by leaf rank
+    AlignedVector<double> x, y, z, radius;
+
+    // A leaf as the build moves it around: fattened box, center and rank before the build
+    struct Primitive
+    {
+        Aabb box;
+        double center[3];
+        std::uint32_t rank;
+    };
+    std::vector<Primitive> primitives; // scratch of the build
+
+    Aabb sphereBox(std::size_t rank) const;
+    Aabb fattenedBox(std::size_t rank) const;
+    void gather(const ParticleSystem &system);
+    void build();
+    void buildRange(std::uint32_t node, std::uint32_t begin, std::uint32_t end, int depth);
+    double refit();
+
+    template <typename Overlaps, typename Leaf>
+    void walk(std::uint32_t begin, Overlaps &&overlaps, Leaf &&leaf) const;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Cache-line alignment used for all hot simulation arrays
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Minimal allocator that hands out storage aligned to `Alignment` bytes, so
+// SoA arrays can be loaded with aligned vector instructions.
+template <typename T, std::size_t Alignment = CACHE_LINE_SIZE>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    static_assert(Alignment >= alignof(T), "Alignment must not be weaker than alignof(T)");
+    static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept { return false; }
+};
+
+// std::vector whose data() is cache-line aligned
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "CoulombForce.h"
+#include "ForceModel.h"
+#include "ParticleSystem.h"
+
+// Tuning knobs of the Barnes-Hut tree
+struct BarnesHutParameters
+{
+    double theta = 0.5;         // opening angle: a node is used as a whole when size / distance < theta
+    int multipoleOrder = 2;     // 0 = monopole, 1 = + dipole, 2 = + quadrupole
+    std::size_t leafSize = 16;  // maximum particles per leaf
+    std::size_t parallelThreshold = 8192; // build and evaluate on the ThreadPool above this many particles
+};
+
+// Cartesian multipole moments of one source (charge or mass) about a node's
+// expansion center. The quadrupole is the traceless
+// sum s * (3 x x^T - |x|^2 I), stored as xx, yy, zz, xy, xz, yz.
+struct Multipole
+{
+    double monopole = 0.0;
+    double dipole[3] = {0.0, 0.0, 0.0};
+    double quadrupole[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+};
+
+// Octree node. Children are stored contiguously starting at firstChild;
+// leaves have childCount == 0 and own the sorted particles [begin, end).
+struct BarnesHutNode
+{
+    double center[3];
+    double halfSize;
+    double expansionCenter[3];
+    double weight; // total |k q| + G m, places the expansion center
+    Multipole charge;
+    Multipole mass;
+    std::uint32_t begin;
+    std::uint32_t end;
+    std::uint32_t firstChild;
+    std::uint32_t childCount;
+};
+
+// O(N log N) long-range force backend: Barnes-Hut octree over particle
+// positions, with monopole/dipole/quadrupole moments of Particle charge and
+// mass. Drop-in alternative to CoulombForce for large scenes.
+//
+// Particles are sorted along a Morton curve so every node owns a contiguous
+// range of the sorted arrays. The top-level octants are built as
+// ThreadPool tasks and the leaves are evaluated with a parallelFor. The
+// potential energy comes out of the same walk: each target sums the
+// potential of the expansions and particles it sees next to their field.
+class BarnesHutForce : public ForceModel
+{
+public:
+    explicit BarnesHutForce(const CoulombParameters &parameters = CoulombParameters(),
+                            const BarnesHutParameters &treeParameters = BarnesHutParameters());
+
+    void computeAccelerations(ParticleSystem &system) override;
+    void computeActiveAccelerations(ParticleSystem &system, const std::vector<std::uint32_t> &active) override; // full build, active leaves only
+    double getPotentialEnergy() const override { return potentialEnergy; } // of the last computeAccelerations(), with the forces' tree error
+
+    // Build the tree over the current positions without evaluating forces
+    void build(const ParticleSystem &system);
+
+    // Getters
+    const CoulombParameters &getParameters() const { return parameters; }
+    const BarnesHutParameters &getTreeParameters() const { return treeParameters; }
+    const std::vector<BarnesHutNode> &getNodes() const { return nodes; }
+
+    // Setters
+    void setParameters(const CoulombParameters &p) { parameters = p; }
+    void setTreeParameters(const BarnesHutParameters &p) { treeParameters = p; }
+    void setTheta(double theta) { treeParameters.theta = theta; }
+
+private:
+    CoulombParameters parameters;
+    BarnesHutParameters treeParameters;
+
+    std::vector<BarnesHutNode> nodes;
+
+    // Particle data in Morton order
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+    AlignedVector<double> sortedX, sortedY, sortedZ;
+    AlignedVector<double> sortedCharge, sortedMass;
+    std::vector<std::uint8_t> activeMask; // by particle index, see computeActiveAccelerations()
+    std::vector<double> leafEnergy;       // by node, summed in a fixed order
+    double potentialEnergy = 0.0;
+
+    // Sort particles along the Morton curve of their bounding cube, returns the root node
+    BarnesHutNode sortParticles(const ParticleSystem &system);
+
+    // Accelerations of all particles, or only of those flagged in `active`
+    template <bool Gravity>
+    void evaluate(ParticleSystem &system, const std::uint8_t *active);
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Priority queue of timed events (R. Brown's calendar queue), for
+// event-driven simulation where nearly every event popped schedules new
+// ones a short time ahead.
+//
+// Time is cut into days of `width`, and the days are dealt round-robin to
+// a power of two of buckets, so a bucket holds the events of every day
+// congruent to it. push() appends to the event's bucket in O(1); pop
+// scans today's bucket for its earliest event of today and moves on a day
+// when there is none. With a width of a few mean intervals between events
+// per bucket, both are O(1) on average. After a whole year of empty days
+// the queue jumps straight to the day of the earliest event.
+//
+// Event needs a double member `time`. Events must not be pushed earlier
+// than the day of the last one popped.
+template <typename Event>
+class CalendarQueue
+{
+public:
+    // Empty the queue and lay out bucketCount (rounded up to a power of two) days of `width` from `start`
+    void reset(std::size_t bucketCount, double width, double start);
+
+    void push(const Event &event);
+
+    // Remove the earliest event into `event` unless it is later than `limit`
+    bool popBefore(double limit, Event &event);
+
+    // Getters
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    double getWidth() const { return width; }
+    std::size_t bucketCount() const { return buckets.size(); }
+
+private:
+    std::vector<std::vector<Event>> buckets;
+    double width = 1.0;
+    double inverseWidth = 1.0;
+    std::size_t mask = 0;
+    std::int64_t today = 0;
+    std::size_t count = 0;
+
+    std::int64_t dayOf(double time) const { return static_cast<std::int64_t>(std::floor(time * inverseWidth)); }
+};
+
+template <typename Event>
+void CalendarQueue<Event>::reset(std::size_t bucketCount, double w, double start)
+{
+    std::size_t size = 1;
+    while (size < bucketCount)
+    {
+        size *= 2;
+    }
+    buckets.resize(size);
+    for (std::vector<Event> &bucket : buckets)
+    {
+        bucket.clear();
+    }
+    mask = size - 1;
+    width = w;
+    inverseWidth = 1.0 / w;
+    today = dayOf(start);
+    count = 0;
+}
+
+template <typename Event>
+void CalendarQueue<Event>::push(const Event &event)
+{
+    buckets[static_cast<std::size_t>(dayOf(event.time)) & mask].push_back(event);
+    count++;
+}
+
+template <typename Event>
+bool CalendarQueue<Event>::popBefore(double limit, Event &event)
+{
+    const std::int64_t lastDay = dayOf(limit);
+    while (count > 0)
+    {
+        for (std::size_t scanned = 0; scanned <= mask; scanned++)
+        {
+            std::vector<Event> &bucket = buckets[static_cast<std::size_t>(today) & mask];
+            std::size_t best = bucket.size();
+            for (std::size_t k = 0; k < bucket.size(); k++)
+            {
+                if (dayOf(bucket[k].time) <= today && (best == bucket.size() || bucket[k].time < bucket[best].time))
+                {
+                    best = k;
+                }
+            }
+            if (best < bucket.size())
+            {
+                if (bucket[best].time > limit)
+                {
+                    return false;
+                }
+                event = bucket[best];
+                bucket[best] = bucket.back();
+                bucket.pop_back();
+                count--;
+                return true;
+            }
+            if (today >= lastDay)
+            {
+                return false;
+            }
+            today++;
+        }
+
+        // A year without events: jump to the earliest
+        double earliest = std::numeric_limits<double>::infinity();
+        for (const std::vector<Event> &bucket : buckets)
+        {
+            for (const Event &e : bucket)
+            {
+                earliest = std::fmin(earliest, e.time);
+            }
+        }
+        today = dayOf(earliest);
+    }
+    return false;
+}
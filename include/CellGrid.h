@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "Domain.h"
+#include "ParticleSystem.h"
+
+// Uniform linked-cell grid for cutoff-based (short-range) interactions.
+//
+// build() bins the particles with a counting sort into cells at least one
+// cutoff wide, so every pair closer than the cutoff sits in the same or in
+// adjacent cells. Cells are stored in CSR form: the particles of cell c are
+// cellParticles[cellStart[c] .. cellStart[c + 1]), and their positions are
+// copied in the same order so the pair loops stream through memory.
+//
+// Open axes span the particles' bounding box; periodic axes span the domain
+// and need at least three cells (box >= 3 cutoffs).
+class CellGrid
+{
+public:
+    explicit CellGrid(double cutoff = 1.0);
+
+    // Rebin the current positions, O(N)
+    void build(const ParticleSystem &system, const Domain &domain = Domain());
+
+    // Call f(i, j, dx, dy, dz, r2) once for every unordered pair closer than
+    // the cutoff, with (dx, dy, dz) = r_i - r_j (minimum image on periodic
+    // axes). Iterates the cell itself and its 13 half-shell neighbors.
+    template <typename PairFunction>
+    void forEachPair(PairFunction &&f) const;
+
+    // Call f(j, dx, dy, dz, r2) for every particle j within the cutoff of
+    // point r, with (dx, dy, dz) = r - r_j
+    template <typename Function>
+    void forEachNeighbor(const double r[3], Function &&f) const;
+
+    // Partition the cells into colors such that no two cells of one color
+    // share an adjacent cell: work that touches only a cell and its
+    // neighbors can run concurrently within a color. 27 colors, plus up to
+    // two extra layers per periodic axis whose cell count is not a multiple
+    // of 3.
+    std::vector<std::vector<std::uint32_t>> cellColors() const;
+
+    // Getters
+    double getCutoff() const { return cutoff; }
+    const Domain &getDomain() const { return domain; }
+    const int *getDimensions() const { return dims; }
+    std::size_t cellCount() const { return cellStart.empty() ? 0 : cellStart.size() - 1; }
+    const std::vector<std::uint32_t> &getCellStart() const { return cellStart; }
+    const std::vector<std::uint32_t> &getCellParticles() const { return cellParticles; }
+
+    // Setters
+    void setCutoff(double c);
+
+private:
+    double cutoff;
+    Domain domain;
+    int dims[3] = {0, 0, 0};
+    double origin[3] = {0.0, 0.0, 0.0};
+    double inverseCellSize[3] = {0.0, 0.0, 0.0};
+
+    std::vector<std::uint32_t> cellStart;
+    std::vector<std::uint32_t> cellParticles;
+    std::vector<std::uint32_t> particleCell;
+    std::vector<std::uint32_t> cursor; // scratch of the counting sort in build()
+
+    // Positions in cell order, folded into the box on periodic axes
+    AlignedVector<double> sortedX, sortedY, sortedZ;
+
+    int cellCoordinate(double x, int axis) const;
+
+    std::size_t cellIndex(int cx, int cy, int cz) const
+    {
+        return (static_cast<std::size_t>(cz) * dims[1] + cy) * dims[0] + cx;
+    }
+
+    // Neighbor cell coordinate c + offset along `axis`, wrapped on periodic
+    // axes. Returns false when it falls outside an open axis; `shift` is the
+    // image shift to add to the neighbor's positions.
+    bool neighborCoordinate(int c, int offset, int axis, int &neighbor, double &shift) const;
+};
+
+template <typename PairFunction>
+void CellGrid::forEachPair(PairFunction &&f) const
+{
+    // Half shell: offsets lexicographically after (0, 0, 0)
+    static const int offsets[13][3] = {
+        {1, 0, 0}, {-1, 1, 0}, {0, 1, 0}, {1, 1, 0}, {-1, -1, 1}, {0, -1, 1}, {1, -1, 1},
+        {-1, 0, 1}, {0, 0, 1}, {1, 0, 1}, {-1, 1, 1}, {0, 1, 1}, {1, 1, 1}};
+    const double cutoff2 = cutoff * cutoff;
+
+    for (int cz = 0; cz < dims[2]; cz++)
+    {
+        for (int cy = 0; cy < dims[1]; cy++)
+        {
+            for (int cx = 0; cx < dims[0]; cx++)
+            {
+                const std::size_t cell = cellIndex(cx, cy, cz);
+                const std::uint32_t begin = cellStart[cell];
+                const std::uint32_t end = cellStart[cell + 1];
+                if (begin == end)
+                {
+                    continue;
+                }
+
+                // Pairs inside the cell
+                for (std::uint32_t a = begin; a < end; a++)
+                {
+                    for (std::uint32_t b = a + 1; b < end; b++)
+                    {
+                        const double dx = sortedX[a] - sortedX[b];
+                        const double dy = sortedY[a] - sortedY[b];
+                        const double dz = sortedZ[a] - sortedZ[b];
+                        const double r2 = dx * dx + dy * dy + dz * dz;
+                        if (r2 < cutoff2)
+                        {
+                            f(cellParticles[a], cellParticles[b], dx, dy, dz, r2);
+                        }
+                    }
+                }
+
+                // Pairs with the half-shell neighbors
+                for (const int *offset : offsets)
+                {
+                    int nx, ny, nz;
+                    double sx, sy, sz;
+                    if (!neighborCoordinate(cx, offset[0], 0, nx, sx) ||
+                        !neighborCoordinate(cy, offset[1], 1, ny, sy) ||
+                        !neighborCoordinate(cz, offset[2], 2, nz, sz))
+                    {
+                        continue;
+                    }
+                    const std::size_t neighbor = cellIndex(nx, ny, nz);
+                    const std::uint32_t nBegin = cellStart[neighbor];
+                    const std::uint32_t nEnd = cellStart[neighbor + 1];
+                    for (std::uint32_t a = begin; a < end; a++)
+                    {
+                        const double xa = sortedX[a] - sx, ya = sortedY[a] - sy, za = sortedZ[a] - sz;
+                        for (std::uint32_t b = nBegin; b < nEnd; b++)
+                        {
+                            const double dx = xa - sortedX[b];
+                            const double dy = ya - sortedY[b];
+                            const double dz = za - sortedZ[b];
+                            const double r2 = dx * dx + dy * dy + dz * dz;
+                            if (r2 < cutoff2)
+                            {
+                                f(cellParticles[a], cellParticles[b], dx, dy, dz, r2);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Function>
+void CellGrid::forEachNeighbor(const double r[3], Function &&f) const
+{
+    if (cellStart.empty())
+    {
+        return;
+    }
+    const double cutoff2 = cutoff * cutoff;
+    const double p[3] = {domain.wrap(r[0], 0), domain.wrap(r[1], 1), domain.wrap(r[2], 2)};
+    const int c[3] = {cellCoordinate(p[0], 0), cellCoordinate(p[1], 1), cellCoordinate(p[2], 2)};
+
+    for (int oz = -1; oz <= 1; oz++)
+    {
+        for (int oy = -1; oy <= 1; oy++)
+        {
+            for (int ox = -1; ox <= 1; ox++)
+            {
+                int nx, ny, nz;
+                double sx, sy, sz;
+                if (!neighborCoordinate(c[0], ox, 0, nx, sx) ||
+                    !neighborCoordinate(c[1], oy, 1, ny, sy) ||
+                    !neighborCoordinate(c[2], oz, 2, nz, sz))
+                {
+                    continue;
+                }
+                const std::size_t neighbor = cellIndex(nx, ny, nz);
+                const double xa = p[0] - sx, ya = p[1] - sy, za = p[2] - sz;
+                for (std::uint32_t b = cellStart[neighbor]; b < cellStart[neighbor + 1]; b++)
+                {
+                    const double dx = xa - sortedX[b];
+                    const double dy = ya - sortedY[b];
+                    const double dz = za - sortedZ[b];
+                    const double r2 = dx * dx + dy * dy + dz * dz;
+                    if (r2 < cutoff2)
+                    {
+                        f(cellParticles[b], dx, dy, dz, r2);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AabbTree.h"
+#include "ParticleSystem.h"
+#include "SweepAndPrune.h"
+
+// How CollisionSystem finds the overlapping pairs
+enum class BroadPhase
+{
+    SweepAndPrune, // columns sorted along x; best for particles of similar size
+    AabbTree       // bounding volume hierarchy; copes with widely varying sizes
+};
+
+// Parse "sap" or "tree"
+BroadPhase broadPhaseFromName(const std::string &name);
+
+const char *broadPhaseName(BroadPhase broadPhase);
+
+// Response of CollisionSystem to a contact
+struct CollisionParameters
+{
+    double restitution = 1.0; // share of the normal approach speed kept: 1 elastic, 0 perfectly inelastic
+    double separation = 1.0;  // share of the overlap removed by pushing the pair apart, 0 leaves positions alone
+    BroadPhase broadPhase = BroadPhase::SweepAndPrune;
+};
+
+// Bookkeeping of the last CollisionSystem::resolve()
+struct CollisionStatistics
+{
+    std::size_t contacts = 0;       // overlapping pairs found
+    std::size_t impulses = 0;       // pairs that were approaching and got an impulse
+    double dissipatedEnergy = 0.0;  // kinetic energy lost to inelastic impulses
+};
+
+// Collision detection and response for particles as hard spheres of
+// ParticleSystem::getRadius().
+//
+// resolve() finds the overlapping pairs with a SweepAndPrune or an AabbTree,
+// as CollisionParameters::broadPhase selects, and treats each once, in the
+// order found: an approaching pair exchanges the impulse
+// J = -(1 + e) m_i m_j / (m_i + m_j) (v_i - v_j).n along the line of centers
+// n, which conserves momentum and, for e = 1, kinetic energy; then both are
+// moved apart along n, each by the share of the overlap set by the other's
+// mass. Particles with non-positive mass are immovable obstacles.
+//
+// Call it once per step after the integrator has moved the particles.
+// Chains of contacts are resolved one pass at a time, so a pair pushed into
+// a third particle is handled on the next call.
+class CollisionSystem
+{
+public:
+    explicit CollisionSystem(const CollisionParameters &parameters = CollisionParameters());
+
+    // Detect and respond; returns the number of impulses applied
+    std::size_t resolve(ParticleSystem &system);
+
+    // Getters
+    const CollisionParameters &getParameters() const { return parameters; }
+    const CollisionStatistics &getStatistics() const { return statistics; }
+    const SweepAndPrune &getSweepAndPrune() const { return sweepAndPrune; }
+    SweepAndPrune &getSweepAndPrune() { return sweepAndPrune; }
+    const AabbTree &getTree() const { return tree; } // also serves picking and culling queries
+    AabbTree &getTree() { return tree; }
+
+    // Setters
+    void setParameters(const CollisionParameters &p);
+
+private:
+    CollisionParameters parameters;
+    CollisionStatistics statistics;
+    SweepAndPrune sweepAndPrune;
+    AabbTree tree;
+    std::vector<CollisionPair> treeContacts;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+
+// Running sum with Neumaier's improved Kahan compensation: the rounding
+// error of every addition is carried in a second term, so the total stays
+// accurate to about one rounding of T however many terms are added and in
+// whatever order of magnitude they arrive. Must not be compiled with
+// -ffast-math, which would optimize the compensation away.
+template <typename T>
+class CompensatedSum
+{
+public:
+    CompensatedSum &operator+=(T value)
+    {
+        const T total = sum + value;
+        compensation += std::fabs(sum) >= std::fabs(value) ? (sum - total) + value : (value - total) + sum;
+        sum = total;
+        return *this;
+    }
+
+    CompensatedSum &operator+=(const CompensatedSum &other)
+    {
+        *this += other.sum;
+        compensation += other.compensation;
+        return *this;
+    }
+
+    // Getters
+    T value() const { return sum + compensation; }
+
+private:
+    T sum = T(0);
+    T compensation = T(0);
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "CompensatedSum.h"
+#include "ParticleSystem.h"
+#include "Vector3.h"
+
+// Mass-weighted sums over a range of particles, in stored (origin-relative)
+// coordinates. Integrators measure every block of particles right before
+// or after one of their update passes touches it, while it is in cache, so
+// the monitor needs no pass of its own over the particle arrays. Each block
+// is summed in double; blocks are combined with compensated sums.
+struct ParticleMoments
+{
+    CompensatedSum<double> mass;               // sum m
+    CompensatedSum<double> kineticEnergy;      // sum m |v|^2 / 2
+    CompensatedSum<double> momentum[3];        // sum m v
+    CompensatedSum<double> angularMomentum[3]; // sum m x × v
+    CompensatedSum<double> massMoment[3];      // sum m x
+    CompensatedSum<double> inertia;            // sum m |x|^2
+
+    // Moments of particles [begin, end) of `system`. With `kick` != 0 they
+    // are taken at the instant of a pending v += a * kick: momenta from the
+    // mean of the velocities before and after, and the kinetic energy from
+    // m v_before . v_after / 2, which matches the potential energy at that
+    // instant to O(kick^2).
+    static ParticleMoments measure(const ParticleSystem &system, std::size_t begin, std::size_t end, double kick = 0.0);
+
+    ParticleMoments &operator+=(const ParticleMoments &other);
+};
+
+inline ParticleMoments operator+(ParticleMoments a, const ParticleMoments &b) { return a += b; }
+
+// Conserved quantities of the system, sampled once per step
+struct ConservedQuantities
+{
+    double time = 0.0; // end of the sampled step
+    double kineticEnergy = 0.0;
+    double potentialEnergy = 0.0; // NaN when the force model does not compute one
+    Vector3d momentum;
+    Vector3d angularMomentum; // about the absolute origin
+
+    double totalEnergy() const { return kineticEnergy + potentialEnergy; }
+};
+
+// Largest accepted relative drift from the reference sample; infinity
+// disables a check. Scales are fixed at the reference: energy relative to
+// |K0| + |U0|, momentum relative to sqrt(2 M K0) and angular momentum
+// relative to sqrt(2 K0 sum m |x|^2), the Cauchy-Schwarz bounds of |P| and
+// |L|, so the drifts stay meaningful for systems at rest in total.
+struct ConservationTolerances
+{
+    double energy = 1e-3;
+    double momentum = 1e-4;
+    double angularMomentum = std::numeric_limits<double>::infinity(); // not conserved in periodic boxes
+};
+
+// Latched drift alarms
+struct ConservationAlarms
+{
+    bool energy = false;
+    bool momentum = false;
+    bool angularMomentum = false;
+    bool energyUnmonitored = false; // a sample had no potential energy, so `energy` could not trip; not a drift, not in any()
+
+    bool any() const { return energy || momentum || angularMomentum; }
+};
+
+// Energy and momentum conservation monitor. Attach it to an Integrator with
+// setMonitor(); every step then records one sample, computed from the
+// integrator's last update pass and the force model's potential energy
+// (see ForceModel::getPotentialEnergy()).
+//
+// The first sample after construction or reset() is the reference. Later
+// samples are compared against it and trip the alarms whose tolerance they
+// exceed; alarms stay set until reset(), so a driver can check them every
+// few steps and then shrink the time step or abort. The last
+// `historyCapacity` samples are kept as a rolling time series in
+// preallocated storage.
+class ConservationMonitor
+{
+public:
+    explicit ConservationMonitor(const ConservationTolerances &tolerances = ConservationTolerances(), std::size_t historyCapacity = 1024);
+
+    // Add the sample of a step of `deltaTime`
+    void record(const ParticleSystem &system, const ParticleMoments &moments, double potentialEnergy, double deltaTime);
+
+    // Drop the reference, the history and the alarms; the next sample
+    // becomes the new reference (e.g. after changing the time step)
+    void reset();
+
+    // Relative drifts of the latest sample, see ConservationTolerances;
+    // the energy drift is NaN without a potential energy
+    double energyDrift() const;
+    double momentumDrift() const;
+    double angularMomentumDrift() const;
+
+    // Rolling time series, index 0 is the oldest retained sample
+    std::size_t historySize() const { return count; }
+    const ConservedQuantities &history(std::size_t index) const;
+
+    // Getters
+    bool empty() const { return count == 0; }
+    const ConservedQuantities &getReference() const { return reference; }
+    const ConservedQuantities &latest() const { return history(count - 1); }
+    const ConservationAlarms &getAlarms() const { return alarms; }
+    const ConservationTolerances &getTolerances() const { return tolerances; }
+    double getTime() const { return time; }
+
+    // Setters
+    void setTolerances(const ConservationTolerances &t) { tolerances = t; }
+
+private:
+    ConservationTolerances tolerances;
+    ConservationAlarms alarms;
+    double time = 0.0;
+
+    ConservedQuantities reference;
+    bool hasReference = false;
+    double energyScale = 0.0;
+    double momentumScale = 0.0;
+    double angularMomentumScale = 0.0;
+
+    // Ring buffer
+    std::vector<ConservedQuantities> samples;
+    std::size_t first = 0;
+    std::size_t count = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "ForceAccumulation.h"
+#include "ForceModel.h"
+#include "ParticleSystem.h"
+#include "Vector3Array.h"
+
+// Constants of the long-range (1/r^2) interactions, shared by all
+// long-range force backends
+struct CoulombParameters
+{
+    double coulombConstant = 8.9875517923e9; // k_e, SI units by default
+    double gravitationalConstant = 0.0;      // G, set to 6.6743e-11 (SI) to enable gravity
+    double softening = 0.0;                  // Plummer softening length, avoids singular close encounters
+};
+
+// Direct O(N^2) electrostatic (and optionally gravitational) force.
+//
+// Particles are processed in square tiles of `tileSize` so both tiles of a
+// tile pair stay in L1/L2 while their interactions are computed. Every pair
+// is visited once and applied to both particles (Newton's third law), and the
+// inner loop over the second tile is written to vectorize. Tile pairs run on
+// the ThreadPool with the selected ForceAccumulation strategy. The potential
+// energy is summed in the same loop. This is the reference solution that the
+// approximate backends are checked against.
+class CoulombForce : public ForceModel
+{
+public:
+    explicit CoulombForce(const CoulombParameters &parameters = CoulombParameters(), std::size_t tileSize = 256);
+
+    void computeAccelerations(ParticleSystem &system) override;
+    void computeActiveAccelerations(ParticleSystem &system, const std::vector<std::uint32_t> &active) override; // O(active * N)
+
+    // Getters
+    const CoulombParameters &getParameters() const { return parameters; }
+    std::size_t getTileSize() const { return tileSize; }
+    ForceAccumulation getAccumulation() const { return accumulation; }
+    double getPotentialEnergy() const override { return potentialEnergy; } // of the last computeAccelerations()
+
+    // Setters
+    void setParameters(const CoulombParameters &p) { parameters = p; }
+    void setTileSize(std::size_t size);
+    void setAccumulation(ForceAccumulation a) { accumulation = a; }
+
+private:
+    CoulombParameters parameters;
+    std::size_t tileSize;
+    ForceAccumulation accumulation = ForceAccumulation::ThreadBuffers;
+
+    // Per-particle force accumulators
+    ForceArray forces;
+    ForceBufferPool buffers;
+    std::vector<double> tileEnergy; // per tile pair, summed in a fixed order
+    double potentialEnergy = 0.0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3", SC 2011).
+//
+// Every value is a pure function of (seed, counter), with no state carried
+// from one draw to the next. Keying draws by e.g. (time step, particle,
+// purpose) makes the stream independent of which thread draws what and in
+// which order, so parallel runs reproduce bit for bit at any thread count.
+class CounterRandom
+{
+public:
+    explicit CounterRandom(std::uint64_t seed = 0) : key{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)} {}
+
+    // Four independent 32-bit words for the 128-bit counter (a, b)
+    void generate(std::uint64_t a, std::uint64_t b, std::uint32_t out[4]) const
+    {
+        std::uint32_t c[4] = {static_cast<std::uint32_t>(a), static_cast<std::uint32_t>(a >> 32),
+                              static_cast<std::uint32_t>(b), static_cast<std::uint32_t>(b >> 32)};
+        std::uint32_t k[2] = {key[0], key[1]};
+        for (int round = 0; round < 10; round++)
+        {
+            const std::uint64_t p0 = static_cast<std::uint64_t>(MULTIPLIER_0) * c[0];
+            const std::uint64_t p1 = static_cast<std::uint64_t>(MULTIPLIER_1) * c[2];
+            const std::uint32_t next[4] = {static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<std::uint32_t>(p1),
+                                           static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1], static_cast<std::uint32_t>(p0)};
+            c[0] = next[0];
+            c[1] = next[1];
+            c[2] = next[2];
+            c[3] = next[3];
+            k[0] += WEYL_0;
+            k[1] += WEYL_1;
+        }
+        out[0] = c[0];
+        out[1] = c[1];
+        out[2] = c[2];
+        out[3] = c[3];
+    }
+
+    // Two uniform doubles in [0, 1) with 53 random bits each
+    void uniform(std::uint64_t a, std::uint64_t b, double out[2]) const
+    {
+        std::uint32_t words[4];
+        generate(a, b, words);
+        out[0] = toUnit(words[0], words[1]);
+        out[1] = toUnit(words[2], words[3]);
+    }
+
+    // Two independent standard normal deviates (Box-Muller)
+    void normal(std::uint64_t a, std::uint64_t b, double out[2]) const
+    {
+        double u[2];
+        uniform(a, b, u);
+        const double radius = std::sqrt(-2.0 * std::log(1.0 - u[0])); // 1 - u is in (0, 1]
+        const double angle = 6.283185307179586 * u[1];
+        out[0] = radius * std::cos(angle);
+        out[1] = radius * std::sin(angle);
+    }
+
+private:
+    static constexpr std::uint32_t MULTIPLIER_0 = 0xD2511F53;
+    static constexpr std::uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+    static constexpr std::uint32_t WEYL_0 = 0x9E3779B9;
+    static constexpr std::uint32_t WEYL_1 = 0xBB67AE85;
+
+    std::uint32_t key[2];
+
+    static double toUnit(std::uint32_t high, std::uint32_t low)
+    {
+        const std::uint64_t bits = (static_cast<std::uint64_t>(high) << 21) | (low >> 11);
+        return static_cast<double>(bits) * (1.0 / 9007199254740992.0); // 2^-53
+    }
+};
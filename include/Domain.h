@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cmath>
+#include "Vector3.h"
+#include "Vector3Array.h"
+
+// Axis-aligned simulation domain. Each axis is either open (particles may go
+// anywhere) or periodic over [lower, upper), in which case distances follow
+// the minimum image convention.
+struct Domain
+{
+    double lower[3] = {0.0, 0.0, 0.0};
+    double upper[3] = {0.0, 0.0, 0.0};
+    bool periodic[3] = {false, false, false};
+
+    // Unbounded domain
+    static Domain open() { return Domain(); }
+
+    // Box periodic along every axis
+    static Domain periodicBox(const Vector3d &lower, const Vector3d &upper)
+    {
+        Domain d;
+        const double lo[3] = {lower.getX(), lower.getY(), lower.getZ()};
+        const double hi[3] = {upper.getX(), upper.getY(), upper.getZ()};
+        for (int a = 0; a < 3; a++)
+        {
+            d.lower[a] = lo[a];
+            d.upper[a] = hi[a];
+            d.periodic[a] = true;
+        }
+        return d;
+    }
+
+    double length(int axis) const { return upper[axis] - lower[axis]; }
+    bool isPeriodic() const { return periodic[0] || periodic[1] || periodic[2]; }
+
+    // Map a displacement to its nearest periodic image
+    void minimumImage(double d[3]) const
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            if (periodic[a])
+            {
+                const double l = length(a);
+                d[a] -= l * std::round(d[a] / l);
+            }
+        }
+    }
+
+    // Coordinate folded back into [lower, upper) along a periodic axis
+    double wrap(double x, int axis) const
+    {
+        if (!periodic[axis])
+        {
+            return x;
+        }
+        const double l = length(axis);
+        double w = x - l * std::floor((x - lower[axis]) / l);
+        return w >= upper[axis] ? lower[axis] : w;
+    }
+
+    // Fold every position back into the box along the periodic axes
+    template <typename T>
+    void wrap(BasicVector3Array<T> &positions) const
+    {
+        AlignedVector<T> *components[3] = {&positions.x, &positions.y, &positions.z};
+        for (int a = 0; a < 3; a++)
+        {
+            if (!periodic[a])
+            {
+                continue;
+            }
+            for (T &x : *components[a])
+            {
+                x = static_cast<T>(wrap(static_cast<double>(x), a));
+            }
+        }
+    }
+};
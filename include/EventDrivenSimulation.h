@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CalendarQueue.h"
+#include "Domain.h"
+#include "ParticleSystem.h"
+
+// How EventDrivenSimulation treats impacts
+struct EventDrivenParameters
+{
+    double restitution = 1.0;      // 1 elastic; below 1 dense clusters can collapse into ever shorter intervals between impacts
+    double contactDuration = 1e-6; // an impact this soon after either sphere's previous one is elastic; > 0 prevents inelastic collapse
+    double eventsPerBucket = 2.0;  // calendar queue tuning: scheduled events per day of the queue
+};
+
+// Bookkeeping of an EventDrivenSimulation, summed until resetStatistics()
+struct EventDrivenStatistics
+{
+    std::size_t collisions = 0;     // sphere-sphere impacts
+    std::size_t elasticImpacts = 0; // inelastic impacts made elastic by EventDrivenParameters::contactDuration
+    std::size_t wallCollisions = 0; // reflections off the walls of non-periodic axes
+    std::size_t cellCrossings = 0;
+    std::size_t staleEvents = 0; // events popped after a particle they involve had changed course
+    std::size_t predictions = 0; // next-event searches
+    std::size_t rebuilds = 0;    // times the state was loaded from the ParticleSystem
+};
+
+// Event-driven dynamics of hard spheres of ParticleSystem::getRadius() in a
+// box: particles fly freely between impacts, and the simulation jumps from
+// one impact to the next in time order instead of taking fixed steps, so no
+// collision is missed however fast or dilute the gas.
+//
+// Every particle carries its own clock and is advanced analytically to
+// the current time only when an event touches it. Its next event is the
+// earliest of its exact time of impact with the spheres in the 27 cells
+// around it, with a wall, or with a boundary of its cell; cells are at
+// least one largest diameter wide, so spheres meet only after passing into
+// adjacent cells, which the cell crossings catch; after a crossing only
+// the newly adjacent cells are scanned. Each particle has one event
+// scheduled at a time, in a CalendarQueue.
+//
+// Events are invalidated lazily: every particle counts its impacts, and an
+// event records the counts of the particles it involves when it was
+// predicted. A popped event whose owner has changed course since is
+// dropped; one whose partner has is dropped and its owner's next event is
+// predicted afresh.
+//
+// Periodic axes of the Domain wrap; the others are hard walls at lower and
+// upper. The box must be bounded along every axis, and at least three
+// largest diameters long along the periodic ones. Particles of
+// non-positive mass are immovable obstacles.
+//
+// With restitution below 1, a cluster of spheres can undergo infinitely
+// many impacts in finite time (inelastic collapse), which would keep
+// advance() from ever returning. As in the TC model of Luding and
+// McNamara, an impact within contactDuration of the previous impact of
+// either sphere is treated as elastic, which ends the cascade.
+//
+// Between calls the state is kept in double precision; call invalidate()
+// after moving particles or changing their velocities or radii outside
+// advance().
+class EventDrivenSimulation
+{
+public:
+    explicit EventDrivenSimulation(const Domain &domain, const EventDrivenParameters &parameters = EventDrivenParameters());
+
+    // Process every event in the next `duration` and leave the particles at its end
+    void advance(ParticleSystem &system, double duration);
+
+    // Reload the particles on the next advance()
+    void invalidate() { valid = false; }
+
+    // Getters
+    double getTime() const { return now; }
+    const Domain &getDomain() const { return domain; }
+    const EventDrivenParameters &getParameters() const { return parameters; }
+    const EventDrivenStatistics &getStatistics() const { return statistics; }
+
+    // Setters
+    void setParameters(const EventDrivenParameters &p);
+    void resetStatistics() { statistics = EventDrivenStatistics(); }
+
+private:
+    enum class EventType : std::uint8_t
+    {
+        Collision,
+        Wall,
+        Crossing
+    };
+
+    struct Event
+    {
+        double time;
+        std::uint32_t particle;
+        std::uint32_t partner;        // the other sphere of a collision
+        std::uint32_t version;        // the particle's impact count when predicted
+        std::uint32_t partnerVersion; // the partner's
+        EventType type;
+        std::uint8_t axis;
+        std::int8_t direction; // +1 or -1 along axis, for walls and crossings
+    };
+
+    // Trajectory of a particle: position at its own clock `time`, packed so
+    // that a neighbour's trajectory is one cache line
+    struct State
+    {
+        double x[3];
+        double v[3];
+        double time;
+        double radius;
+    };
+
+    // Earliest impact found by a particle's last scan of its neighbours
+    struct Candidate
+    {
+        double time;
+        std::uint32_t partner; // NONE if there was none
+        std::uint32_t partnerVersion;
+    };
+
+    Domain domain;
+    EventDrivenParameters parameters;
+    EventDrivenStatistics statistics;
+    bool valid = false;
+    std::uint64_t layoutVersion = 0; // ParticleSystem::getLayoutVersion() the state refers to
+    double now = 0.0;
+
+    std::vector<State> states;
+    std::vector<double> inverseMass;
+    std::vector<std::uint32_t> version;
+    std::vector<double> lastImpact; // time of each particle's last sphere-sphere impact
+    std::vector<Candidate> candidates;
+
+    // Cells over the box; particles are linked into the cell of their center
+    int dims[3] = {1, 1, 1};
+    double cellSize[3] = {0.0, 0.0, 0.0};
+    std::vector<std::uint32_t> cellHead;
+    std::vector<std::uint32_t> next, previous;
+    std::vector<std::int32_t> cell; // cell coordinates, three per particle
+
+    CalendarQueue<Event> queue;
+
+    void load(const ParticleSystem &system);
+    void store(ParticleSystem &system);
+    void link(std::uint32_t i);
+    void unlink(std::uint32_t i);
+    void synchronize(std::uint32_t i);
+    bool nextEvent(std::uint32_t i, Event &event, const Event *crossing);
+    void predict(std::uint32_t i, const Event *crossing = nullptr);
+    void collide(std::uint32_t i, std::uint32_t j);
+    void reflect(const Event &event);
+    void cross(const Event &event);
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "CoulombForce.h"
+#include "ForceModel.h"
+#include "ParticleSystem.h"
+
+// Tuning knobs of the fast multipole method
+struct FastMultipoleParameters
+{
+    int expansionOrder = 4;      // highest harmonic degree p; error falls roughly like theta^(p+1)
+    double theta = 0.5;          // two cells interact through M2L when (r_a + r_b) / distance < theta
+    std::size_t leafSize = 64;   // maximum particles per leaf
+    std::size_t parallelThreshold = 8192; // fork large subtrees onto the ThreadPool above this many particles
+};
+
+// Cell of the adaptive FMM octree. Children are stored contiguously starting
+// at firstChild; leaves have childCount == 0 and own the sorted particles
+// [begin, end). Expansions are taken about the geometric center.
+struct FastMultipoleCell
+{
+    double center[3];
+    double halfSize;
+    double radius; // distance from the center to the farthest particle of the cell
+    std::uint32_t begin;
+    std::uint32_t end;
+    std::uint32_t firstChild;
+    std::uint32_t childCount;
+};
+
+// O(N) long-range force backend: fast multipole method over an adaptive
+// octree, with spherical-harmonic multipole and local expansions of Particle
+// charge (and mass, when gravity is enabled) up to a configurable order.
+//
+// Each step sorts the particles along a Morton curve, builds the tree, forms
+// multipole expansions bottom-up (P2M, M2M), converts them into local
+// expansions of well-separated cells with a dual tree traversal (M2L, P2P for
+// neighbors) and pushes the locals down to the particles (L2L, L2P). L2P and
+// P2P yield the potential along with the field, so every evaluation also
+// has the potential energy. The upward pass, the traversal and the
+// downward pass fork the subtrees of large cells as ThreadPool tasks.
+// Drop-in alternative to CoulombForce.
+class FastMultipoleForce : public ForceModel
+{
+public:
+    // Highest supported expansion order
+    static constexpr int MAX_EXPANSION_ORDER = 20;
+
+    explicit FastMultipoleForce(const CoulombParameters &parameters = CoulombParameters(),
+                                const FastMultipoleParameters &fmmParameters = FastMultipoleParameters());
+
+    void computeAccelerations(ParticleSystem &system) override;
+    double getPotentialEnergy() const override { return potentialEnergy; } // of the last computeAccelerations(), with the forces' expansion error
+
+    // Build the tree over the current positions without evaluating forces
+    void build(const ParticleSystem &system);
+
+    // Getters
+    const CoulombParameters &getParameters() const { return parameters; }
+    const FastMultipoleParameters &getFmmParameters() const { return fmmParameters; }
+    const std::vector<FastMultipoleCell> &getCells() const { return cells; }
+
+    // Setters
+    void setParameters(const CoulombParameters &p) { parameters = p; }
+    void setFmmParameters(const FastMultipoleParameters &p);
+    void setExpansionOrder(int order);
+    void setTheta(double theta);
+
+private:
+    CoulombParameters parameters;
+    FastMultipoleParameters fmmParameters;
+
+    std::vector<FastMultipoleCell> cells;
+
+    // Particle data in Morton order
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> order;
+    AlignedVector<double> sortedX, sortedY, sortedZ;
+    AlignedVector<double> sortedCharge, sortedMass;
+
+    // Field sum s (r - r') / |r - r'|^3 per sorted particle, one block per source kind
+    AlignedVector<double> fieldX, fieldY, fieldZ;
+    AlignedVector<double> potential; // sum s / |r - r'| per sorted particle, laid out like the fields
+    double potentialEnergy = 0.0;
+
+    // Expansion coefficients, `termCount()` per cell and source kind
+    std::vector<std::complex<double>> multipoles;
+    std::vector<std::complex<double>> locals;
+
+    std::size_t termCount() const;
+
+    template <bool Gravity>
+    void evaluate(ParticleSystem &system);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+#include "Vector3Array.h"
+
+// How pair forces, which are applied to both particles of a pair (Newton's
+// third law), are accumulated when several threads compute them. None of
+// the strategies uses atomics.
+//
+// Only Deterministic fixes the order in which every particle's pair terms
+// and the energy are summed independently of the thread count, so results
+// are bit-identical on 1 or 64 threads. The faster modes round differently
+// depending on the schedule and thread count, and fall back to serial
+// order on one thread or for small systems.
+enum class ForceAccumulation
+{
+    Serial,        // one thread writes every force
+    ThreadBuffers, // every task scatters into a private buffer; the buffers are summed afterwards
+    Coloring,      // work is split into colors whose tasks touch disjoint particles; colors run one after another
+    Deterministic  // the coloring schedule on any thread count, with fixed-order energy sums
+};
+
+// Parse "serial", "buffers", "coloring" or "deterministic"
+ForceAccumulation forceAccumulationFromName(const std::string &name);
+
+const char *forceAccumulationName(ForceAccumulation accumulation);
+
+// Private force buffers of ForceAccumulation::ThreadBuffers.
+//
+// A task acquires a buffer, adds its terms into it without synchronization
+// and releases it; a later task of the same pass may pick the same buffer
+// up again and add on top of the partial sums already there, so the pool
+// holds about one buffer per thread rather than one per task. Every buffer
+// is zero at begin(): reduceInto() clears the ones it summed, and begin()
+// clears any left over from a pass that never reached reduceInto().
+class ForceBufferPool
+{
+public:
+    // Size and zero the buffers for a pass over `size` particles
+    void begin(std::size_t size);
+
+    // Buffer of the current size, exclusively the caller's until release();
+    // holds this pass's partial sums of earlier tasks, so add, never assign
+    ForceArray &acquire();
+    void release(ForceArray &buffer);
+
+    // forces += every buffer used since begin(), vectorized and split over
+    // `pool`; leaves the buffers zeroed
+    void reduceInto(ForceArray &forces, ThreadPool &pool);
+
+    // Getters
+    std::size_t bufferCount() const { return buffers.size(); }
+
+private:
+    std::size_t size = 0;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ForceArray>> buffers;
+    std::vector<ForceArray *> freeBuffers;
+    std::vector<ForceArray *> usedBuffers; // acquired at least once since begin()
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "ParticleSystem.h"
+
+// Source of particle accelerations. Integrators call computeAccelerations()
+// whenever they need a(x) for the current positions.
+class ForceModel
+{
+public:
+    virtual ~ForceModel() = default;
+
+    // Overwrite the acceleration array of `system` with a(x) for the current positions
+    virtual void computeAccelerations(ParticleSystem &system) = 0;
+
+    // Overwrite the accelerations of the particles listed in `active` only,
+    // with every particle still acting as a source; the others may be left
+    // untouched. Used by block time stepping. The default evaluates every
+    // particle; models that really skip inactive targets have no potential
+    // energy (NaN) after such a call.
+    virtual void computeActiveAccelerations(ParticleSystem &system, const std::vector<std::uint32_t> & /* active */)
+    {
+        computeAccelerations(system);
+    }
+
+    // Potential energy at the positions of the last computeAccelerations(),
+    // computed in the same pass as the forces; NaN for models without one
+    virtual double getPotentialEnergy() const { return std::numeric_limits<double>::quiet_NaN(); }
+};
+
+// Adapts any callable `void(ParticleSystem &)` to a ForceModel
+class FunctionForceModel : public ForceModel
+{
+public:
+    explicit FunctionForceModel(std::function<void(ParticleSystem &)> function) : function(std::move(function)) {}
+
+    void computeAccelerations(ParticleSystem &system) override { function(system); }
+
+private:
+    std::function<void(ParticleSystem &)> function;
+};
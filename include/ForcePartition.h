@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "ForceModel.h"
+#include "ParticleSystem.h"
+#include "Vector3Array.h"
+
+// Time scale a force model is assigned to by a ForcePartition
+enum class ForceGroup
+{
+    Fast, // stiff, cheap near-field forces (bonds, short-range pair potentials)
+    Slow  // smooth, expensive far-field forces (long-range Coulomb and gravity)
+};
+
+// Sum of several force models, each assigned to the fast or the slow group.
+// As a plain ForceModel it evaluates every member; multiple time step
+// integrators (RespaIntegrator) evaluate the groups separately and at
+// different rates. The members are not owned and must outlive the partition.
+class ForcePartition : public ForceModel
+{
+public:
+    // Add `model` to `group`; the same model may not be added twice
+    void add(ForceModel &model, ForceGroup group);
+
+    // Sum of every member
+    void computeAccelerations(ParticleSystem &system) override;
+
+    // Overwrite the accelerations of `system` with the sum of the members
+    // of `group` only (zero if the group is empty)
+    void computeGroupAccelerations(ParticleSystem &system, ForceGroup group);
+
+    // Sums of the members' energies of their last evaluations; meaningful
+    // when all members involved were evaluated at the same positions
+    double getPotentialEnergy() const override;
+    double getGroupPotentialEnergy(ForceGroup group) const;
+
+    // Getters
+    std::size_t size() const { return members.size(); }
+    bool hasGroup(ForceGroup group) const;
+
+private:
+    struct Member
+    {
+        ForceModel *model;
+        ForceGroup group;
+    };
+
+    std::vector<Member> members;
+    Vector3Array partialSum; // accelerations of the members evaluated so far
+
+    template <typename Selected>
+    void accumulate(ParticleSystem &system, const Selected &selected);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include "Morton.h"
+
+// 3D Hilbert curve index with 21 bits per axis, packed into 63 bits like
+// Morton keys. Unlike the Z-order curve, consecutive Hilbert cells are
+// always face neighbors, so sorting by it keeps storage neighbors closer.
+namespace Hilbert
+{
+    // Skilling, "Programming the Hilbert curve" (2004): transform the
+    // coordinates into the transposed Hilbert index, then interleave its
+    // bits with the first axis most significant
+    inline std::uint64_t encode(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+    {
+        std::uint32_t X[3] = {x & Morton::AXIS_MAX, y & Morton::AXIS_MAX, z & Morton::AXIS_MAX};
+        const std::uint32_t highest = 1u << (Morton::BITS_PER_AXIS - 1);
+
+        // Inverse undo of the excess work
+        for (std::uint32_t q = highest; q > 1; q >>= 1)
+        {
+            const std::uint32_t p = q - 1;
+            for (int i = 0; i < 3; i++)
+            {
+                if (X[i] & q)
+                {
+                    X[0] ^= p;
+                }
+                else
+                {
+                    const std::uint32_t t = (X[0] ^ X[i]) & p;
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+            }
+        }
+
+        // Gray encode
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+        std::uint32_t t = 0;
+        for (std::uint32_t q = highest; q > 1; q >>= 1)
+        {
+            if (X[2] & q)
+            {
+                t ^= q - 1;
+            }
+        }
+        X[0] ^= t;
+        X[1] ^= t;
+        X[2] ^= t;
+
+        return Morton::encode(X[0], X[1], X[2]);
+    }
+}
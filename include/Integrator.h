@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ConservationMonitor.h"
+#include "ForceModel.h"
+#include "ForcePartition.h"
+#include "ParticleSystem.h"
+#include "Vector3Array.h"
+
+// Available time integration schemes
+enum class IntegratorType
+{
+    Euler,          // 1st order, not symplectic (same as Particle::update)
+    VelocityVerlet, // 2nd order symplectic, kick-drift-kick
+    Leapfrog,       // 2nd order symplectic, drift-kick-drift
+    Yoshida4,       // 4th order symplectic, three force evaluations per step
+    RK4,            // 4th order Runge-Kutta, not symplectic
+    BlockTimeStep,  // 2nd order, per-particle power-of-two steps
+    Respa           // 2nd order symplectic, slow forces every few fast steps
+};
+
+// Advances a whole ParticleSystem by one time step.
+//
+// Schemes that reuse the acceleration of the previous step (velocity Verlet)
+// compute it on their first step; call reset() if positions or forces are
+// changed from outside between steps.
+//
+// Every step begins with ParticleSystem::maintainLocality(), so a system
+// with an enabled ReorderPolicy may be re-sorted between steps.
+//
+// With a ConservationMonitor attached, one update pass per step also
+// measures the particle moments block by block and records them with the
+// potential energy of the last force evaluation, at the instant of that
+// evaluation: the end of the step for velocity Verlet and RK4 (whose last
+// stage is O(dt^3) off the end point), its start for Euler, and the last
+// kick of the drift-kick-drift schemes.
+class Integrator
+{
+public:
+    virtual ~Integrator() = default;
+
+    // Advance `system` by `deltaTime` using accelerations from `forces`
+    virtual void step(ParticleSystem &system, ForceModel &forces, double deltaTime) = 0;
+
+    // Drop any state carried over from the previous step
+    virtual void reset() {}
+
+    // Number of ForceModel evaluations per step
+    virtual int forceEvaluationsPerStep() const = 0;
+
+    virtual const char *name() const = 0;
+
+    // Getters
+    ConservationMonitor *getMonitor() const { return monitor; }
+
+    // Setters
+    void setMonitor(ConservationMonitor *m) { monitor = m; } // not owned, null to detach
+
+protected:
+    ConservationMonitor *monitor = nullptr;
+};
+
+class EulerIntegrator : public Integrator
+{
+public:
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    int forceEvaluationsPerStep() const override { return 1; }
+    const char *name() const override { return "euler"; }
+};
+
+class VelocityVerletIntegrator : public Integrator
+{
+public:
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    void reset() override { primed = false; }
+    int forceEvaluationsPerStep() const override { return 1; }
+    const char *name() const override { return "verlet"; }
+
+private:
+    bool primed = false;
+};
+
+class LeapfrogIntegrator : public Integrator
+{
+public:
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    int forceEvaluationsPerStep() const override { return 1; }
+    const char *name() const override { return "leapfrog"; }
+};
+
+class Yoshida4Integrator : public Integrator
+{
+public:
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    int forceEvaluationsPerStep() const override { return 3; }
+    const char *name() const override { return "yoshida4"; }
+};
+
+// Classic RK4 on (x, v). Scratch arrays are kept between steps so stepping
+// does not allocate once the particle count is stable.
+class RK4Integrator : public Integrator
+{
+public:
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    int forceEvaluationsPerStep() const override { return 4; }
+    const char *name() const override { return "rk4"; }
+
+private:
+    Vector3Array startPositions;
+    Vector3Array startVelocities;
+    Vector3Array positionSlope;
+    Vector3Array velocitySlope;
+};
+
+// Step size selection of BlockTimeStepIntegrator. A particle's step is the
+// smallest of deltaTime, sqrt(2 accuracy lengthScale / |a|) and
+// courant * lengthScale / |v|, rounded down to deltaTime / 2^level.
+struct BlockTimeStepParameters
+{
+    int maxLevel = 8;          // finest step is deltaTime / 2^maxLevel
+    double accuracy = 0.025;   // eta of the acceleration criterion
+    double courant = 0.25;     // fraction of lengthScale a particle may move per step
+    double lengthScale = 0.01; // softening length or smallest structure to resolve
+};
+
+// Hierarchical block time steps: every particle is assigned a power-of-two
+// fraction deltaTime / 2^level of the step from its own acceleration and
+// velocity, and is kicked (kick-drift-kick, as velocity Verlet) only at the
+// ends of its own steps. Between those instants all particles drift
+// together, but forces are evaluated only for the particles whose step ends
+// (ForceModel::computeActiveAccelerations()), so slow particles far from
+// the action cost one force evaluation per deltaTime instead of one per
+// finest step.
+//
+// Levels are reassigned whenever a particle's step ends; a particle may
+// only move to a coarser level at instants that are multiples of the
+// coarser step, so levels stay synchronized. At the end of step() every
+// particle is synchronized, with velocities and accelerations at the same
+// time as the positions. A particle whose criteria ask for a step finer
+// than maxLevel allows is held at maxLevel, under-resolved; such choices are
+// counted (getClampedSelections()) so a driver can raise maxLevel or shrink
+// deltaTime.
+class BlockTimeStepIntegrator : public Integrator
+{
+public:
+    explicit BlockTimeStepIntegrator(const BlockTimeStepParameters &parameters = BlockTimeStepParameters());
+
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    void reset() override { primed = false; }
+    int forceEvaluationsPerStep() const override { return lastForceCalls; } // force model calls of the last step, most of them partial
+    const char *name() const override { return "block"; }
+
+    // Getters
+    const BlockTimeStepParameters &getParameters() const { return parameters; }
+    const std::vector<std::uint8_t> &getLevels() const { return levels; } // of the last step, by particle index
+    std::size_t getActiveEvaluations() const { return activeEvaluations; } // particle accelerations computed in the last step
+    int getDeepestLevel() const { return deepestLevel; }                    // finest level any particle took during the last step
+    std::size_t getClampedSelections() const { return clampedSelections; } // level choices of the last step whose criteria wanted a step finer than maxLevel
+
+    // Setters
+    void setParameters(const BlockTimeStepParameters &p);
+
+private:
+    BlockTimeStepParameters parameters;
+    bool primed = false;
+    int lastForceCalls = 1;
+    std::size_t activeEvaluations = 0;
+    int deepestLevel = 0;
+    std::size_t clampedSelections = 0;
+
+    std::vector<std::uint8_t> levels;
+    std::vector<std::size_t> levelCounts;
+    std::vector<std::uint32_t> active;
+
+    // Level for a particle starting a step at `tick`; tracks the deepest level and the clamped choices
+    std::uint8_t selectLevel(const ParticleSystem &system, std::size_t index, double deltaTime, std::uint32_t tick);
+};
+
+struct RespaParameters
+{
+    int innerSteps = 4; // fast steps per slow step, k
+};
+
+// Reversible reference system propagator (r-RESPA), a velocity Verlet
+// splitting with two time scales: the slow group of a ForcePartition is
+// evaluated once per step and applied as half kicks at its ends, the fast
+// group is integrated with k velocity Verlet steps of deltaTime / k in
+// between. With an expensive, smooth far field in the slow group this costs
+// about one slow evaluation per k fast steps at the accuracy of plain
+// velocity Verlet with the small step, as long as deltaTime stays well
+// below the period of the fastest motion the slow forces take part in.
+//
+// A force model that is not a ForcePartition is treated as all fast,
+// which is velocity Verlet with k substeps. The accelerations of both
+// groups are carried over between steps; after a step the system holds
+// their sum.
+class RespaIntegrator : public Integrator
+{
+public:
+    explicit RespaIntegrator(const RespaParameters &parameters = RespaParameters());
+
+    void step(ParticleSystem &system, ForceModel &forces, double deltaTime) override;
+    void reset() override { primed = false; }
+    int forceEvaluationsPerStep() const override { return parameters.innerSteps; } // of the fast group; the slow one once
+    const char *name() const override { return "respa"; }
+
+    // Getters
+    const RespaParameters &getParameters() const { return parameters; }
+
+    // Setters
+    void setParameters(const RespaParameters &p);
+
+private:
+    RespaParameters parameters;
+    bool primed = false;
+    std::uint64_t layoutVersion = 0; // of the carried over accelerations
+
+    Vector3Array fastAccelerations;
+    Vector3Array slowAccelerations;
+};
+
+// Factory
+std::unique_ptr<Integrator> makeIntegrator(IntegratorType type);
+
+// Parse "euler", "verlet", "leapfrog", "yoshida4", "rk4", "block" or "respa"
+IntegratorType integratorTypeFromName(const std::string &name);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+// 3D Morton (Z-order) codes with 21 bits per axis, packed into 63 bits.
+// Bit 3k+2 comes from x, 3k+1 from y and 3k from z.
+namespace Morton
+{
+    constexpr int BITS_PER_AXIS = 21;
+    constexpr std::uint32_t AXIS_MAX = (1u << BITS_PER_AXIS) - 1;
+
+    // Insert two zero bits between each of the low 21 bits of v
+    constexpr std::uint64_t spreadBits(std::uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    constexpr std::uint64_t encode(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+    {
+        return (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+    }
+
+    // Octant (0-7) of a key at tree depth `level` (0 = children of the root)
+    constexpr unsigned octant(std::uint64_t key, int level)
+    {
+        return static_cast<unsigned>((key >> (3 * (BITS_PER_AXIS - 1 - level))) & 7);
+    }
+
+    // Quantize t in [0, 1] onto the 21-bit grid
+    inline std::uint32_t quantize(double t)
+    {
+        if (!(t > 0.0))
+        {
+            return 0;
+        }
+        double scaled = t * static_cast<double>(AXIS_MAX + 1);
+        return scaled >= static_cast<double>(AXIS_MAX) ? AXIS_MAX : static_cast<std::uint32_t>(scaled);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+// Cube around every particle of a system, grown by a hair so that no
+// particle quantizes onto its upper faces
+struct MortonCube
+{
+    double center[3];
+    double halfSize;
+};
+
+// Morton order of a system's particles within their bounding cube, as the
+// tree backends build on it: `keys` receives the sorted keys and `order`
+// the index of the particle at each sorted position. Keys are computed in
+// parallel and sorted with radixSort(), so equal keys keep index order.
+MortonCube mortonOrder(const ParticleSystem &system, std::vector<std::uint64_t> &keys, std::vector<std::uint32_t> &order,
+                       ThreadPool &pool = ThreadPool::global());
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Index of an interned particle name
+using NameId = std::uint32_t;
+
+// Process-wide table of interned particle names.
+//
+// Particles store a 4-byte NameId instead of a std::string, so names cost
+// nothing per particle beyond the id and every particle with the same name
+// shares one copy. Names are never removed; the empty name is always id 0.
+// Safe to call from several threads; returned references stay valid for the
+// lifetime of the program.
+namespace NameTable
+{
+    constexpr NameId EMPTY = 0;
+
+    // Id of `name`, adding it on first use
+    NameId intern(std::string_view name);
+
+    // Name of an id returned by intern(); throws std::invalid_argument for unknown ids
+    const std::string &lookup(NameId id);
+
+    // Number of distinct names, the empty one included
+    std::size_t size();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "CellGrid.h"
+#include "Domain.h"
+#include "ParticleSystem.h"
+
+// Bookkeeping of a NeighborList
+struct NeighborListStatistics
+{
+    std::size_t builds = 0;       // full rebuilds
+    std::size_t updates = 0;      // calls to update()
+    std::size_t pairs = 0;        // pairs stored in the current list
+    double maxDisplacement = 0.0; // largest displacement since the last build, as of the last update()
+
+    // Mean number of update() calls served by one build
+    double updatesPerBuild() const { return builds > 0 ? static_cast<double>(updates) / builds : 0.0; }
+};
+
+// Verlet neighbor list: every pair closer than cutoff + skin, stored once
+// (half list) in CSR form, so the partners of particle i are
+// neighbors[offsets[i] .. offsets[i + 1]).
+//
+// The list stays valid while no particle has moved more than skin / 2 since
+// it was built, because no pair can then have closed the gap from
+// cutoff + skin to cutoff. update() checks that and rebuilds (through a
+// CellGrid) only when needed.
+class NeighborList
+{
+public:
+    NeighborList(double cutoff, double skin);
+
+    // Rebuild when a particle moved more than skin / 2, the particle count
+    // or layout version changed or the list was invalidated. Returns true when it rebuilt.
+    bool update(const ParticleSystem &system, const Domain &domain = Domain());
+
+    // Unconditional rebuild
+    void build(const ParticleSystem &system, const Domain &domain = Domain());
+
+    // Force a rebuild on the next update(), e.g. after particles were teleported or the domain changed
+    void invalidate() { valid = false; }
+
+    // Call f(i, j, dx, dy, dz, r2) once for every listed pair currently
+    // closer than the cutoff, with (dx, dy, dz) = r_i - r_j (minimum image on
+    // periodic axes). Same contract as CellGrid::forEachPair.
+    template <typename PairFunction>
+    void forEachPair(const ParticleSystem &system, PairFunction &&f) const;
+
+    // Getters
+    double getCutoff() const { return cutoff; }
+    double getSkin() const { return skin; }
+    const std::vector<std::uint32_t> &getOffsets() const { return offsets; }
+    const std::vector<std::uint32_t> &getNeighbors() const { return neighbors; }
+    const NeighborListStatistics &getStatistics() const { return statistics; }
+    const CellGrid &getGrid() const { return grid; } // binning of the last build; row i's partners lie in cells adjacent to i's
+
+    // Setters; both invalidate the list
+    void setCutoff(double c);
+    void setSkin(double s);
+    void resetStatistics() { statistics = NeighborListStatistics(); }
+
+private:
+    double cutoff;
+    double skin;
+    bool valid = false;
+    std::uint64_t layoutVersion = 0; // ParticleSystem::getLayoutVersion() at the last build
+    Domain domain;
+    CellGrid grid;
+
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> neighbors;
+
+    // Positions at the last build
+    AlignedVector<double> referenceX, referenceY, referenceZ;
+
+    // Scratch buffers of build(), kept so rebuilds do not allocate
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+    std::vector<std::uint32_t> cursor;
+
+    NeighborListStatistics statistics;
+
+    double maxDisplacement(const ParticleSystem &system) const;
+};
+
+template <typename PairFunction>
+void NeighborList::forEachPair(const ParticleSystem &system, PairFunction &&f) const
+{
+    const Vector3Array &positions = system.getPositions();
+    const double cutoff2 = cutoff * cutoff;
+    const bool periodic = domain.isPeriodic();
+    const std::size_t n = offsets.empty() ? 0 : offsets.size() - 1;
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const double xi = positions.x[i], yi = positions.y[i], zi = positions.z[i];
+        for (std::uint32_t k = offsets[i]; k < offsets[i + 1]; k++)
+        {
+            const std::uint32_t j = neighbors[k];
+            double d[3] = {xi - positions.x[j], yi - positions.y[j], zi - positions.z[j]};
+            if (periodic)
+            {
+                domain.minimumImage(d);
+            }
+            const double r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+            if (r2 < cutoff2)
+            {
+                f(static_cast<std::uint32_t>(i), j, d[0], d[1], d[2], r2);
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "Domain.h"
+#include "ForceAccumulation.h"
+#include "ForceModel.h"
+#include "NeighborList.h"
+#include "ParticleSystem.h"
+#include "Vector3Array.h"
+
+// Functional form of a short-range pair potential
+enum class PairPotentialForm
+{
+    LennardJones, // U = 4 eps ((sigma / r)^12 - (sigma / r)^6)
+    Buckingham    // U = A exp(-r / rho) - C / r^6
+};
+
+// How the potential is brought to zero at the cutoff
+enum class CutoffTreatment
+{
+    ShiftedForce, // U(r) - U(rc) - (r - rc) U'(rc): force and energy both vanish at rc
+    Switching     // U(r) S(r), S smoothly goes from 1 at switchingRadius to 0 at rc
+};
+
+struct PairPotentialParameters
+{
+    PairPotentialForm form = PairPotentialForm::LennardJones;
+    CutoffTreatment cutoffTreatment = CutoffTreatment::ShiftedForce;
+    double cutoff = 2.5;          // rc, in position units
+    double switchingRadius = 2.0; // start of the switching region (Switching only)
+    double skin = 0.3;            // Verlet list skin
+    Domain domain;                // open or periodic simulation box; positions need not be wrapped into it
+    ForceAccumulation accumulation = ForceAccumulation::ThreadBuffers; // parallel strategy for the pair forces
+};
+
+// Short-range pair-potential force field (Lennard-Jones or Buckingham) for
+// neutral atoms, with parameters per pair of Particle species.
+//
+// Species parameters are flattened into S x S coefficient matrices (one
+// array per coefficient), rebuilt only when the parameters change, so the
+// per-pair lookup in the force loop is a single indexed load. Pairs come
+// from a Verlet neighbor list; the neighbors of each particle are gathered
+// into packed buffers so the potential itself is evaluated with vector
+// instructions. Rows of the list run on the ThreadPool with the selected
+// ForceAccumulation strategy.
+class PairPotentialForce : public ForceModel
+{
+public:
+    explicit PairPotentialForce(const PairPotentialParameters &parameters = PairPotentialParameters());
+
+    void computeAccelerations(ParticleSystem &system) override;
+
+    // Lennard-Jones parameters of one species; unlike pairs without an
+    // explicit entry use Lorentz-Berthelot mixing
+    void setLennardJones(std::uint16_t species, double epsilon, double sigma);
+
+    // Explicit Lennard-Jones parameters of a species pair
+    void setLennardJonesPair(std::uint16_t a, std::uint16_t b, double epsilon, double sigma);
+
+    // Buckingham parameters of a species pair (no mixing rule)
+    void setBuckinghamPair(std::uint16_t a, std::uint16_t b, double A, double rho, double C);
+
+    // Getters
+    const PairPotentialParameters &getParameters() const { return parameters; }
+    const NeighborList &getNeighborList() const { return neighbors; }
+    double getPotentialEnergy() const override { return potentialEnergy; } // of the last computeAccelerations()
+
+    // Setters
+    void setParameters(const PairPotentialParameters &p);
+
+private:
+    struct SpeciesLennardJones
+    {
+        double epsilon;
+        double sigma;
+        bool defined;
+    };
+
+    // Raw parameters of one species pair: (A, B, C) = (4 eps sigma^12, 4 eps sigma^6, 0)
+    // for Lennard-Jones and (A, 1 / rho, C) for Buckingham
+    struct PairEntry
+    {
+        double a, b, c;
+    };
+
+    PairPotentialParameters parameters;
+    NeighborList neighbors;
+
+    std::vector<SpeciesLennardJones> speciesLennardJones;
+    std::map<std::pair<std::uint16_t, std::uint16_t>, PairEntry> pairEntries;
+
+    // Flat S x S coefficient matrices, plus the values at the cutoff used by
+    // the shifted-force treatment
+    std::size_t speciesCount = 0;
+    bool tableDirty = true;
+    AlignedVector<double> coefficientA, coefficientB, coefficientC;
+    AlignedVector<double> cutoffEnergy, cutoffForce;
+
+    ForceArray forces;
+    ForceBufferPool buffers;
+    double potentialEnergy = 0.0;
+
+    // Cells of the neighbor list's grid by color, for ForceAccumulation::Coloring
+    // and Deterministic, plus the per-cell energies of the latter
+    std::vector<std::vector<std::uint32_t>> cellColors;
+    bool colorsDirty = true; // the neighbor list was rebuilt since the colors were taken
+    std::vector<double> cellEnergy;
+
+    void buildTable();
+
+    template <PairPotentialForm Form, CutoffTreatment Treatment, bool Periodic>
+    double accumulateForces(const ParticleSystem &system);
+};
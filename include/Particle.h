@@ -1,5 +1,10 @@
+#pragma once
+
 #include <Vector3.h>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include "NameTable.h"
 
 class Particle
 {
@@ -8,35 +13,44 @@ private:
     Vector3 velocity;
     Vector3 acceleration;
     Vector3 color;
-    double mass;
-    double radius;
-    double charge;
-    std::string name;
+    Real mass;
+    Real radius;
+    Real charge;
+    NameId name; // interned in NameTable
+    std::uint16_t species;
 
 public:
     // Constructor
     Particle(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
-             const Vector3 &color, double mass, double radius, double charge, const std::string &name);
+             const Vector3 &color, Real mass, Real radius, Real charge, std::string_view name,
+             std::uint16_t species = 0);
+
+    // Particle with the mass, radius, charge, color and name (symbol) of a Species entry
+    explicit Particle(std::uint16_t species, const Vector3 &position = Vector3(), const Vector3 &velocity = Vector3());
 
     // Getters
     Vector3 getPosition() const;
     Vector3 getVelocity() const;
     Vector3 getAcceleration() const;
     Vector3 getColor() const;
-    double getMass() const;
-    double getRadius() const;
-    double getCharge() const;
-    std::string getName() const;
+    Real getMass() const;
+    Real getRadius() const;
+    Real getCharge() const;
+    const std::string &getName() const;
+    NameId getNameId() const;
+    std::uint16_t getSpecies() const;
 
     // Setters
     void setPosition(const Vector3 &pos);
     void setVelocity(const Vector3 &vel);
     void setAcceleration(const Vector3 &acc);
     void setColor(const Vector3 &col);
-    void setMass(double m);
-    void setRadius(double r);
-    void setCharge(double c);
-    void setName(const std::string &n);
+    void setMass(Real m);
+    void setRadius(Real r);
+    void setCharge(Real c);
+    void setName(std::string_view n);
+    void setNameId(NameId n);
+    void setSpecies(std::uint16_t s);
 
     // Update particle state
     void update(double deltaTime);
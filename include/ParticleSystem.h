@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "NameTable.h"
+#include "Particle.h"
+#include "Species.h"
+#include "Vector3.h"
+#include "Vector3Array.h"
+
+class ParticleSystem;
+
+// Stable reference to a particle in a ParticleSystem, valid until the
+// particle is removed whatever reordering happens in between. Removing it
+// retires the handle for good: its slot may be reused by a later particle,
+// but with a new generation, so the old handle never aliases it.
+struct ParticleHandle
+{
+    static constexpr std::uint32_t NO_SLOT = 0xffffffffu;
+
+    std::uint32_t slot = NO_SLOT;
+    std::uint32_t generation = 0;
+
+    bool isNull() const { return slot == NO_SLOT; }
+    bool operator==(const ParticleHandle &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const ParticleHandle &other) const { return !(*this == other); }
+};
+
+// Space-filling curves ParticleSystem can sort its storage along
+enum class SpaceFillingCurve
+{
+    Morton, // Z-order; cheaper keys, jumps at octant boundaries
+    Hilbert // consecutive cells are face neighbors
+};
+
+// When ParticleSystem::maintainLocality() sorts the storage
+struct ReorderPolicy
+{
+    bool enabled = false; // off: maintainLocality() never touches the order
+    SpaceFillingCurve curve = SpaceFillingCurve::Hilbert;
+    std::size_t checkInterval = 10; // maintainLocality() calls between two measurements of localityMetric()
+    double degradation = 1.5;       // sort once localityMetric() exceeds this multiple of its value after the last sort
+};
+
+// Read-only view of a single particle stored inside a ParticleSystem.
+// Mirrors the getter API of Particle.
+class ConstParticleRef
+{
+public:
+    ConstParticleRef(const ParticleSystem &system, std::size_t index) : system(&system), idx(index) {}
+
+    std::size_t index() const { return idx; }
+
+    // Getters
+    Vector3 getPosition() const;
+    Vector3 getVelocity() const;
+    Vector3 getAcceleration() const;
+    Vector3 getColor() const;
+    Real getMass() const;
+    Real getRadius() const;
+    Real getCharge() const;
+    const std::string &getName() const;
+    NameId getNameId() const;
+    std::uint16_t getSpecies() const;
+    ParticleHandle getHandle() const;
+
+    // Copy the referenced particle out into a standalone object
+    Particle toParticle() const;
+    operator Particle() const { return toParticle(); }
+
+protected:
+    const ParticleSystem *system;
+    std::size_t idx;
+};
+
+// Mutable view of a single particle stored inside a ParticleSystem.
+// Mirrors the getter/setter API of Particle so code written against a single
+// Particle keeps working on system storage.
+class ParticleRef : public ConstParticleRef
+{
+public:
+    ParticleRef(ParticleSystem &system, std::size_t index) : ConstParticleRef(system, index) {}
+
+    // Setters
+    void setPosition(const Vector3 &pos) const;
+    void setVelocity(const Vector3 &vel) const;
+    void setAcceleration(const Vector3 &acc) const;
+    void setColor(const Vector3 &col) const;
+    void setMass(Real m) const;
+    void setRadius(Real r) const;
+    void setCharge(Real c) const;
+    void setName(std::string_view n) const;
+    void setSpecies(std::uint16_t s) const;
+
+    // Overwrite the referenced particle with the state of `p`
+    const ParticleRef &operator=(const Particle &p) const;
+
+    // Update particle state (explicit Euler, same as Particle::update)
+    void update(double deltaTime) const;
+
+private:
+    ParticleSystem &mutableSystem() const { return const_cast<ParticleSystem &>(*system); }
+};
+
+// Structure-of-arrays particle container.
+//
+// Hot per-particle state (position, velocity, acceleration, mass, charge,
+// species) lives in separate cache-line aligned arrays so that step loops
+// only stream the data they touch. Names are stored as NameTable ids.
+//
+// Radius and color, which no force kernel reads, default to the particle's
+// Species entry and take no per-particle storage. Their arrays are only
+// materialized once some particle deviates from its species default; from
+// then on every particle has its own value there. Mass and charge stay
+// per-particle, since the kernels stream them.
+//
+// Indices are storage positions and change when particles are removed or
+// the storage is reordered. The arrays never have holes: remove() moves the
+// last particle into the freed index. For references that survive that, a
+// slot map hands out generation-checked ParticleHandles; indexOf() resolves
+// one to the current index in O(1). Slots of removed particles go on a free
+// list and are reused, so once the arrays and the slot table have grown to
+// the peak particle count, add() and remove() no longer allocate. getLayoutVersion() changes
+// on every add() and remove() and whenever particles move to other
+// indices, so caches keyed by index can tell when to rebuild even when a
+// spawn has refilled the index of a removed particle.
+//
+// Sorting the storage along a space-filling curve puts particles that are
+// close in space close in memory, which keeps neighbor and cell loops in
+// cache. As particles diffuse that order decays; maintainLocality(), called
+// once per step by the integrators, measures it and re-sorts when it has
+// degraded (see ReorderPolicy).
+//
+// Float positions lose absolute resolution far from zero. recenter() moves
+// the coordinate origin into the middle of the particles, after which the
+// stored positions (and any Domain built on them) are relative to
+// getOrigin(). Mixed-precision builds also keep a Kahan compensation term
+// per position, materialized by the first drift, so that many small steps
+// do not round away.
+class ParticleSystem
+{
+public:
+    ParticleSystem() = default;
+    explicit ParticleSystem(const std::vector<Particle> &particles);
+
+    // Size management
+    std::size_t size() const { return masses.size(); }
+    bool empty() const { return masses.empty(); }
+    void reserve(std::size_t n);
+    void clear();
+
+    // Append a particle, returns its index
+    std::size_t add(const Particle &p);
+    std::size_t add(std::uint16_t species, const Vector3 &position, const Vector3 &velocity = Vector3()); // all properties from the Species entry
+    std::size_t add(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
+                    const Vector3 &color, Real mass, Real radius, Real charge, std::string_view name,
+                    std::uint16_t species = 0);
+
+    // Remove particle `index` by moving the last particle into its place
+    void remove(std::size_t index);
+    void remove(ParticleHandle handle) { remove(indexOf(handle)); }
+
+    // Handles
+    ParticleHandle getHandle(std::size_t index) const { return {slotOf[index], slots[slotOf[index]].generation}; }
+    bool contains(ParticleHandle handle) const
+    {
+        return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+    }
+    std::size_t indexOf(ParticleHandle handle) const; // throws std::invalid_argument for handles of removed particles
+    std::uint64_t getLayoutVersion() const { return layoutVersion; }
+
+    // Reorder the storage so that new index i holds the particle at old
+    // index order[i]; `order` must be a permutation of 0 .. size() - 1
+    void permute(const std::vector<std::uint32_t> &order);
+
+    // Sort the storage by the curve key of every position within the
+    // bounding box of all positions (parallel radix sort)
+    void sortSpatially(SpaceFillingCurve curve = SpaceFillingCurve::Hilbert);
+
+    // Mean distance between particles adjacent in storage; small when
+    // memory order follows space
+    double localityMetric() const;
+
+    // Measure the locality every policy.checkInterval calls and sort when it
+    // degraded past policy.degradation. Returns true when it reordered.
+    bool maintainLocality();
+
+    // Single-particle access
+    ParticleRef operator[](std::size_t index) { return ParticleRef(*this, index); }
+    ConstParticleRef operator[](std::size_t index) const { return ConstParticleRef(*this, index); }
+    Particle get(std::size_t index) const;
+    void set(std::size_t index, const Particle &p);
+
+    // Shift the stored positions so the center of their bounding box
+    // becomes the origin; getOrigin() accumulates the shifts
+    void recenter();
+    Vector3d getAbsolutePosition(std::size_t index) const { return origin + Vector3d(positions.get(index)); }
+
+    // Convert back to per-object storage
+    std::vector<Particle> toParticles() const;
+
+    // Component arrays
+    Vector3Array &getPositions() { return positions; }
+    const Vector3Array &getPositions() const { return positions; }
+    Vector3Array &getVelocities() { return velocities; }
+    const Vector3Array &getVelocities() const { return velocities; }
+    Vector3Array &getAccelerations() { return accelerations; }
+    const Vector3Array &getAccelerations() const { return accelerations; }
+    AlignedVector<Real> &getMasses() { return masses; }
+    const AlignedVector<Real> &getMasses() const { return masses; }
+    AlignedVector<Real> &getCharges() { return charges; }
+    const AlignedVector<Real> &getCharges() const { return charges; }
+    AlignedVector<std::uint16_t> &getSpecies() { return species; }
+    const AlignedVector<std::uint16_t> &getSpecies() const { return species; }
+    std::vector<NameId> &getNameIds() { return names; }
+    const std::vector<NameId> &getNameIds() const { return names; }
+
+    // Radius and color, from the override arrays when materialized, else from the species
+    Real getRadius(std::size_t index) const { return radii.empty() ? static_cast<Real>(Species::get(species[index]).radius) : radii[index]; }
+    Vector3 getColor(std::size_t index) const { return colors.empty() ? Species::get(species[index]).color : colors.get(index); }
+    void setRadius(std::size_t index, Real radius);
+    void setColor(std::size_t index, const Vector3 &color);
+    bool hasRadiusOverrides() const { return !radii.empty(); }
+    bool hasColorOverrides() const { return !colors.empty(); }
+
+    // Rounding error of the last position updates, see Integrator's drift
+    Vector3Array &getPositionCompensation();
+
+    // Getters
+    const ReorderPolicy &getReorderPolicy() const { return reorderPolicy; }
+    const Vector3d &getOrigin() const { return origin; }
+
+    // Setters
+    void setReorderPolicy(const ReorderPolicy &policy);
+
+    // Advance every particle by one explicit Euler step (same as Particle::update)
+    void update(double deltaTime);
+
+private:
+    // Slot map entry: the particle's index while live, the next free slot
+    // otherwise. Freeing a slot bumps its generation, which retires every
+    // handle issued for it.
+    struct Slot
+    {
+        std::uint32_t index;
+        std::uint32_t generation;
+    };
+
+    // Hot data
+    Vector3Array positions;
+    Vector3Array velocities;
+    Vector3Array accelerations;
+    AlignedVector<Real> masses;
+    AlignedVector<Real> charges;
+    AlignedVector<std::uint16_t> species; // Species entry, also the index into the species tables of the force models
+
+    // Relative coordinates
+    Vector3d origin;
+    Vector3Array positionCompensation; // empty until the first compensated drift
+
+    // Cold data
+    AlignedVector<Real> radii; // empty while every radius is its species default
+    Vector3Array colors; // empty while every color is its species default
+    std::vector<NameId> names;
+
+    // Identity
+    std::vector<std::uint32_t> slotOf; // slot of the particle at each index
+    std::vector<Slot> slots;
+    std::uint32_t freeSlot = ParticleHandle::NO_SLOT; // head of the free list
+    std::uint64_t layoutVersion = 0;
+
+    std::size_t append(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
+                       const Vector3 &color, Real mass, Real radius, Real charge, NameId name, std::uint16_t species);
+    void releaseSlot(std::uint32_t slot);
+    void materializeRadii();
+    void materializeColors();
+
+    // Locality maintenance
+    ReorderPolicy reorderPolicy;
+    std::size_t callsSinceCheck = 0;
+    bool localitySorted = false; // sortedLocality is valid
+    double sortedLocality = 0.0; // localityMetric() right after the last sort
+};
+
+// ConstParticleRef getters
+inline Vector3 ConstParticleRef::getPosition() const { return system->getPositions().get(idx); }
+inline Vector3 ConstParticleRef::getVelocity() const { return system->getVelocities().get(idx); }
+inline Vector3 ConstParticleRef::getAcceleration() const { return system->getAccelerations().get(idx); }
+inline Vector3 ConstParticleRef::getColor() const { return system->getColor(idx); }
+inline Real ConstParticleRef::getMass() const { return system->getMasses()[idx]; }
+inline Real ConstParticleRef::getRadius() const { return system->getRadius(idx); }
+inline Real ConstParticleRef::getCharge() const { return system->getCharges()[idx]; }
+inline const std::string &ConstParticleRef::getName() const { return NameTable::lookup(system->getNameIds()[idx]); }
+inline NameId ConstParticleRef::getNameId() const { return system->getNameIds()[idx]; }
+inline std::uint16_t ConstParticleRef::getSpecies() const { return system->getSpecies()[idx]; }
+inline ParticleHandle ConstParticleRef::getHandle() const { return system->getHandle(idx); }
+inline Particle ConstParticleRef::toParticle() const { return system->get(idx); }
+
+// ParticleRef setters
+inline void ParticleRef::setPosition(const Vector3 &pos) const { mutableSystem().getPositions().set(idx, pos); }
+inline void ParticleRef::setVelocity(const Vector3 &vel) const { mutableSystem().getVelocities().set(idx, vel); }
+inline void ParticleRef::setAcceleration(const Vector3 &acc) const { mutableSystem().getAccelerations().set(idx, acc); }
+inline void ParticleRef::setColor(const Vector3 &col) const { mutableSystem().setColor(idx, col); }
+inline void ParticleRef::setMass(Real m) const { mutableSystem().getMasses()[idx] = m; }
+inline void ParticleRef::setRadius(Real r) const { mutableSystem().setRadius(idx, r); }
+inline void ParticleRef::setCharge(Real c) const { mutableSystem().getCharges()[idx] = c; }
+inline void ParticleRef::setName(std::string_view n) const { mutableSystem().getNameIds()[idx] = NameTable::intern(n); }
+inline void ParticleRef::setSpecies(std::uint16_t s) const { mutableSystem().getSpecies()[idx] = s; }
+
+inline const ParticleRef &ParticleRef::operator=(const Particle &p) const
+{
+    mutableSystem().set(idx, p);
+    return *this;
+}
+
+inline void ParticleRef::update(double deltaTime) const
+{
+    const Real dt = static_cast<Real>(deltaTime);
+    setPosition(getPosition() + getVelocity() * dt);
+    setVelocity(getVelocity() + getAcceleration() * dt);
+}
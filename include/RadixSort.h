@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+
+// Stable LSD radix sort of 64-bit keys together with 32-bit payloads
+// (typically indices), one byte per pass.
+//
+// Bytes on which all keys agree are skipped, so e.g. 63-bit Morton keys of
+// a compact cloud take fewer than 8 passes. Every pass counts digits per
+// block of keys in parallel, turns the counts into per-block offsets in
+// block order and scatters the blocks in parallel, so the result does not
+// depend on the thread count.
+void radixSort(std::vector<std::uint64_t> &keys, std::vector<std::uint32_t> &values, ThreadPool &pool = ThreadPool::global());
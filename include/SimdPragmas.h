@@ -0,0 +1,12 @@
+#pragma once
+
+// Portable `#pragma omp simd` for inner loops that the compiler should
+// vectorize. The build enables OpenMP SIMD (-fopenmp-simd) without pulling in
+// the OpenMP runtime; without it the pragma expands to nothing.
+#define ATOM_PRAGMA(x) _Pragma(#x)
+
+#if defined(ATOM_OPENMP_SIMD) || defined(_OPENMP)
+#define ATOM_SIMD_LOOP(...) ATOM_PRAGMA(omp simd __VA_ARGS__)
+#else
+#define ATOM_SIMD_LOOP(...)
+#endif
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include "Vector3.h"
+
+// Default properties of one particle species. Masses are in unified atomic
+// mass units, charges in elementary charges and radii in angstrom
+// (covalent radii for neutral atoms, six-coordinate ionic radii for ions,
+// nominal display sizes for subatomic particles). Colors are the usual
+// CPK/Jmol element colors.
+struct SpeciesInfo
+{
+    const char *symbol = "";
+    const char *name = "";
+    int atomicNumber = 0; // 0 for non-atomic species
+    double mass = 0.0;
+    double charge = 0.0;
+    double radius = 0.0;
+    Vector3 color;
+};
+
+// Compile-time species database: electron, proton, neutron, the elements
+// hydrogen to xenon and a set of common monatomic ions.
+//
+// A particle's species index selects its entry. Indices from COUNT on are
+// free for user-defined species (e.g. extra rows of a PairPotentialForce
+// table) and resolve to the CUSTOM entry, as does CUSTOM itself, which
+// carries no physical defaults.
+namespace Species
+{
+    namespace detail
+    {
+        constexpr double ELECTRON_MASS = 5.48579909065e-4;
+
+        constexpr SpeciesInfo ELEMENTS[] = {
+        {"H", "hydrogen", 1, 1.008, 0.0, 0.31, Vector3(1, 1, 1)},
+        {"He", "helium", 2, 4.0026, 0.0, 0.28, Vector3(0.851, 1, 1)},
+        {"Li", "lithium", 3, 6.94, 0.0, 1.28, Vector3(0.8, 0.502, 1)},
+        {"Be", "beryllium", 4, 9.0122, 0.0, 0.96, Vector3(0.761, 1, 0)},
+        {"B", "boron", 5, 10.81, 0.0, 0.84, Vector3(1, 0.71, 0.71)},
+        {"C", "carbon", 6, 12.011, 0.0, 0.76, Vector3(0.565, 0.565, 0.565)},
+        {"N", "nitrogen", 7, 14.007, 0.0, 0.71, Vector3(0.188, 0.314, 0.973)},
+        {"O", "oxygen", 8, 15.999, 0.0, 0.66, Vector3(1, 0.051, 0.051)},
+        {"F", "fluorine", 9, 18.998, 0.0, 0.57, Vector3(0.565, 0.878, 0.314)},
+        {"Ne", "neon", 10, 20.180, 0.0, 0.58, Vector3(0.702, 0.89, 0.961)},
+        {"Na", "sodium", 11, 22.990, 0.0, 1.66, Vector3(0.671, 0.361, 0.949)},
+        {"Mg", "magnesium", 12, 24.305, 0.0, 1.41, Vector3(0.541, 1, 0)},
+        {"Al", "aluminium", 13, 26.982, 0.0, 1.21, Vector3(0.749, 0.651, 0.651)},
+        {"Si", "silicon", 14, 28.085, 0.0, 1.11, Vector3(0.941, 0.784, 0.627)},
+        {"P", "phosphorus", 15, 30.974, 0.0, 1.07, Vector3(1, 0.502, 0)},
+        {"S", "sulfur", 16, 32.06, 0.0, 1.05, Vector3(1, 1, 0.188)},
+        {"Cl", "chlorine", 17, 35.45, 0.0, 1.02, Vector3(0.122, 0.941, 0.122)},
+        {"Ar", "argon", 18, 39.948, 0.0, 1.06, Vector3(0.502, 0.82, 0.89)},
+        {"K", "potassium", 19, 39.098, 0.0, 2.03, Vector3(0.561, 0.251, 0.831)},
+        {"Ca", "calcium", 20, 40.078, 0.0, 1.76, Vector3(0.239, 1, 0)},
+        {"Sc", "scandium", 21, 44.956, 0.0, 1.70, Vector3(0.902, 0.902, 0.902)},
+        {"Ti", "titanium", 22, 47.867, 0.0, 1.60, Vector3(0.749, 0.761, 0.78)},
+        {"V", "vanadium", 23, 50.942, 0.0, 1.53, Vector3(0.651, 0.651, 0.671)},
+        {"Cr", "chromium", 24, 51.996, 0.0, 1.39, Vector3(0.541, 0.6, 0.78)},
+        {"Mn", "manganese", 25, 54.938, 0.0, 1.39, Vector3(0.612, 0.478, 0.78)},
+        {"Fe", "iron", 26, 55.845, 0.0, 1.32, Vector3(0.878, 0.4, 0.2)},
+        {"Co", "cobalt", 27, 58.933, 0.0, 1.26, Vector3(0.941, 0.565, 0.627)},
+        {"Ni", "nickel", 28, 58.693, 0.0, 1.24, Vector3(0.314, 0.816, 0.314)},
+        {"Cu", "copper", 29, 63.546, 0.0, 1.32, Vector3(0.784, 0.502, 0.2)},
+        {"Zn", "zinc", 30, 65.38, 0.0, 1.22, Vector3(0.49, 0.502, 0.69)},
+        {"Ga", "gallium", 31, 69.723, 0.0, 1.22, Vector3(0.761, 0.561, 0.561)},
+        {"Ge", "germanium", 32, 72.630, 0.0, 1.20, Vector3(0.4, 0.561, 0.561)},
+        {"As", "arsenic", 33, 74.922, 0.0, 1.19, Vector3(0.741, 0.502, 0.89)},
+        {"Se", "selenium", 34, 78.971, 0.0, 1.20, Vector3(1, 0.631, 0)},
+        {"Br", "bromine", 35, 79.904, 0.0, 1.20, Vector3(0.651, 0.161, 0.161)},
+        {"Kr", "krypton", 36, 83.798, 0.0, 1.16, Vector3(0.361, 0.722, 0.82)},
+        {"Rb", "rubidium", 37, 85.468, 0.0, 2.20, Vector3(0.439, 0.18, 0.69)},
+        {"Sr", "strontium", 38, 87.62, 0.0, 1.95, Vector3(0, 1, 0)},
+        {"Y", "yttrium", 39, 88.906, 0.0, 1.90, Vector3(0.58, 1, 1)},
+        {"Zr", "zirconium", 40, 91.224, 0.0, 1.75, Vector3(0.58, 0.878, 0.878)},
+        {"Nb", "niobium", 41, 92.906, 0.0, 1.64, Vector3(0.451, 0.761, 0.788)},
+        {"Mo", "molybdenum", 42, 95.95, 0.0, 1.54, Vector3(0.329, 0.71, 0.71)},
+        {"Tc", "technetium", 43, 98, 0.0, 1.47, Vector3(0.231, 0.62, 0.62)},
+        {"Ru", "ruthenium", 44, 101.07, 0.0, 1.46, Vector3(0.141, 0.561, 0.561)},
+        {"Rh", "rhodium", 45, 102.91, 0.0, 1.42, Vector3(0.039, 0.49, 0.549)},
+        {"Pd", "palladium", 46, 106.42, 0.0, 1.39, Vector3(0, 0.412, 0.522)},
+        {"Ag", "silver", 47, 107.87, 0.0, 1.45, Vector3(0.753, 0.753, 0.753)},
+        {"Cd", "cadmium", 48, 112.41, 0.0, 1.44, Vector3(1, 0.851, 0.561)},
+        {"In", "indium", 49, 114.82, 0.0, 1.42, Vector3(0.651, 0.459, 0.451)},
+        {"Sn", "tin", 50, 118.71, 0.0, 1.39, Vector3(0.4, 0.502, 0.502)},
+        {"Sb", "antimony", 51, 121.76, 0.0, 1.39, Vector3(0.62, 0.388, 0.71)},
+        {"Te", "tellurium", 52, 127.60, 0.0, 1.38, Vector3(0.831, 0.478, 0)},
+        {"I", "iodine", 53, 126.90, 0.0, 1.39, Vector3(0.58, 0, 0.58)},
+        {"Xe", "xenon", 54, 131.29, 0.0, 1.40, Vector3(0.259, 0.62, 0.69)},
+        };
+
+        constexpr SpeciesInfo ionOf(int atomicNumber, const char *symbol, const char *name, int charge, double radius)
+        {
+            const SpeciesInfo &atom = ELEMENTS[atomicNumber - 1];
+            return {symbol, name, atomicNumber, atom.mass - charge * ELECTRON_MASS, static_cast<double>(charge), radius, atom.color};
+        }
+
+        constexpr SpeciesInfo IONS[] = {
+        ionOf(3, "Li+", "lithium ion", 1, 0.76),
+        ionOf(11, "Na+", "sodium ion", 1, 1.02),
+        ionOf(19, "K+", "potassium ion", 1, 1.38),
+        ionOf(12, "Mg2+", "magnesium ion", 2, 0.72),
+        ionOf(20, "Ca2+", "calcium ion", 2, 1.0),
+        ionOf(8, "O2-", "oxide", -2, 1.4),
+        ionOf(9, "F-", "fluoride", -1, 1.33),
+        ionOf(17, "Cl-", "chloride", -1, 1.81),
+        ionOf(35, "Br-", "bromide", -1, 1.96),
+        ionOf(53, "I-", "iodide", -1, 2.2),
+        };
+    }
+
+    constexpr std::uint16_t CUSTOM = 0;
+    constexpr std::uint16_t ELECTRON = 1;
+    constexpr std::uint16_t PROTON = 2;
+    constexpr std::uint16_t NEUTRON = 3;
+    constexpr std::uint16_t FIRST_ELEMENT = 4;
+    constexpr std::uint16_t ELEMENT_COUNT = static_cast<std::uint16_t>(std::size(detail::ELEMENTS));
+    constexpr std::uint16_t FIRST_ION = FIRST_ELEMENT + ELEMENT_COUNT;
+    constexpr std::uint16_t COUNT = FIRST_ION + static_cast<std::uint16_t>(std::size(detail::IONS));
+
+    namespace detail
+    {
+        constexpr std::array<SpeciesInfo, COUNT> buildTable()
+        {
+            std::array<SpeciesInfo, COUNT> table{};
+            table[CUSTOM] = {"X", "custom", 0, 1.0, 0.0, 1.0, Vector3(1, 1, 1)};
+            table[ELECTRON] = {"e-", "electron", 0, ELECTRON_MASS, -1.0, 0.1, Vector3(1, 1, 0)};
+            table[PROTON] = {"p+", "proton", 0, 1.007276466621, 1.0, 0.1, Vector3(1, 0, 0)};
+            table[NEUTRON] = {"n", "neutron", 0, 1.00866491595, 0.0, 0.1, Vector3(0.5, 0.5, 0.5)};
+            for (std::uint16_t i = 0; i < ELEMENT_COUNT; i++)
+            {
+                table[FIRST_ELEMENT + i] = ELEMENTS[i];
+            }
+            for (std::uint16_t i = 0; i < COUNT - FIRST_ION; i++)
+            {
+                table[FIRST_ION + i] = IONS[i];
+            }
+            return table;
+        }
+    }
+
+    constexpr std::array<SpeciesInfo, COUNT> TABLE = detail::buildTable();
+
+    // Entry of a species index
+    constexpr const SpeciesInfo &get(std::uint16_t species)
+    {
+        return TABLE[species < COUNT ? species : CUSTOM];
+    }
+
+    // Species index of the neutral element with this atomic number
+    constexpr std::uint16_t element(int atomicNumber)
+    {
+        return atomicNumber >= 1 && atomicNumber <= ELEMENT_COUNT
+                   ? static_cast<std::uint16_t>(FIRST_ELEMENT + atomicNumber - 1)
+                   : throw std::invalid_argument("No species entry for this atomic number.");
+    }
+
+    // Species index of a symbol such as "Ar", "Na+" or "e-"; COUNT if unknown
+    constexpr std::uint16_t find(std::string_view symbol)
+    {
+        for (std::uint16_t i = 0; i < COUNT; i++)
+        {
+            if (symbol == TABLE[i].symbol)
+            {
+                return i;
+            }
+        }
+        return COUNT;
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "ParticleSystem.h"
+
+// Two particles whose spheres overlap, as storage indices with i != j
+struct CollisionPair
+{
+    std::uint32_t i;
+    std::uint32_t j;
+};
+
+// Bookkeeping of a SweepAndPrune
+struct SweepAndPruneStatistics
+{
+    std::size_t updates = 0;    // calls to update()
+    std::size_t fullSorts = 0;  // updates that rebuilt the order with a radix sort
+    std::size_t moves = 0;      // entries shifted by the insertion sort or merged in, summed over all updates
+    std::size_t entries = 0;    // (particle, column) entries swept in the last update
+    std::size_t candidates = 0; // pairs whose x extents overlap within a column, in the last update
+    std::size_t contacts = 0;   // pairs whose spheres overlap, in the last update
+};
+
+// Sweep-and-prune broad phase with a sphere-sphere narrow phase, for
+// particles of radius ParticleSystem::getRadius().
+//
+// Space is cut into columns along y and z, a few largest diameters wide,
+// and every particle is entered into each column its y-z bounding box
+// overlaps (at most four). Within a column the entries are kept sorted by
+// the lower end of their x extent [x - r, x + r], and a sweep along x pairs
+// each entry with the later ones whose extent starts before its own ends.
+// A pair sharing several columns is reported only from the column holding
+// the lower corner of the intersection of their boxes.
+//
+// The order is kept between updates: positions change little from one
+// frame to the next, so an insertion sort restores it in close to O(N).
+// Entries of columns a particle left are dropped, and those of columns it
+// entered are sorted on their own and merged in. If that would shift more
+// than a few entries per particle, or particles left the column grid, the
+// order is rebuilt with a radix sort instead.
+//
+// Candidates are tested against the full sphere on copies of the positions
+// and radii in sweep order, a contiguous loop the compiler vectorizes.
+// Columns are swept in parallel; the contacts come out in the same order on
+// any thread count. Open space only: periodic images are not considered.
+class SweepAndPrune
+{
+public:
+    // Re-sort the current positions and collect every overlapping pair
+    void update(const ParticleSystem &system);
+
+    // Rebuild the order from scratch on the next update(), e.g. after particles were teleported
+    void invalidate() { valid = false; }
+
+    // Getters
+    const std::vector<CollisionPair> &getContacts() const { return contacts; } // of the last update(), i < j not guaranteed
+    const SweepAndPruneStatistics &getStatistics() const { return statistics; }
+
+    // Setters
+    void resetStatistics() { statistics = SweepAndPruneStatistics(); }
+
+private:
+    // A particle's sphere and the columns of its box: the one of its lower
+    // corner and whether it reaches into the next along y (bit 0) and z
+    // (bit 1). Packed so that entries fetch their particle with one load.
+    struct Box
+    {
+        double x, y, z, radius;
+        std::uint32_t firstColumn;
+        unsigned char span;
+    };
+
+    // One entry in sweep order, for moving it around
+    struct Entry
+    {
+        std::uint32_t particle;
+        std::uint32_t column;
+        double lower, x, y, z, radius;
+    };
+
+    bool valid = false;
+    std::uint64_t layoutVersion = 0; // ParticleSystem::getLayoutVersion() the entries refer to
+
+    // Column grid over y and z, kept while every particle stays inside it
+    double origin[2] = {0.0, 0.0};
+    double inverseColumnSize = 0.0;
+    double columnSize = 0.0;
+    int dims[2] = {0, 0};
+
+    // Boxes of the particles by storage index, and their columns as of the previous update
+    std::vector<Box> boxes;
+    std::vector<std::uint32_t> previousFirstColumn;
+    std::vector<unsigned char> previousSpan;
+
+    // Entries in sweep order: particle, column, lower end of the x extent,
+    // then the narrow phase copies of position and radius
+    std::vector<std::uint32_t> particle;
+    std::vector<std::uint32_t> column;
+    AlignedVector<double> lower;
+    AlignedVector<double> x, y, z, radius;
+    std::vector<unsigned char> kept; // entry still inside its particle's box
+
+    std::vector<std::uint32_t> columnStart; // entries of column c are [columnStart[c], columnStart[c + 1])
+
+    std::vector<CollisionPair> contacts;
+    std::vector<std::vector<CollisionPair>> rowContacts; // per z row of columns, concatenated in row order
+    std::vector<std::size_t> rowCandidates;
+
+    // Scratch of refresh() and of the radix sort
+    std::vector<Entry> entered;
+    std::vector<std::uint64_t> keys;
+    std::vector<std::uint32_t> permutation;
+
+    SweepAndPruneStatistics statistics;
+
+    bool fitGrid(const ParticleSystem &system);
+    std::uint32_t columnOf(double py, double pz) const;
+    bool inBox(std::uint32_t c, std::uint32_t first, unsigned char boxSpan) const;
+    void computeBoxes(const ParticleSystem &system);
+    Entry entry(std::size_t k) const;
+    void store(std::size_t k, const Entry &e);
+    void resize(std::size_t count);
+    bool insertionSort(std::size_t count, std::size_t budget);
+    bool refresh();
+    void rebuild();
+    void findContacts();
+    void sweep(std::uint32_t c, std::vector<CollisionPair> &out, std::size_t &candidates) const;
+    void narrowPhase(std::size_t a, std::size_t begin, std::size_t end, std::uint32_t c, std::vector<CollisionPair> &out) const;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Work-stealing task scheduler shared by the force, integration and analysis
+// phases.
+//
+// Every worker owns a deque: tasks it spawns go to the back and it pops them
+// from the back (most recent, cache-warm work first), while idle workers
+// steal from the front of other deques, which holds the oldest and for
+// recursively split work the largest pieces. Threads outside the pool submit
+// through a shared queue. A thread that waits for tasks runs queued tasks
+// instead of blocking, so fork/join nests freely.
+class ThreadPool
+{
+public:
+    // `threadCount` includes the calling thread, which helps while it waits;
+    // 0 uses every hardware thread
+    explicit ThreadPool(std::size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Process-wide pool sized to the hardware, or to the ATOM_THREADS environment variable
+    static ThreadPool &global();
+
+    // Call body(i0, i1) over disjoint chunks covering [begin, end) and return
+    // when all are done. The range is split in halves down to a grain chosen
+    // from its length and the thread count (never below `minGrain`), so
+    // stealing keeps the cores balanced while small ranges run inline.
+    template <typename Body>
+    void parallelFor(std::size_t begin, std::size_t end, Body &&body, std::size_t minGrain = 1);
+
+    // Sum of map(i0, i1) over the blocks [begin + k * blockSize, ...) of
+    // [begin, end), computed in parallel but added in block order. Blocks do
+    // not depend on the thread count, so neither does the rounding.
+    template <typename T, typename Map>
+    T orderedReduce(std::size_t begin, std::size_t end, std::size_t blockSize, T identity, Map &&map);
+
+    // Run one queued task on the calling thread; false when there was none
+    bool runPendingTask();
+
+    // Getters
+    std::size_t size() const { return workers.size() + 1; } // threads working on a parallelFor, caller included
+
+private:
+    friend class TaskGroup;
+
+    struct Task
+    {
+        std::function<void()> work;
+        TaskGroup *group;
+    };
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // One deque per worker, then the shared queue of outside threads
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> queued{0};
+    bool stopping = false;
+
+    void submit(Task task);
+    bool pop(Task &task);
+    void execute(Task &task);
+    void workerLoop(std::size_t index);
+
+    template <typename Body>
+    static void split(TaskGroup &group, std::size_t begin, std::size_t end, std::size_t grain, Body &body);
+};
+
+// Fork/join scope: run() forks tasks onto a ThreadPool, wait() joins them.
+// The first exception thrown by a task is rethrown from wait(). The
+// destructor waits too, so tasks may capture locals by reference.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool &pool = ThreadPool::global()) : pool(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    template <typename Function>
+    void run(Function &&f);
+
+    void wait();
+
+private:
+    friend class ThreadPool;
+
+    ThreadPool &pool;
+    std::atomic<std::size_t> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    void join();
+};
+
+template <typename Function>
+void TaskGroup::run(Function &&f)
+{
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pool.submit(ThreadPool::Task{std::function<void()>(std::forward<Function>(f)), this});
+}
+
+template <typename Body>
+void ThreadPool::split(TaskGroup &group, std::size_t begin, std::size_t end, std::size_t grain, Body &body)
+{
+    // Fork the upper half until the rest is one grain; thieves take the
+    // halves forked first, which are the largest
+    while (end - begin > grain)
+    {
+        const std::size_t middle = begin + (end - begin) / 2;
+        group.run([&group, &body, middle, end, grain]()
+                  { split(group, middle, end, grain, body); });
+        end = middle;
+    }
+    body(begin, end);
+}
+
+template <typename Body>
+void ThreadPool::parallelFor(std::size_t begin, std::size_t end, Body &&body, std::size_t minGrain)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+    // About eight chunks per thread leaves room for stealing to even out
+    // uneven chunks without drowning short ranges in task overhead
+    const std::size_t count = end - begin;
+    const std::size_t grain = std::max<std::size_t>(std::max<std::size_t>(minGrain, 1), (count + 8 * size() - 1) / (8 * size()));
+    if (size() == 1 || count <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+    TaskGroup group(*this);
+    split(group, begin, end, grain, body);
+    group.wait();
+}
+
+template <typename T, typename Map>
+T ThreadPool::orderedReduce(std::size_t begin, std::size_t end, std::size_t blockSize, T identity, Map &&map)
+{
+    if (end <= begin)
+    {
+        return identity;
+    }
+    blockSize = std::max<std::size_t>(blockSize, 1);
+    const std::size_t blocks = (end - begin + blockSize - 1) / blockSize;
+    std::vector<T> partials(blocks, identity);
+    parallelFor(0, blocks, [&](std::size_t first, std::size_t last)
+                {
+                    for (std::size_t k = first; k < last; k++)
+                    {
+                        const std::size_t blockBegin = begin + k * blockSize;
+                        partials[k] = map(blockBegin, std::min(end, blockBegin + blockSize));
+                    } });
+    T sum = identity;
+    for (const T &partial : partials)
+    {
+        sum = sum + partial;
+    }
+    return sum;
+}
@@ -1,46 +1,116 @@
+#pragma once
+
 #include <stdexcept>
 #include <cmath>
+#include <type_traits>
+#include "VectorExpression.h"
+
+// Scalar type used for simulation state. Configure with
+// -DATOM_SINGLE_PRECISION=ON to store everything as float, which halves the
+// memory traffic of large runs that do not need double precision.
+//
+// -DATOM_MIXED_PRECISION=ON also stores the state and runs the force kernels
+// in float, but keeps the quantities that accumulate rounding error in
+// AccumReal = double: per-particle force sums, potential energies and the
+// compensation terms of the position update.
+#if defined(ATOM_SINGLE_PRECISION) && defined(ATOM_MIXED_PRECISION)
+#error "ATOM_SINGLE_PRECISION and ATOM_MIXED_PRECISION are mutually exclusive"
+#elif defined(ATOM_SINGLE_PRECISION)
+using Real = float;
+using AccumReal = float;
+#elif defined(ATOM_MIXED_PRECISION)
+using Real = float;
+using AccumReal = double;
+#else
+using Real = double;
+using AccumReal = double;
+#endif
+
+// State is float but sums are double
+constexpr bool MIXED_PRECISION = !std::is_same<Real, AccumReal>::value;
 
-class Vector3
+// Header-only 3D vector over scalar type T (float or double). Everything
+// except magnitude()/normalize() is constexpr so it fully inlines into the
+// hot loops without relying on LTO. Arithmetic operators are provided by
+// VectorExpression.h and build expression templates that are evaluated when
+// assigned back to a Vector3T.
+template <typename T>
+class Vector3T : public VectorExpr<Vector3T<T>>
 {
 private:
-    double x, y, z;
+    T x, y, z;
 
 public:
+    using value_type = T;
+
     // Constructor
-    Vector3(double x = 0.0, double y = 0.0, double z = 0.0);
+    constexpr Vector3T(T x = T(0), T y = T(0), T z = T(0)) : x(x), y(y), z(z) {}
+
+    // Conversion between precisions
+    template <typename U>
+    constexpr explicit Vector3T(const Vector3T<U> &other)
+        : x(static_cast<T>(other.getX())), y(static_cast<T>(other.getY())), z(static_cast<T>(other.getZ())) {}
+
+    // Evaluate a vector expression
+    template <typename E, typename = std::enable_if_t<!std::is_same<E, Vector3T>::value &&
+                                                      std::is_same<typename E::value_type, T>::value>>
+    constexpr Vector3T(const VectorExpr<E> &e) : x(e.self().getX()), y(e.self().getY()), z(e.self().getZ()) {}
 
     // Getters
-    double getX() const;
-    double getY() const;
-    double getZ() const;
+    constexpr T getX() const { return x; }
+    constexpr T getY() const { return y; }
+    constexpr T getZ() const { return z; }
 
     // Setters
-    void setX(double x);
-    void setY(double y);
-    void setZ(double z);
-
-    // Vector addition
-    Vector3 operator+(const Vector3 &other) const;
+    constexpr void setX(T x) { this->x = x; }
+    constexpr void setY(T y) { this->y = y; }
+    constexpr void setZ(T z) { this->z = z; }
 
-    // Vector subtraction
-    Vector3 operator-(const Vector3 &other) const;
+    // Compound assignment
+    template <typename E>
+    constexpr Vector3T &operator+=(const VectorExpr<E> &e) { return *this = *this + e.self(); }
 
-    // Scalar multiplication
-    Vector3 operator*(double scalar) const;
+    template <typename E>
+    constexpr Vector3T &operator-=(const VectorExpr<E> &e) { return *this = *this - e.self(); }
 
-    // Scalar division
-    Vector3 operator/(double scalar) const;
+    constexpr Vector3T &operator*=(T scalar) { return *this = *this * scalar; }
+    constexpr Vector3T &operator/=(T scalar) { return *this = *this / scalar; }
 
     // Dot product
-    double dot(const Vector3 &other) const;
+    constexpr T dot(const Vector3T &other) const
+    {
+        return x * other.x + y * other.y + z * other.z;
+    }
 
     // Cross product
-    Vector3 cross(const Vector3 &other) const;
+    constexpr Vector3T cross(const Vector3T &other) const
+    {
+        return Vector3T(
+            y * other.z - z * other.y,
+            z * other.x - x * other.z,
+            x * other.y - y * other.x);
+    }
 
     // Magnitude (length) of the vector
-    double magnitude() const;
+    T magnitude() const
+    {
+        return std::sqrt(x * x + y * y + z * z);
+    }
 
     // Normalize the vector
-    Vector3 normalize() const;
-};
\ No newline at end of file
+    Vector3T normalize() const
+    {
+        T mag = magnitude();
+        if (mag == T(0))
+        {
+            throw std::invalid_argument("Cannot normalize a zero vector.");
+        }
+        return Vector3T(x / mag, y / mag, z / mag);
+    }
+};
+
+using Vector3f = Vector3T<float>;
+using Vector3d = Vector3T<double>;
+
+// Vector type used for simulation state
+using Vector3 = Vector3T<Real>;
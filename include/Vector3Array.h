@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include "AlignedAllocator.h"
+#include "Vector3.h"
+
+// Structure-of-arrays storage for a sequence of 3D vectors: one aligned,
+// contiguous array per component.
+template <typename T>
+class BasicVector3Array
+{
+public:
+    using value_type = T;
+
+    AlignedVector<T> x;
+    AlignedVector<T> y;
+    AlignedVector<T> z;
+
+    // Size management
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void resize(std::size_t n)
+    {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+    }
+
+    void reserve(std::size_t n)
+    {
+        x.reserve(n);
+        y.reserve(n);
+        z.reserve(n);
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    void push_back(const Vector3T<T> &v)
+    {
+        x.push_back(v.getX());
+        y.push_back(v.getY());
+        z.push_back(v.getZ());
+    }
+
+    void pop_back()
+    {
+        x.pop_back();
+        y.pop_back();
+        z.pop_back();
+    }
+
+    // Element access
+    Vector3T<T> get(std::size_t i) const { return Vector3T<T>(x[i], y[i], z[i]); }
+
+    void set(std::size_t i, const Vector3T<T> &v)
+    {
+        x[i] = v.getX();
+        y[i] = v.getY();
+        z[i] = v.getZ();
+    }
+
+    // Fill every element with the same value
+    void fill(const Vector3T<T> &v)
+    {
+        for (std::size_t i = 0; i < size(); i++)
+        {
+            set(i, v);
+        }
+    }
+};
+
+// Vector array used for simulation state
+using Vector3Array = BasicVector3Array<Real>;
+
+// Per-particle force sums
+using ForceArray = BasicVector3Array<AccumReal>;
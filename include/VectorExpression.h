@@ -0,0 +1,309 @@
+#pragma once
+
+// Expression templates for Vector3T.
+//
+// `a + b * s - c / t` builds a small tree of expression nodes instead of three
+// Vector3T temporaries; the tree is evaluated component by component when it
+// is assigned to a Vector3T, in a single pass. Sums and differences with a
+// scaled operand are contracted into fused multiply-adds when the target has
+// hardware FMA.
+//
+// Define ATOM_EAGER_VECTOR_OPS to make every operator return a Vector3T
+// immediately, e.g. to step through vector math in a debugger.
+//
+// Leaf vectors are captured by reference when they are lvalues, so an
+// expression must not outlive the vectors it was built from. Temporaries are
+// captured by value and are always safe.
+
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class Vector3T;
+
+#if defined(__FMA__) || defined(FP_FAST_FMA) || (defined(_MSC_VER) && defined(__AVX2__))
+#define ATOM_HAS_HARDWARE_FMA 1
+#endif
+
+#if defined(__cpp_lib_is_constant_evaluated)
+#define ATOM_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif (defined(__GNUC__) && __GNUC__ >= 9) || (defined(__clang__) && __clang_major__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#define ATOM_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+template <typename E>
+class VectorExpr;
+
+namespace VectorExprDetail
+{
+    template <typename T>
+    struct IsVector3 : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsVector3<Vector3T<T>> : std::true_type
+    {
+    };
+
+    template <typename E>
+    constexpr bool isExpr = std::is_base_of<VectorExpr<std::decay_t<E>>, std::decay_t<E>>::value;
+
+    // How an operand is held inside a node: lvalue vectors by reference,
+    // everything else (nodes, temporaries) by value
+    template <typename A>
+    using Stored = std::conditional_t<std::is_lvalue_reference<A>::value && IsVector3<std::decay_t<A>>::value,
+                                      const std::decay_t<A> &, std::decay_t<A>>;
+
+    // Component I of a vector or expression
+    template <int I, typename E>
+    constexpr auto component(const E &e)
+    {
+        if constexpr (I == 0)
+        {
+            return e.getX();
+        }
+        else if constexpr (I == 1)
+        {
+            return e.getY();
+        }
+        else
+        {
+            return e.getZ();
+        }
+    }
+
+    // a * b + c, fused when it is cheap to do so
+    template <typename T>
+    constexpr T multiplyAdd(T a, T b, T c)
+    {
+#if defined(ATOM_HAS_HARDWARE_FMA) && defined(ATOM_IS_CONSTANT_EVALUATED)
+        if (!ATOM_IS_CONSTANT_EVALUATED())
+        {
+            return std::fma(a, b, c);
+        }
+#endif
+        return a * b + c;
+    }
+
+    // Finish an operator: keep the node, or evaluate it in eager mode
+    template <typename Node>
+    constexpr auto finish(const Node &node)
+    {
+#ifdef ATOM_EAGER_VECTOR_OPS
+        return node.eval();
+#else
+        return node;
+#endif
+    }
+}
+
+// CRTP base of Vector3T and every expression node
+template <typename E>
+class VectorExpr
+{
+public:
+    constexpr const E &self() const { return static_cast<const E &>(*this); }
+
+    // Evaluate into a concrete vector
+    constexpr auto eval() const
+    {
+        using T = std::decay_t<decltype(self().getX())>;
+        return Vector3T<T>(self().getX(), self().getY(), self().getZ());
+    }
+
+    // Non-componentwise operations evaluate their operands first
+    template <typename R>
+    constexpr auto dot(const VectorExpr<R> &other) const { return eval().dot(other.eval()); }
+
+    template <typename R>
+    constexpr auto cross(const VectorExpr<R> &other) const { return eval().cross(other.eval()); }
+
+    auto magnitude() const { return eval().magnitude(); }
+    auto normalize() const { return eval().normalize(); }
+};
+
+// l + r
+template <typename SL, typename SR>
+class VectorSum : public VectorExpr<VectorSum<SL, SR>>
+{
+public:
+    using value_type = typename std::decay_t<SL>::value_type;
+
+    constexpr VectorSum(SL l, SR r) : l(l), r(r) {}
+
+    constexpr value_type getX() const { return get<0>(); }
+    constexpr value_type getY() const { return get<1>(); }
+    constexpr value_type getZ() const { return get<2>(); }
+
+private:
+    SL l;
+    SR r;
+
+    template <int I>
+    constexpr value_type get() const;
+};
+
+// l - r
+template <typename SL, typename SR>
+class VectorDifference : public VectorExpr<VectorDifference<SL, SR>>
+{
+public:
+    using value_type = typename std::decay_t<SL>::value_type;
+
+    constexpr VectorDifference(SL l, SR r) : l(l), r(r) {}
+
+    constexpr value_type getX() const { return get<0>(); }
+    constexpr value_type getY() const { return get<1>(); }
+    constexpr value_type getZ() const { return get<2>(); }
+
+private:
+    SL l;
+    SR r;
+
+    template <int I>
+    constexpr value_type get() const;
+};
+
+// v * s
+template <typename SV>
+class VectorScaled : public VectorExpr<VectorScaled<SV>>
+{
+public:
+    using value_type = typename std::decay_t<SV>::value_type;
+
+    constexpr VectorScaled(SV v, value_type s) : v(v), s(s) {}
+
+    constexpr value_type getX() const { return v.getX() * s; }
+    constexpr value_type getY() const { return v.getY() * s; }
+    constexpr value_type getZ() const { return v.getZ() * s; }
+
+    constexpr const std::decay_t<SV> &vector() const { return v; }
+    constexpr value_type factor() const { return s; }
+
+private:
+    SV v;
+    value_type s;
+};
+
+// v / s
+template <typename SV>
+class VectorQuotient : public VectorExpr<VectorQuotient<SV>>
+{
+public:
+    using value_type = typename std::decay_t<SV>::value_type;
+
+    constexpr VectorQuotient(SV v, value_type s) : v(v), s(s)
+    {
+        if (s == value_type(0))
+        {
+            throw std::invalid_argument("Division by zero is not allowed.");
+        }
+    }
+
+    constexpr value_type getX() const { return v.getX() / s; }
+    constexpr value_type getY() const { return v.getY() / s; }
+    constexpr value_type getZ() const { return v.getZ() / s; }
+
+private:
+    SV v;
+    value_type s;
+};
+
+namespace VectorExprDetail
+{
+    template <typename E>
+    struct IsScaled : std::false_type
+    {
+    };
+
+    template <typename SV>
+    struct IsScaled<VectorScaled<SV>> : std::true_type
+    {
+    };
+}
+
+template <typename SL, typename SR>
+template <int I>
+constexpr typename VectorSum<SL, SR>::value_type VectorSum<SL, SR>::get() const
+{
+    using namespace VectorExprDetail;
+    if constexpr (IsScaled<std::decay_t<SR>>::value)
+    {
+        return multiplyAdd(component<I>(r.vector()), r.factor(), component<I>(l));
+    }
+    else if constexpr (IsScaled<std::decay_t<SL>>::value)
+    {
+        return multiplyAdd(component<I>(l.vector()), l.factor(), component<I>(r));
+    }
+    else
+    {
+        return component<I>(l) + component<I>(r);
+    }
+}
+
+template <typename SL, typename SR>
+template <int I>
+constexpr typename VectorDifference<SL, SR>::value_type VectorDifference<SL, SR>::get() const
+{
+    using namespace VectorExprDetail;
+    if constexpr (IsScaled<std::decay_t<SR>>::value)
+    {
+        return multiplyAdd(-component<I>(r.vector()), r.factor(), component<I>(l));
+    }
+    else if constexpr (IsScaled<std::decay_t<SL>>::value)
+    {
+        return multiplyAdd(component<I>(l.vector()), l.factor(), -component<I>(r));
+    }
+    else
+    {
+        return component<I>(l) - component<I>(r);
+    }
+}
+
+// Vector addition
+template <typename A, typename B,
+          typename = std::enable_if_t<VectorExprDetail::isExpr<A> && VectorExprDetail::isExpr<B>>>
+constexpr auto operator+(A &&a, B &&b)
+{
+    using namespace VectorExprDetail;
+    return finish(VectorSum<Stored<A &&>, Stored<B &&>>(std::forward<A>(a), std::forward<B>(b)));
+}
+
+// Vector subtraction
+template <typename A, typename B,
+          typename = std::enable_if_t<VectorExprDetail::isExpr<A> && VectorExprDetail::isExpr<B>>>
+constexpr auto operator-(A &&a, B &&b)
+{
+    using namespace VectorExprDetail;
+    return finish(VectorDifference<Stored<A &&>, Stored<B &&>>(std::forward<A>(a), std::forward<B>(b)));
+}
+
+// Scalar multiplication
+template <typename A, typename S,
+          typename = std::enable_if_t<VectorExprDetail::isExpr<A> && std::is_arithmetic<S>::value>>
+constexpr auto operator*(A &&a, S s)
+{
+    using namespace VectorExprDetail;
+    using T = typename std::decay_t<A>::value_type;
+    return finish(VectorScaled<Stored<A &&>>(std::forward<A>(a), static_cast<T>(s)));
+}
+
+template <typename S, typename A,
+          typename = std::enable_if_t<VectorExprDetail::isExpr<A> && std::is_arithmetic<S>::value>>
+constexpr auto operator*(S s, A &&a)
+{
+    return std::forward<A>(a) * s;
+}
+
+// Scalar division
+template <typename A, typename S,
+          typename = std::enable_if_t<VectorExprDetail::isExpr<A> && std::is_arithmetic<S>::value>>
+constexpr auto operator/(A &&a, S s)
+{
+    using namespace VectorExprDetail;
+    using T = typename std::decay_t<A>::value_type;
+    return finish(VectorQuotient<Stored<A &&>>(std::forward<A>(a), static_cast<T>(s)));
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include "Vector3Array.h"
+
+// Non-owning view over `size` 3D vectors stored as three component arrays.
+template <typename T>
+struct BasicVector3Span
+{
+    T *x = nullptr;
+    T *y = nullptr;
+    T *z = nullptr;
+    std::size_t size = 0;
+
+    BasicVector3Span() = default;
+    BasicVector3Span(T *x, T *y, T *z, std::size_t size) : x(x), y(y), z(z), size(size) {}
+
+    // Mutable spans convert to read-only spans
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+    BasicVector3Span(const BasicVector3Span<U> &other) : x(other.x), y(other.y), z(other.z), size(other.size) {}
+
+    // Sub-range [offset, offset + count)
+    BasicVector3Span subspan(std::size_t offset, std::size_t count) const
+    {
+        return BasicVector3Span(x + offset, y + offset, z + offset, count);
+    }
+};
+
+// Spans over simulation state
+using Vector3Span = BasicVector3Span<Real>;
+using ConstVector3Span = BasicVector3Span<const Real>;
+
+template <typename T>
+BasicVector3Span<T> makeSpan(BasicVector3Array<T> &a)
+{
+    return BasicVector3Span<T>(a.x.data(), a.y.data(), a.z.data(), a.size());
+}
+
+template <typename T>
+BasicVector3Span<const T> makeSpan(const BasicVector3Array<T> &a)
+{
+    return BasicVector3Span<const T>(a.x.data(), a.y.data(), a.z.data(), a.size());
+}
+
+// Instruction sets the batch kernels are compiled for, in increasing order
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+// Table of batch kernel entry points for one instruction set and scalar type
+template <typename T>
+struct VectorKernelTable
+{
+    using Span = BasicVector3Span<T>;
+    using ConstSpan = BasicVector3Span<const T>;
+
+    void (*add)(ConstSpan a, ConstSpan b, Span out);
+    void (*sub)(ConstSpan a, ConstSpan b, Span out);
+    void (*scale)(ConstSpan a, T s, Span out);
+    void (*axpy)(T alpha, ConstSpan x, Span y);
+    void (*dot)(ConstSpan a, ConstSpan b, T *out);
+    void (*cross)(ConstSpan a, ConstSpan b, Span out);
+    void (*magnitude)(ConstSpan a, T *out);
+    void (*normalize)(ConstSpan a, Span out);
+};
+
+// Float and double kernels for one instruction set
+struct VectorKernelSet
+{
+    VectorKernelTable<float> f32;
+    VectorKernelTable<double> f64;
+};
+
+// Batch Vector3 arithmetic over spans of vectors.
+//
+// Every kernel exists in a scalar, SSE2, AVX2 and AVX-512 flavor. The best
+// flavor supported by the running CPU is picked once at startup, so the same
+// binary runs on every x86-64 host. Float spans run at twice the lane count of
+// double spans. All spans passed to one call must have the same size; `out`
+// may alias an input.
+namespace VectorKernels
+{
+    // out[i] = a[i] + b[i]
+    void add(BasicVector3Span<const float> a, BasicVector3Span<const float> b, BasicVector3Span<float> out);
+    void add(BasicVector3Span<const double> a, BasicVector3Span<const double> b, BasicVector3Span<double> out);
+
+    // out[i] = a[i] - b[i]
+    void sub(BasicVector3Span<const float> a, BasicVector3Span<const float> b, BasicVector3Span<float> out);
+    void sub(BasicVector3Span<const double> a, BasicVector3Span<const double> b, BasicVector3Span<double> out);
+
+    // out[i] = a[i] * s
+    void scale(BasicVector3Span<const float> a, float s, BasicVector3Span<float> out);
+    void scale(BasicVector3Span<const double> a, double s, BasicVector3Span<double> out);
+
+    // y[i] += alpha * x[i]
+    void axpy(float alpha, BasicVector3Span<const float> x, BasicVector3Span<float> y);
+    void axpy(double alpha, BasicVector3Span<const double> x, BasicVector3Span<double> y);
+
+    // out[i] = a[i] . b[i]
+    void dot(BasicVector3Span<const float> a, BasicVector3Span<const float> b, float *out);
+    void dot(BasicVector3Span<const double> a, BasicVector3Span<const double> b, double *out);
+
+    // out[i] = a[i] x b[i]
+    void cross(BasicVector3Span<const float> a, BasicVector3Span<const float> b, BasicVector3Span<float> out);
+    void cross(BasicVector3Span<const double> a, BasicVector3Span<const double> b, BasicVector3Span<double> out);
+
+    // out[i] = |a[i]|
+    void magnitude(BasicVector3Span<const float> a, float *out);
+    void magnitude(BasicVector3Span<const double> a, double *out);
+
+    // out[i] = a[i] / |a[i]|, zero vectors stay zero
+    void normalize(BasicVector3Span<const float> a, BasicVector3Span<float> out);
+    void normalize(BasicVector3Span<const double> a, BasicVector3Span<double> out);
+
+    // Highest instruction set supported by this CPU and OS
+    SimdLevel detectSimdLevel();
+
+    // Instruction set the kernels currently dispatch to
+    SimdLevel activeSimdLevel();
+
+    // Force a lower instruction set (e.g. for benchmarking or debugging).
+    // Requests above what the CPU supports are clamped. Not thread-safe with
+    // respect to concurrent kernel calls.
+    SimdLevel setSimdLevel(SimdLevel level);
+
+    const char *simdLevelName(SimdLevel level);
+}
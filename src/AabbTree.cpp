@@ -0,0 +1,682 @@
+#include "AabbTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "ThreadPool.h"
+
+namespace
+{
+    // Particles per task of the gather, escape and contact passes
+    const std::size_t PARALLEL_GRAIN = 8192;
+
+    // Subtrees at least this large are built as separate tasks, and their
+    // bins are filled in parallel blocks of BIN_BLOCK leaves
+    const std::uint32_t PARALLEL_BUILD = 16384;
+    const std::size_t BIN_BLOCK = 8192;
+
+    // Candidate split planes per node of the SAH build
+    const int BINS = 16;
+
+    // Deeper than this the build splits at the median, which bounds the depth
+    // on inputs where the SAH keeps cutting off a few leaves; so do ranges of
+    // at most MEDIAN_SPLIT leaves, where binning costs more than it saves
+    const int MAX_SAH_DEPTH = 48;
+    const std::uint32_t MEDIAN_SPLIT = 16;
+
+    // Queries per task of the batched queries
+    const std::size_t QUERY_GRAIN = 256;
+
+    const double INF = std::numeric_limits<double>::infinity();
+
+    Aabb emptyBox()
+    {
+        Aabb box;
+        for (int a = 0; a < 3; a++)
+        {
+            box.lower[a] = INF;
+            box.upper[a] = -INF;
+        }
+        return box;
+    }
+
+    void grow(Aabb &box, const Aabb &other)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            box.lower[a] = std::min(box.lower[a], other.lower[a]);
+            box.upper[a] = std::max(box.upper[a], other.upper[a]);
+        }
+    }
+
+    // Centroid bounds of a range, summable over blocks
+    struct Bounds
+    {
+        Aabb box = emptyBox();
+
+        Bounds operator+(const Bounds &other) const
+        {
+            Bounds sum = *this;
+            grow(sum.box, other.box);
+            return sum;
+        }
+    };
+
+    // Leaf boxes and counts per bin along one axis, summable over blocks
+    struct Bins
+    {
+        Aabb box[BINS];
+        std::uint32_t count[BINS];
+
+        Bins()
+        {
+            for (int b = 0; b < BINS; b++)
+            {
+                box[b] = emptyBox();
+                count[b] = 0;
+            }
+        }
+
+        Bins operator+(const Bins &other) const
+        {
+            Bins sum = *this;
+            for (int b = 0; b < BINS; b++)
+            {
+                grow(sum.box[b], other.box[b]);
+                sum.count[b] += other.count[b];
+            }
+            return sum;
+        }
+    };
+
+    // Smallest parameter in [0, tFar] at which a ray is inside a box, given
+    // the inverse of its direction; infinity if there is none
+    double rayBox(const Aabb &box, const double origin[3], const double inverse[3], double tFar)
+    {
+        double tNear = 0.0;
+        for (int a = 0; a < 3; a++)
+        {
+            if (std::isinf(inverse[a]))
+            {
+                // Parallel to the slab: inside it or never
+                if (origin[a] < box.lower[a] || origin[a] > box.upper[a])
+                {
+                    return INF;
+                }
+                continue;
+            }
+            double t0 = (box.lower[a] - origin[a]) * inverse[a];
+            double t1 = (box.upper[a] - origin[a]) * inverse[a];
+            if (t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+            tNear = std::max(tNear, t0);
+            tFar = std::min(tFar, t1);
+            if (tNear > tFar)
+            {
+                return INF;
+            }
+        }
+        return tNear;
+    }
+}
+
+// Constructor
+AabbTree::AabbTree(const AabbTreeParameters &parameters)
+{
+    setParameters(parameters);
+}
+
+void AabbTree::setParameters(const AabbTreeParameters &p)
+{
+    if (!(p.relativeMargin >= 0.0) || !(p.absoluteMargin >= 0.0))
+    {
+        throw std::invalid_argument("AABB tree margins must be non-negative.");
+    }
+    if (!(p.degradation >= 1.0))
+    {
+        throw std::invalid_argument("AABB tree degradation must be at least 1.");
+    }
+    parameters = p;
+}
+
+// Boxes of a leaf's sphere, tight and fattened
+Aabb AabbTree::sphereBox(std::size_t rank) const
+{
+    const double r = radius[rank];
+    Aabb box;
+    box.lower[0] = x[rank] - r;
+    box.lower[1] = y[rank] - r;
+    box.lower[2] = z[rank] - r;
+    box.upper[0] = x[rank] + r;
+    box.upper[1] = y[rank] + r;
+    box.upper[2] = z[rank] + r;
+    return box;
+}
+
+Aabb AabbTree::fattenedBox(std::size_t rank) const
+{
+    const double r = radius[rank] * (1.0 + parameters.relativeMargin) + parameters.absoluteMargin;
+    Aabb box;
+    box.lower[0] = x[rank] - r;
+    box.lower[1] = y[rank] - r;
+    box.lower[2] = z[rank] - r;
+    box.upper[0] = x[rank] + r;
+    box.upper[1] = y[rank] + r;
+    box.upper[2] = z[rank] + r;
+    return box;
+}
+
+// Copy the spheres into leaf rank order
+void AabbTree::gather(const ParticleSystem &system)
+{
+    const Vector3Array &positions = system.getPositions();
+    const std::size_t n = order.size();
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    radius.resize(n);
+    ThreadPool::global().parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t k = begin; k < end; k++)
+                                         {
+                                             const std::uint32_t p = order[k];
+                                             x[k] = positions.x[p];
+                                             y[k] = positions.y[p];
+                                             z[k] = positions.z[p];
+                                             radius[k] = system.getRadius(p);
+                                         } },
+                                     PARALLEL_GRAIN);
+}
+
+bool AabbTree::update(const ParticleSystem &system)
+{
+    statistics.updates++;
+    statistics.escapes = 0;
+    const std::size_t n = system.size();
+    if (n != order.size() || system.getLayoutVersion() != layoutVersion)
+    {
+        // Leaves refer to storage indices that moved: start from the storage order
+        order.resize(n);
+        for (std::size_t k = 0; k < n; k++)
+        {
+            order[k] = static_cast<std::uint32_t>(k);
+        }
+        layoutVersion = system.getLayoutVersion();
+        valid = false;
+    }
+    gather(system);
+    if (!valid)
+    {
+        build();
+        return true;
+    }
+
+    // Refatten the leaves whose sphere escaped
+    statistics.escapes = ThreadPool::global().orderedReduce(std::size_t(0), n, PARALLEL_GRAIN, std::size_t(0),
+                                                            [&](std::size_t begin, std::size_t end)
+                                                            {
+                                                                std::size_t escapes = 0;
+                                                                for (std::size_t k = begin; k < end; k++)
+                                                                {
+                                                                    Node &leaf = nodes[leafNode[k]];
+                                                                    if (!leaf.box.contains(sphereBox(k)))
+                                                                    {
+                                                                        leaf.box = fattenedBox(k);
+                                                                        escapes++;
+                                                                    }
+                                                                }
+                                                                return escapes;
+                                                            });
+    if (statistics.escapes == 0)
+    {
+        return false;
+    }
+    statistics.refits++;
+    statistics.cost = refit();
+    if (statistics.cost > parameters.degradation * builtCost)
+    {
+        build();
+        return true;
+    }
+    return false;
+}
+
+// Recompute every internal box from its children, children before parents,
+// and return the SAH cost
+double AabbTree::refit()
+{
+    double area = 0.0;
+    for (std::size_t i = nodes.size(); i-- > 0;)
+    {
+        Node &node = nodes[i];
+        if (node.leaf != INTERNAL)
+        {
+            continue;
+        }
+        node.box = nodes[i + 1].box;
+        grow(node.box, nodes[nodes[i + 1].skip].box);
+        area += node.box.surfaceArea();
+    }
+    const double rootArea = nodes.empty() ? 0.0 : nodes[0].box.surfaceArea();
+    return rootArea > 0.0 ? area / rootArea : 0.0;
+}
+
+// SAH build over the fattened boxes of the current leaves; leaves get new
+// ranks in depth-first order
+void AabbTree::build()
+{
+    const std::size_t n = order.size();
+    primitives.resize(n);
+    ThreadPool::global().parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t k = begin; k < end; k++)
+                                         {
+                                             Primitive &primitive = primitives[k];
+                                             primitive.box = fattenedBox(k);
+                                             primitive.center[0] = x[k];
+                                             primitive.center[1] = y[k];
+                                             primitive.center[2] = z[k];
+                                             primitive.rank = static_cast<std::uint32_t>(k);
+                                         } },
+                                     PARALLEL_GRAIN);
+    nodes.resize(n > 0 ? 2 * n - 1 : 0);
+    leafNode.resize(n);
+    if (n > 0)
+    {
+        buildRange(0, 0, static_cast<std::uint32_t>(n), 0);
+    }
+
+    // Move the spheres and particles to their new ranks
+    const std::vector<std::uint32_t> oldOrder = order;
+    const AlignedVector<double> oldRadius = radius;
+    ThreadPool::global().parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t k = begin; k < end; k++)
+                                         {
+                                             const Primitive &primitive = primitives[k];
+                                             order[k] = oldOrder[primitive.rank];
+                                             x[k] = primitive.center[0];
+                                             y[k] = primitive.center[1];
+                                             z[k] = primitive.center[2];
+                                             radius[k] = oldRadius[primitive.rank];
+                                         } },
+                                     PARALLEL_GRAIN);
+
+    statistics.rebuilds++;
+    statistics.cost = refit();
+    builtCost = statistics.cost;
+    valid = true;
+}
+
+// Build the subtree of primitives[begin, end) at `node`; it takes the
+// 2 (end - begin) - 1 nodes from there, and the primitives are partitioned
+// in place so that their final positions are the leaf ranks
+void AabbTree::buildRange(std::uint32_t node, std::uint32_t begin, std::uint32_t end, int depth)
+{
+    const std::uint32_t count = end - begin;
+    Node &self = nodes[node];
+    self.skip = node + 2 * count - 1;
+    if (count == 1)
+    {
+        self.box = primitives[begin].box;
+        self.leaf = begin;
+        leafNode[begin] = node;
+        return;
+    }
+    self.leaf = INTERNAL;
+
+    // Centroid bounds pick the axis; the sphere centers are the centroids
+    const auto bound = [&](std::size_t first, std::size_t last)
+    {
+        Bounds bounds;
+        for (std::size_t k = first; k < last; k++)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                bounds.box.lower[a] = std::min(bounds.box.lower[a], primitives[k].center[a]);
+                bounds.box.upper[a] = std::max(bounds.box.upper[a], primitives[k].center[a]);
+            }
+        }
+        return bounds;
+    };
+    const Bounds bounds = count >= PARALLEL_BUILD ? ThreadPool::global().orderedReduce(begin, end, BIN_BLOCK, Bounds(), bound) : bound(begin, end);
+    int axis = 0;
+    for (int a = 1; a < 3; a++)
+    {
+        if (bounds.box.upper[a] - bounds.box.lower[a] > bounds.box.upper[axis] - bounds.box.lower[axis])
+        {
+            axis = a;
+        }
+    }
+    const double low = bounds.box.lower[axis];
+    const double extent = bounds.box.upper[axis] - low;
+
+    std::uint32_t middle = begin + count / 2;
+    if (extent > 0.0 && depth < MAX_SAH_DEPTH && count > MEDIAN_SPLIT)
+    {
+        // Binned SAH: minimize area x count summed over both sides
+        const double scale = BINS / extent;
+        const auto binOf = [&](const Primitive &primitive)
+        {
+            return std::min(static_cast<int>((primitive.center[axis] - low) * scale), BINS - 1);
+        };
+        const auto fill = [&](std::size_t first, std::size_t last)
+        {
+            Bins bins;
+            for (std::size_t k = first; k < last; k++)
+            {
+                const int b = binOf(primitives[k]);
+                grow(bins.box[b], primitives[k].box);
+                bins.count[b]++;
+            }
+            return bins;
+        };
+        const Bins bins = count >= PARALLEL_BUILD ? ThreadPool::global().orderedReduce(begin, end, BIN_BLOCK, Bins(), fill) : fill(begin, end);
+        double rightCost[BINS];
+        Aabb right = emptyBox();
+        std::uint32_t rightCount = 0;
+        for (int b = BINS - 1; b > 0; b--)
+        {
+            grow(right, bins.box[b]);
+            rightCount += bins.count[b];
+            rightCost[b] = rightCount > 0 ? right.surfaceArea() * rightCount : 0.0;
+        }
+        Aabb left = emptyBox();
+        std::uint32_t leftCount = 0;
+        double bestCost = INF;
+        int split = 0;
+        for (int b = 1; b < BINS; b++)
+        {
+            grow(left, bins.box[b - 1]);
+            leftCount += bins.count[b - 1];
+            if (leftCount == 0 || leftCount == count)
+            {
+                continue;
+            }
+            const double cost = left.surfaceArea() * leftCount + rightCost[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                split = b;
+            }
+        }
+        middle = static_cast<std::uint32_t>(std::partition(primitives.begin() + begin, primitives.begin() + end,
+                                                           [&](const Primitive &primitive)
+                                                           { return binOf(primitive) < split; }) -
+                                            primitives.begin());
+    }
+    else if (extent > 0.0)
+    {
+        std::nth_element(primitives.begin() + begin, primitives.begin() + middle, primitives.begin() + end,
+                         [&](const Primitive &a, const Primitive &b)
+                         { return a.center[axis] < b.center[axis]; });
+    }
+
+    const std::uint32_t left = node + 1;
+    const std::uint32_t right = node + 2 * (middle - begin);
+    if (count >= PARALLEL_BUILD)
+    {
+        TaskGroup group;
+        group.run([this, left, begin, middle, depth]()
+                  { buildRange(left, begin, middle, depth + 1); });
+        buildRange(right, middle, end, depth + 1);
+        group.wait();
+    }
+    else
+    {
+        buildRange(left, begin, middle, depth + 1);
+        buildRange(right, middle, end, depth + 1);
+    }
+    nodes[node].box = nodes[left].box;
+    grow(nodes[node].box, nodes[right].box);
+}
+
+// Visit the nodes from `begin` on in depth-first order, skipping the
+// subtrees whose box fails `overlaps`, and call `leaf` with the rank of
+// every leaf that passes
+template <typename Overlaps, typename Leaf>
+void AabbTree::walk(std::uint32_t begin, Overlaps &&overlaps, Leaf &&leaf) const
+{
+    const std::uint32_t end = static_cast<std::uint32_t>(nodes.size());
+    std::uint32_t i = begin;
+    while (i < end)
+    {
+        const Node &node = nodes[i];
+        if (!overlaps(node.box))
+        {
+            i = node.skip;
+            continue;
+        }
+        if (node.leaf != INTERNAL)
+        {
+            leaf(node.leaf);
+        }
+        i++;
+    }
+}
+
+// Each leaf is tested against the nodes after it in depth-first order: the
+// subtrees to its right, so every pair is met once
+void AabbTree::findContacts(std::vector<CollisionPair> &contacts) const
+{
+    const std::size_t n = order.size();
+    const std::size_t blocks = (n + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+    std::vector<std::vector<CollisionPair>> blockContacts(blocks);
+    ThreadPool::global().parallelFor(0, blocks, [&](std::size_t first, std::size_t last)
+                                     {
+                                         for (std::size_t block = first; block < last; block++)
+                                         {
+                                             std::vector<CollisionPair> &out = blockContacts[block];
+                                             for (std::size_t a = block * PARALLEL_GRAIN; a < std::min(n, (block + 1) * PARALLEL_GRAIN); a++)
+                                             {
+                                                 const Aabb query = sphereBox(a);
+                                                 walk(leafNode[a] + 1, [&](const Aabb &box)
+                                                      { return box.overlaps(query); },
+                                                      [&](std::uint32_t b)
+                                                      {
+                                                          const double dx = x[a] - x[b], dy = y[a] - y[b], dz = z[a] - z[b];
+                                                          const double s = radius[a] + radius[b];
+                                                          if (dx * dx + dy * dy + dz * dz < s * s)
+                                                          {
+                                                              out.push_back({order[a], order[b]});
+                                                          }
+                                                      });
+                                             }
+                                         } });
+    contacts.clear();
+    for (const std::vector<CollisionPair> &out : blockContacts)
+    {
+        contacts.insert(contacts.end(), out.begin(), out.end());
+    }
+}
+
+// Counted first, then filled in place, so the hits need no per-query storage
+void AabbTree::queryBoxes(const std::vector<Aabb> &boxes, std::vector<std::uint32_t> &offsets, std::vector<std::uint32_t> &hits) const
+{
+    const std::size_t queries = boxes.size();
+    offsets.assign(queries + 1, 0);
+    const auto visit = [&](std::size_t q, auto &&hit)
+    {
+        const Aabb &query = boxes[q];
+        walk(0, [&](const Aabb &box)
+             { return box.overlaps(query); },
+             [&](std::uint32_t k)
+             {
+                 if (sphereBox(k).overlaps(query))
+                 {
+                     hit(order[k]);
+                 }
+             });
+    };
+    ThreadPool::global().parallelFor(0, queries, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t q = begin; q < end; q++)
+                                         {
+                                             std::uint32_t count = 0;
+                                             visit(q, [&](std::uint32_t)
+                                                   { count++; });
+                                             offsets[q + 1] = count;
+                                         } },
+                                     QUERY_GRAIN);
+    for (std::size_t q = 0; q < queries; q++)
+    {
+        offsets[q + 1] += offsets[q];
+    }
+    hits.resize(offsets[queries]);
+    ThreadPool::global().parallelFor(0, queries, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t q = begin; q < end; q++)
+                                         {
+                                             std::uint32_t next = offsets[q];
+                                             visit(q, [&](std::uint32_t particle)
+                                                   { hits[next++] = particle; });
+                                         } },
+                                     QUERY_GRAIN);
+}
+
+// Unlike the other queries this one descends with a stack, into the child
+// the ray enters first, so that an early hit prunes the farther subtrees
+void AabbTree::raycast(const std::vector<Ray> &rays, std::vector<RayHit> &hits) const
+{
+    hits.assign(rays.size(), RayHit());
+    if (nodes.empty())
+    {
+        return;
+    }
+    ThreadPool::global().parallelFor(0, rays.size(), [&](std::size_t begin, std::size_t end)
+                                     {
+                                         std::vector<std::uint32_t> stack;
+                                         for (std::size_t q = begin; q < end; q++)
+                                         {
+                                             const Ray &ray = rays[q];
+                                             const double origin[3] = {ray.origin.getX(), ray.origin.getY(), ray.origin.getZ()};
+                                             const double direction[3] = {ray.direction.getX(), ray.direction.getY(), ray.direction.getZ()};
+                                             const double inverse[3] = {1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]};
+                                             const double a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+                                             if (!(a > 0.0))
+                                             {
+                                                 continue;
+                                             }
+                                             RayHit &best = hits[q];
+                                             double tFar = ray.maxDistance;
+                                             stack.clear();
+                                             if (rayBox(nodes[0].box, origin, inverse, tFar) != INF)
+                                             {
+                                                 stack.push_back(0);
+                                             }
+                                             while (!stack.empty())
+                                             {
+                                                 const std::uint32_t i = stack.back();
+                                                 stack.pop_back();
+                                                 const Node &node = nodes[i];
+                                                 if (node.leaf != INTERNAL)
+                                                 {
+                                                     // |origin + t direction - center|^2 = r^2, smaller root
+                                                     const std::uint32_t k = node.leaf;
+                                                     const double o[3] = {origin[0] - x[k], origin[1] - y[k], origin[2] - z[k]};
+                                                     const double b = o[0] * direction[0] + o[1] * direction[1] + o[2] * direction[2];
+                                                     const double c = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] - radius[k] * radius[k];
+                                                     const double discriminant = b * b - a * c;
+                                                     if (discriminant < 0.0)
+                                                     {
+                                                         continue;
+                                                     }
+                                                     const double t = c <= 0.0 ? 0.0 : (-b - std::sqrt(discriminant)) / a;
+                                                     if (t >= 0.0 && (t < tFar || (t == tFar && !best.isHit())))
+                                                     {
+                                                         tFar = t;
+                                                         best.particle = order[k];
+                                                         best.distance = t;
+                                                     }
+                                                     continue;
+                                                 }
+                                                 const std::uint32_t left = i + 1, right = nodes[i + 1].skip;
+                                                 const double tLeft = rayBox(nodes[left].box, origin, inverse, tFar);
+                                                 const double tRight = rayBox(nodes[right].box, origin, inverse, tFar);
+                                                 const bool leftFirst = tLeft <= tRight;
+                                                 const std::uint32_t nearChild = leftFirst ? left : right, farChild = leftFirst ? right : left;
+                                                 if (std::max(tLeft, tRight) != INF)
+                                                 {
+                                                     stack.push_back(farChild);
+                                                 }
+                                                 if (std::min(tLeft, tRight) != INF)
+                                                 {
+                                                     stack.push_back(nearChild);
+                                                 }
+                                             }
+                                         } },
+                                     QUERY_GRAIN);
+}
+
+// A subtree inside every plane is taken whole: its leaves have consecutive ranks
+void AabbTree::queryPlanes(const std::vector<Plane> &planes, std::vector<std::uint32_t> &hits) const
+{
+    hits.clear();
+    const std::uint32_t end = static_cast<std::uint32_t>(nodes.size());
+    std::uint32_t i = 0;
+    while (i < end)
+    {
+        const Node &node = nodes[i];
+        bool inside = true, outside = false;
+        for (const Plane &plane : planes)
+        {
+            const double n[3] = {plane.normal.getX(), plane.normal.getY(), plane.normal.getZ()};
+            double nearest = plane.offset, farthest = plane.offset;
+            for (int a = 0; a < 3; a++)
+            {
+                nearest += n[a] * (n[a] >= 0.0 ? node.box.lower[a] : node.box.upper[a]);
+                farthest += n[a] * (n[a] >= 0.0 ? node.box.upper[a] : node.box.lower[a]);
+            }
+            if (farthest < 0.0)
+            {
+                outside = true;
+                break;
+            }
+            inside = inside && nearest >= 0.0;
+        }
+        if (outside)
+        {
+            i = node.skip;
+            continue;
+        }
+        if (inside)
+        {
+            std::uint32_t first = i;
+            while (nodes[first].leaf == INTERNAL)
+            {
+                first++;
+            }
+            const std::uint32_t rank = nodes[first].leaf;
+            const std::uint32_t leaves = (node.skip - i + 1) / 2;
+            for (std::uint32_t k = rank; k < rank + leaves; k++)
+            {
+                hits.push_back(order[k]);
+            }
+            i = node.skip;
+            continue;
+        }
+        if (node.leaf != INTERNAL)
+        {
+            const std::uint32_t k = node.leaf;
+            bool visible = true;
+            for (const Plane &plane : planes)
+            {
+                const double distance = plane.normal.getX() * x[k] + plane.normal.getY() * y[k] + plane.normal.getZ() * z[k] + plane.offset;
+                const double length = std::sqrt(plane.normal.getX() * plane.normal.getX() + plane.normal.getY() * plane.normal.getY() + plane.normal.getZ() * plane.normal.getZ());
+                if (distance < -radius[k] * length)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (visible)
+            {
+                hits.push_back(order[k]);
+            }
+        }
+        i++;
+    }
+}
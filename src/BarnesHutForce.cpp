@@ -0,0 +1,535 @@
+#include "BarnesHutForce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "CompensatedSum.h"
+#include "Morton.h"
+#include "MortonOrder.h"
+#include "SimdPragmas.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr int MAX_DEPTH = Morton::BITS_PER_AXIS;
+
+    // Add the moments of a point source s at offset d from the expansion center
+    void addPoint(Multipole &m, double s, const double d[3])
+    {
+        const double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        m.monopole += s;
+        m.dipole[0] += s * d[0];
+        m.dipole[1] += s * d[1];
+        m.dipole[2] += s * d[2];
+        m.quadrupole[0] += s * (3.0 * d[0] * d[0] - d2);
+        m.quadrupole[1] += s * (3.0 * d[1] * d[1] - d2);
+        m.quadrupole[2] += s * (3.0 * d[2] * d[2] - d2);
+        m.quadrupole[3] += s * 3.0 * d[0] * d[1];
+        m.quadrupole[4] += s * 3.0 * d[0] * d[2];
+        m.quadrupole[5] += s * 3.0 * d[1] * d[2];
+    }
+
+    // Add child moments `c`, expanded about a point at offset d from the parent center
+    void addShifted(Multipole &m, const Multipole &c, const double d[3])
+    {
+        const double s = c.monopole;
+        const double *p = c.dipole;
+        const double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        const double pd = p[0] * d[0] + p[1] * d[1] + p[2] * d[2];
+        m.monopole += s;
+        for (int a = 0; a < 3; a++)
+        {
+            m.dipole[a] += p[a] + s * d[a];
+        }
+        // Q'_ab = Q_ab + 3 (p_a d_b + d_a p_b) - 2 (p.d) delta_ab + s (3 d_a d_b - |d|^2 delta_ab)
+        const int ia[6] = {0, 1, 2, 0, 0, 1};
+        const int ib[6] = {0, 1, 2, 1, 2, 2};
+        for (int k = 0; k < 6; k++)
+        {
+            const int a = ia[k], b = ib[k];
+            const double diagonal = a == b ? 1.0 : 0.0;
+            m.quadrupole[k] += c.quadrupole[k] + 3.0 * (p[a] * d[b] + d[a] * p[b]) - 2.0 * pd * diagonal +
+                               s * (3.0 * d[a] * d[b] - d2 * diagonal);
+        }
+    }
+
+    // Field sum s R / |R|^3 and potential sum s / |R| of the expansion at
+    // offset R from its center
+    void addMultipoleField(const Multipole &m, const double R[3], double r2, int order, double e[3], double &phi)
+    {
+        const double invR = 1.0 / std::sqrt(r2);
+        const double invR2 = invR * invR;
+        const double invR3 = invR * invR2;
+        phi += m.monopole * invR;
+        for (int a = 0; a < 3; a++)
+        {
+            e[a] += m.monopole * R[a] * invR3;
+        }
+        if (order < 1)
+        {
+            return;
+        }
+
+        const double invR5 = invR3 * invR2;
+        const double pR = m.dipole[0] * R[0] + m.dipole[1] * R[1] + m.dipole[2] * R[2];
+        phi += pR * invR3;
+        for (int a = 0; a < 3; a++)
+        {
+            e[a] += 3.0 * pR * R[a] * invR5 - m.dipole[a] * invR3;
+        }
+        if (order < 2)
+        {
+            return;
+        }
+
+        const double *q = m.quadrupole;
+        const double qR[3] = {
+            q[0] * R[0] + q[3] * R[1] + q[4] * R[2],
+            q[3] * R[0] + q[1] * R[1] + q[5] * R[2],
+            q[4] * R[0] + q[5] * R[1] + q[2] * R[2]};
+        const double rqr = R[0] * qR[0] + R[1] * qR[1] + R[2] * qR[2];
+        const double invR7 = invR5 * invR2;
+        phi += 0.5 * rqr * invR5;
+        for (int a = 0; a < 3; a++)
+        {
+            e[a] += 2.5 * rqr * R[a] * invR7 - qR[a] * invR5;
+        }
+    }
+
+    // Builds subtrees over the Morton-sorted particle arrays
+    struct TreeBuilder
+    {
+        const std::uint64_t *keys;
+        const double *x, *y, *z, *q, *m;
+        double k, g;
+        std::size_t leafSize;
+
+        // Boundaries of the (possibly empty) octant ranges of [begin, end) at `level`
+        void octantRanges(std::uint32_t begin, std::uint32_t end, int level, std::uint32_t bounds[9]) const
+        {
+            bounds[0] = begin;
+            for (unsigned oct = 0; oct < 8; oct++)
+            {
+                bounds[oct + 1] = static_cast<std::uint32_t>(
+                    std::partition_point(keys + bounds[oct], keys + end,
+                                         [&](std::uint64_t key)
+                                         { return Morton::octant(key, level) <= oct; }) -
+                    keys);
+            }
+        }
+
+        // Append one node per non-empty octant of `parent` to `out`, returns the child count
+        std::uint32_t appendChildren(std::vector<BarnesHutNode> &out, const BarnesHutNode &parent, int level) const
+        {
+            std::uint32_t bounds[9];
+            octantRanges(parent.begin, parent.end, level, bounds);
+
+            std::uint32_t count = 0;
+            const double quarter = 0.5 * parent.halfSize;
+            for (unsigned oct = 0; oct < 8; oct++)
+            {
+                if (bounds[oct] == bounds[oct + 1])
+                {
+                    continue;
+                }
+                BarnesHutNode child = {};
+                child.center[0] = parent.center[0] + ((oct & 4) ? quarter : -quarter);
+                child.center[1] = parent.center[1] + ((oct & 2) ? quarter : -quarter);
+                child.center[2] = parent.center[2] + ((oct & 1) ? quarter : -quarter);
+                child.halfSize = quarter;
+                child.begin = bounds[oct];
+                child.end = bounds[oct + 1];
+                out.push_back(child);
+                count++;
+            }
+            return count;
+        }
+
+        // Recursively split out[index] (which splits on the octant digit at `level`)
+        void split(std::vector<BarnesHutNode> &out, std::uint32_t index, int level) const
+        {
+            if (out[index].end - out[index].begin <= leafSize || level >= MAX_DEPTH)
+            {
+                leafMoments(out[index]);
+                return;
+            }
+
+            const std::uint32_t first = static_cast<std::uint32_t>(out.size());
+            const BarnesHutNode parent = out[index];
+            const std::uint32_t count = appendChildren(out, parent, level);
+            out[index].firstChild = first;
+            out[index].childCount = count;
+
+            for (std::uint32_t c = 0; c < count; c++)
+            {
+                split(out, first + c, level + 1);
+            }
+            internalMoments(out[index], &out[first]);
+        }
+
+        void leafMoments(BarnesHutNode &node) const
+        {
+            double w = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+            for (std::uint32_t i = node.begin; i < node.end; i++)
+            {
+                const double wi = std::abs(k * q[i]) + g * m[i];
+                w += wi;
+                cx += wi * x[i];
+                cy += wi * y[i];
+                cz += wi * z[i];
+            }
+            setExpansionCenter(node, w, cx, cy, cz);
+
+            node.charge = Multipole();
+            node.mass = Multipole();
+            for (std::uint32_t i = node.begin; i < node.end; i++)
+            {
+                const double d[3] = {x[i] - node.expansionCenter[0], y[i] - node.expansionCenter[1], z[i] - node.expansionCenter[2]};
+                addPoint(node.charge, q[i], d);
+                addPoint(node.mass, m[i], d);
+            }
+        }
+
+        static void internalMoments(BarnesHutNode &node, const BarnesHutNode *children)
+        {
+            double w = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+            for (std::uint32_t c = 0; c < node.childCount; c++)
+            {
+                const BarnesHutNode &child = children[c];
+                w += child.weight;
+                cx += child.weight * child.expansionCenter[0];
+                cy += child.weight * child.expansionCenter[1];
+                cz += child.weight * child.expansionCenter[2];
+            }
+            setExpansionCenter(node, w, cx, cy, cz);
+
+            node.charge = Multipole();
+            node.mass = Multipole();
+            for (std::uint32_t c = 0; c < node.childCount; c++)
+            {
+                const BarnesHutNode &child = children[c];
+                const double d[3] = {child.expansionCenter[0] - node.expansionCenter[0],
+                                     child.expansionCenter[1] - node.expansionCenter[1],
+                                     child.expansionCenter[2] - node.expansionCenter[2]};
+                addShifted(node.charge, child.charge, d);
+                addShifted(node.mass, child.mass, d);
+            }
+        }
+
+        // Weighted centroid, or the geometric center for a node without sources
+        static void setExpansionCenter(BarnesHutNode &node, double w, double cx, double cy, double cz)
+        {
+            node.weight = w;
+            if (w > 0.0)
+            {
+                node.expansionCenter[0] = cx / w;
+                node.expansionCenter[1] = cy / w;
+                node.expansionCenter[2] = cz / w;
+            }
+            else
+            {
+                node.expansionCenter[0] = node.center[0];
+                node.expansionCenter[1] = node.center[1];
+                node.expansionCenter[2] = node.center[2];
+            }
+        }
+    };
+}
+
+// Constructor
+BarnesHutForce::BarnesHutForce(const CoulombParameters &parameters, const BarnesHutParameters &treeParameters)
+    : parameters(parameters), treeParameters(treeParameters) {}
+
+BarnesHutNode BarnesHutForce::sortParticles(const ParticleSystem &system)
+{
+    const std::size_t n = system.size();
+    const Vector3Array &positions = system.getPositions();
+    const MortonCube cube = mortonOrder(system, keys, order);
+    BarnesHutNode root = {};
+    for (int a = 0; a < 3; a++)
+    {
+        root.center[a] = cube.center[a];
+    }
+    root.halfSize = cube.halfSize;
+    root.begin = 0;
+    root.end = static_cast<std::uint32_t>(n);
+
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedZ.resize(n);
+    sortedCharge.resize(n);
+    sortedMass.resize(n);
+    for (std::size_t s = 0; s < n; s++)
+    {
+        const std::uint32_t i = order[s];
+        sortedX[s] = positions.x[i];
+        sortedY[s] = positions.y[i];
+        sortedZ[s] = positions.z[i];
+        sortedCharge[s] = system.getCharges()[i];
+        sortedMass[s] = system.getMasses()[i];
+    }
+    return root;
+}
+
+void BarnesHutForce::build(const ParticleSystem &system)
+{
+    nodes.clear();
+    if (system.empty())
+    {
+        return;
+    }
+
+    BarnesHutNode root = sortParticles(system);
+    const TreeBuilder builder = {keys.data(), sortedX.data(), sortedY.data(), sortedZ.data(),
+                                 sortedCharge.data(), sortedMass.data(),
+                                 parameters.coulombConstant, parameters.gravitationalConstant,
+                                 std::max<std::size_t>(treeParameters.leafSize, 1)};
+
+    nodes.push_back(root);
+    if (system.size() < treeParameters.parallelThreshold || system.size() <= builder.leafSize)
+    {
+        builder.split(nodes, 0, 0);
+        return;
+    }
+
+    // Build every top-level octant as an independent subtree, then splice
+    // them in behind the root. Subtree-local index 0 is the octant node.
+    std::vector<BarnesHutNode> octants;
+    const std::uint32_t count = builder.appendChildren(octants, root, 0);
+    std::vector<std::vector<BarnesHutNode>> subtrees(count);
+    TaskGroup group;
+    for (std::uint32_t c = 0; c < count; c++)
+    {
+        subtrees[c].push_back(octants[c]);
+        group.run([&builder, &subtrees, c]()
+                  { builder.split(subtrees[c], 0, 1); });
+    }
+    group.wait();
+
+    nodes[0].firstChild = 1;
+    nodes[0].childCount = count;
+    for (std::uint32_t c = 0; c < count; c++)
+    {
+        nodes.push_back(subtrees[c][0]);
+    }
+    for (std::uint32_t c = 0; c < count; c++)
+    {
+        // Local index L >= 1 lands at base + L - 1
+        const std::uint32_t base = static_cast<std::uint32_t>(nodes.size());
+        const std::vector<BarnesHutNode> &subtree = subtrees[c];
+        if (subtree[0].childCount > 0)
+        {
+            nodes[1 + c].firstChild = base + subtree[0].firstChild - 1;
+        }
+        for (std::size_t local = 1; local < subtree.size(); local++)
+        {
+            BarnesHutNode node = subtree[local];
+            if (node.childCount > 0)
+            {
+                node.firstChild = base + node.firstChild - 1;
+            }
+            nodes.push_back(node);
+        }
+    }
+    TreeBuilder::internalMoments(nodes[0], &nodes[1]);
+}
+
+template <bool Gravity>
+void BarnesHutForce::evaluate(ParticleSystem &system, const std::uint8_t *active)
+{
+    const double k = parameters.coulombConstant;
+    const double g = parameters.gravitationalConstant;
+    const double eps2 = parameters.softening * parameters.softening;
+    const double theta2 = treeParameters.theta * treeParameters.theta;
+    const int multipoleOrder = treeParameters.multipoleOrder;
+    const double *__restrict sx = sortedX.data();
+    const double *__restrict sy = sortedY.data();
+    const double *__restrict sz = sortedZ.data();
+    const double *__restrict sq = sortedCharge.data();
+    const double *__restrict sm = sortedMass.data();
+    Vector3Array &accelerations = system.getAccelerations();
+    leafEnergy.assign(nodes.size(), 0.0);
+
+    // Walk the tree once per leaf: every particle of a leaf shares the same
+    // interaction lists, with the opening test done against the whole leaf
+    // cell. Leaves only write the accelerations of their own particles and
+    // their own energy slot, so node ranges are evaluated in parallel above
+    // the threshold.
+    auto evaluateNodes = [&](std::size_t firstNode, std::size_t lastNode)
+    {
+        std::vector<std::uint32_t> nearLeaves;
+        std::vector<std::uint32_t> farNodes;
+        std::uint32_t stack[8 * (MAX_DEPTH + 2)];
+
+        for (std::size_t leafIndex = firstNode; leafIndex < lastNode; leafIndex++)
+        {
+            const BarnesHutNode &leaf = nodes[leafIndex];
+            if (leaf.childCount != 0)
+            {
+                continue;
+            }
+            if (active && std::none_of(order.begin() + leaf.begin, order.begin() + leaf.end, [active](std::uint32_t i)
+                                       { return active[i] != 0; }))
+            {
+                continue;
+            }
+
+            nearLeaves.clear();
+            farNodes.clear();
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                const std::uint32_t index = stack[--top];
+                const BarnesHutNode &node = nodes[index];
+
+                // Distance from the expansion center to the closest point of the leaf cell
+                double d2 = 0.0;
+                bool overlaps = true;
+                for (int a = 0; a < 3; a++)
+                {
+                    const double gap = std::abs(node.expansionCenter[a] - leaf.center[a]) - leaf.halfSize;
+                    const double cellGap = std::abs(node.center[a] - leaf.center[a]) - node.halfSize - leaf.halfSize;
+                    d2 += gap > 0.0 ? gap * gap : 0.0;
+                    overlaps = overlaps && cellGap < 0.0;
+                }
+                const double size = 2.0 * node.halfSize;
+                if (!overlaps && size * size < theta2 * d2)
+                {
+                    farNodes.push_back(index);
+                }
+                else if (node.childCount == 0)
+                {
+                    nearLeaves.push_back(index);
+                }
+                else
+                {
+                    for (std::uint32_t c = 0; c < node.childCount; c++)
+                    {
+                        stack[top++] = node.firstChild + c;
+                    }
+                }
+            }
+
+            double energy = 0.0;
+            for (std::uint32_t t = leaf.begin; t < leaf.end; t++)
+            {
+                if (active && !active[order[t]])
+                {
+                    continue;
+                }
+                const double r[3] = {sx[t], sy[t], sz[t]};
+                double eq[3] = {0.0, 0.0, 0.0};
+                double em[3] = {0.0, 0.0, 0.0};
+                double phiQ = 0.0, phiM = 0.0;
+
+                for (std::uint32_t index : farNodes)
+                {
+                    const BarnesHutNode &node = nodes[index];
+                    const double R[3] = {r[0] - node.expansionCenter[0], r[1] - node.expansionCenter[1], r[2] - node.expansionCenter[2]};
+                    const double d2 = R[0] * R[0] + R[1] * R[1] + R[2] * R[2];
+                    addMultipoleField(node.charge, R, d2, multipoleOrder, eq, phiQ);
+                    if (Gravity)
+                    {
+                        addMultipoleField(node.mass, R, d2, multipoleOrder, em, phiM);
+                    }
+                }
+
+                // Direct sums; the target itself adds no field, and is
+                // masked out of the (softened) potential
+                double ex = 0.0, ey = 0.0, ez = 0.0, gx = 0.0, gy = 0.0, gz = 0.0, pq = 0.0, pm = 0.0;
+                for (std::uint32_t index : nearLeaves)
+                {
+                    const BarnesHutNode &node = nodes[index];
+                    ATOM_SIMD_LOOP(reduction(+ : ex, ey, ez, gx, gy, gz, pq, pm))
+                    for (std::uint32_t j = node.begin; j < node.end; j++)
+                    {
+                        const double dx = r[0] - sx[j];
+                        const double dy = r[1] - sy[j];
+                        const double dz = r[2] - sz[j];
+                        const double r2 = dx * dx + dy * dy + dz * dz + eps2;
+                        const double invR = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+                        const double invR3 = invR * invR * invR;
+                        const double other = j != t ? invR : 0.0;
+                        ex += sq[j] * invR3 * dx;
+                        ey += sq[j] * invR3 * dy;
+                        ez += sq[j] * invR3 * dz;
+                        pq += sq[j] * other;
+                        if (Gravity)
+                        {
+                            gx += sm[j] * invR3 * dx;
+                            gy += sm[j] * invR3 * dy;
+                            gz += sm[j] * invR3 * dz;
+                            pm += sm[j] * other;
+                        }
+                    }
+                }
+                eq[0] += ex;
+                eq[1] += ey;
+                eq[2] += ez;
+                em[0] += gx;
+                em[1] += gy;
+                em[2] += gz;
+
+                const std::uint32_t i = order[t];
+                const double mass = sm[t];
+                const double invMass = mass != 0.0 ? 1.0 / mass : 0.0;
+                const double kq = k * sq[t];
+                const double gm = g * mass;
+                accelerations.x[i] = static_cast<Real>((kq * eq[0] - gm * em[0]) * invMass);
+                accelerations.y[i] = static_cast<Real>((kq * eq[1] - gm * em[1]) * invMass);
+                accelerations.z[i] = static_cast<Real>((kq * eq[2] - gm * em[2]) * invMass);
+                energy += 0.5 * (kq * (phiQ + pq) - gm * (phiM + pm)); // every pair is seen from both ends
+            }
+            leafEnergy[leafIndex] = energy;
+        }
+    };
+
+    if (system.size() < treeParameters.parallelThreshold)
+    {
+        evaluateNodes(0, nodes.size());
+    }
+    else
+    {
+        ThreadPool::global().parallelFor(0, nodes.size(), evaluateNodes);
+    }
+}
+
+void BarnesHutForce::computeAccelerations(ParticleSystem &system)
+{
+    build(system);
+    if (parameters.gravitationalConstant != 0.0)
+    {
+        evaluate<true>(system, nullptr);
+    }
+    else
+    {
+        evaluate<false>(system, nullptr);
+    }
+    CompensatedSum<double> energy;
+    for (double e : leafEnergy)
+    {
+        energy += e;
+    }
+    potentialEnergy = energy.value();
+}
+
+void BarnesHutForce::computeActiveAccelerations(ParticleSystem &system, const std::vector<std::uint32_t> &active)
+{
+    build(system);
+    activeMask.assign(system.size(), 0);
+    for (std::uint32_t i : active)
+    {
+        activeMask[i] = 1;
+    }
+    if (parameters.gravitationalConstant != 0.0)
+    {
+        evaluate<true>(system, activeMask.data());
+    }
+    else
+    {
+        evaluate<false>(system, activeMask.data());
+    }
+    potentialEnergy = std::numeric_limits<double>::quiet_NaN(); // inactive targets were skipped
+}
@@ -0,0 +1,185 @@
+#include "CellGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Constructor
+CellGrid::CellGrid(double cutoff) : cutoff(cutoff)
+{
+    setCutoff(cutoff);
+}
+
+void CellGrid::setCutoff(double c)
+{
+    if (!(c > 0.0))
+    {
+        throw std::invalid_argument("Cutoff must be positive.");
+    }
+    cutoff = c;
+}
+
+int CellGrid::cellCoordinate(double x, int axis) const
+{
+    const int c = static_cast<int>(std::floor((x - origin[axis]) * inverseCellSize[axis]));
+    return std::min(std::max(c, 0), dims[axis] - 1);
+}
+
+bool CellGrid::neighborCoordinate(int c, int offset, int axis, int &neighbor, double &shift) const
+{
+    neighbor = c + offset;
+    shift = 0.0;
+    if (neighbor >= 0 && neighbor < dims[axis])
+    {
+        return true;
+    }
+    if (!domain.periodic[axis])
+    {
+        return false;
+    }
+    shift = neighbor < 0 ? -domain.length(axis) : domain.length(axis);
+    neighbor = neighbor < 0 ? neighbor + dims[axis] : neighbor - dims[axis];
+    return true;
+}
+
+void CellGrid::build(const ParticleSystem &system, const Domain &d)
+{
+    domain = d;
+    const std::size_t n = system.size();
+    const Vector3Array &positions = system.getPositions();
+    const AlignedVector<Real> *components[3] = {&positions.x, &positions.y, &positions.z};
+
+    // Grid extent: the box on periodic axes, the bounding box on open ones.
+    // Cell counts stay doubles until coarsened: an open axis may span more
+    // than INT_MAX cutoffs
+    double extent[3], cells[3];
+    for (int a = 0; a < 3; a++)
+    {
+        if (domain.periodic[a])
+        {
+            if (!(domain.length(a) >= 3.0 * cutoff))
+            {
+                throw std::invalid_argument("Periodic box must be at least three cutoffs wide.");
+            }
+            origin[a] = domain.lower[a];
+            extent[a] = domain.length(a);
+            cells[a] = std::floor(extent[a] / cutoff);
+            continue;
+        }
+        double lo = std::numeric_limits<double>::max();
+        double hi = std::numeric_limits<double>::lowest();
+        for (Real x : *components[a])
+        {
+            lo = std::min(lo, static_cast<double>(x));
+            hi = std::max(hi, static_cast<double>(x));
+        }
+        if (n == 0)
+        {
+            lo = hi = 0.0;
+        }
+        origin[a] = lo;
+        extent[a] = hi - lo;
+        cells[a] = std::max(1.0, std::floor(extent[a] / cutoff));
+    }
+
+    // Sparse open domains: coarsen the open axes so there are at most ~2
+    // cells per particle
+    int openAxes = 0;
+    double openCells = 1.0, periodicCells = 1.0;
+    for (int a = 0; a < 3; a++)
+    {
+        if (domain.periodic[a])
+        {
+            periodicCells *= cells[a];
+        }
+        else
+        {
+            openCells *= cells[a];
+            openAxes++;
+        }
+    }
+    const double maxOpenCells = std::max(1.0, std::max(64.0, 2.0 * static_cast<double>(n)) / periodicCells);
+    if (openCells > maxOpenCells)
+    {
+        const double factor = std::pow(openCells / maxOpenCells, 1.0 / openAxes);
+        for (int a = 0; a < 3; a++)
+        {
+            if (!domain.periodic[a])
+            {
+                cells[a] = std::max(1.0, std::floor(cells[a] / factor));
+            }
+        }
+    }
+    for (int a = 0; a < 3; a++)
+    {
+        dims[a] = static_cast<int>(std::min(std::max(cells[a], 1.0), static_cast<double>(std::numeric_limits<int>::max())));
+        inverseCellSize[a] = extent[a] > 0.0 ? dims[a] / extent[a] : 0.0;
+    }
+
+    // Counting sort of the particles by cell
+    const std::size_t cellTotal = static_cast<std::size_t>(dims[0]) * dims[1] * dims[2];
+    cellStart.assign(cellTotal + 1, 0);
+    particleCell.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const int cx = cellCoordinate(domain.wrap(positions.x[i], 0), 0);
+        const int cy = cellCoordinate(domain.wrap(positions.y[i], 1), 1);
+        const int cz = cellCoordinate(domain.wrap(positions.z[i], 2), 2);
+        particleCell[i] = static_cast<std::uint32_t>(cellIndex(cx, cy, cz));
+        cellStart[particleCell[i] + 1]++;
+    }
+    for (std::size_t c = 0; c < cellTotal; c++)
+    {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    cellParticles.resize(n);
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedZ.resize(n);
+    cursor.assign(cellStart.begin(), cellStart.end() - 1);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const std::uint32_t slot = cursor[particleCell[i]]++;
+        cellParticles[slot] = static_cast<std::uint32_t>(i);
+        sortedX[slot] = domain.wrap(positions.x[i], 0);
+        sortedY[slot] = domain.wrap(positions.y[i], 1);
+        sortedZ[slot] = domain.wrap(positions.z[i], 2);
+    }
+}
+
+std::vector<std::vector<std::uint32_t>> CellGrid::cellColors() const
+{
+    // Cells of one color are at least three apart along some axis, so the
+    // 3-wide neighborhoods around them cannot overlap. On a periodic axis the
+    // last dims % 3 layers would wrap into the first ones and get colors of
+    // their own.
+    int colors[3];
+    for (int a = 0; a < 3; a++)
+    {
+        colors[a] = domain.periodic[a] ? 3 + dims[a] % 3 : 3;
+    }
+    auto color = [this](int c, int axis)
+    {
+        const int regular = domain.periodic[axis] ? dims[axis] - dims[axis] % 3 : dims[axis];
+        return c < regular ? c % 3 : 3 + c - regular;
+    };
+
+    std::vector<std::vector<std::uint32_t>> cells(static_cast<std::size_t>(colors[0]) * colors[1] * colors[2]);
+    for (int cz = 0; cz < dims[2]; cz++)
+    {
+        for (int cy = 0; cy < dims[1]; cy++)
+        {
+            for (int cx = 0; cx < dims[0]; cx++)
+            {
+                const std::size_t k = (static_cast<std::size_t>(color(cz, 2)) * colors[1] + color(cy, 1)) * colors[0] + color(cx, 0);
+                cells[k].push_back(static_cast<std::uint32_t>(cellIndex(cx, cy, cz)));
+            }
+        }
+    }
+    cells.erase(std::remove_if(cells.begin(), cells.end(), [](const std::vector<std::uint32_t> &c)
+                               { return c.empty(); }),
+                cells.end());
+    return cells;
+}
@@ -0,0 +1,111 @@
+#include "Collisions.h"
+
+#include <cmath>
+#include <stdexcept>
+
+BroadPhase broadPhaseFromName(const std::string &name)
+{
+    if (name == "sap")
+        return BroadPhase::SweepAndPrune;
+    if (name == "tree")
+        return BroadPhase::AabbTree;
+    throw std::invalid_argument("Unknown broad phase: " + name);
+}
+
+const char *broadPhaseName(BroadPhase broadPhase)
+{
+    switch (broadPhase)
+    {
+    case BroadPhase::SweepAndPrune:
+        return "sap";
+    case BroadPhase::AabbTree:
+        return "tree";
+    }
+    return "unknown";
+}
+
+// Constructor
+CollisionSystem::CollisionSystem(const CollisionParameters &parameters)
+{
+    setParameters(parameters);
+}
+
+void CollisionSystem::setParameters(const CollisionParameters &p)
+{
+    if (!(p.restitution >= 0.0 && p.restitution <= 1.0))
+    {
+        throw std::invalid_argument("Restitution must lie in [0, 1].");
+    }
+    if (!(p.separation >= 0.0 && p.separation <= 1.0))
+    {
+        throw std::invalid_argument("Separation must lie in [0, 1].");
+    }
+    parameters = p;
+}
+
+std::size_t CollisionSystem::resolve(ParticleSystem &system)
+{
+    if (parameters.broadPhase == BroadPhase::AabbTree)
+    {
+        tree.update(system);
+        tree.findContacts(treeContacts);
+    }
+    else
+    {
+        sweepAndPrune.update(system);
+    }
+    const std::vector<CollisionPair> &contacts = parameters.broadPhase == BroadPhase::AabbTree ? treeContacts : sweepAndPrune.getContacts();
+
+    Vector3Array &positions = system.getPositions();
+    Vector3Array &velocities = system.getVelocities();
+    const AlignedVector<Real> &masses = system.getMasses();
+    const double e = parameters.restitution;
+
+    statistics = CollisionStatistics();
+    statistics.contacts = contacts.size();
+    for (const CollisionPair &pair : contacts)
+    {
+        const std::size_t i = pair.i, j = pair.j;
+        const double wi = masses[i] > 0 ? 1.0 / masses[i] : 0.0;
+        const double wj = masses[j] > 0 ? 1.0 / masses[j] : 0.0;
+        const double w = wi + wj;
+        const double d[3] = {static_cast<double>(positions.x[i]) - positions.x[j], static_cast<double>(positions.y[i]) - positions.y[j],
+                             static_cast<double>(positions.z[i]) - positions.z[j]};
+        const double distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        if (w == 0.0 || distance == 0.0)
+        {
+            continue;
+        }
+        const double n[3] = {d[0] / distance, d[1] / distance, d[2] / distance};
+
+        // Normal impulse
+        const double approach = (velocities.x[i] - velocities.x[j]) * n[0] + (velocities.y[i] - velocities.y[j]) * n[1] +
+                                (velocities.z[i] - velocities.z[j]) * n[2];
+        if (approach < 0.0)
+        {
+            const double impulse = -(1.0 + e) * approach / w;
+            velocities.x[i] += static_cast<Real>(impulse * wi * n[0]);
+            velocities.y[i] += static_cast<Real>(impulse * wi * n[1]);
+            velocities.z[i] += static_cast<Real>(impulse * wi * n[2]);
+            velocities.x[j] -= static_cast<Real>(impulse * wj * n[0]);
+            velocities.y[j] -= static_cast<Real>(impulse * wj * n[1]);
+            velocities.z[j] -= static_cast<Real>(impulse * wj * n[2]);
+            statistics.impulses++;
+            statistics.dissipatedEnergy += 0.5 * (1.0 - e * e) * approach * approach / w;
+        }
+
+        // Separation, shared by inverse mass
+        const double overlap = static_cast<double>(system.getRadius(i)) + system.getRadius(j) - distance;
+        if (overlap > 0.0 && parameters.separation > 0.0)
+        {
+            const double shift = parameters.separation * overlap / w;
+            positions.x[i] += static_cast<Real>(shift * wi * n[0]);
+            positions.y[i] += static_cast<Real>(shift * wi * n[1]);
+            positions.z[i] += static_cast<Real>(shift * wi * n[2]);
+            positions.x[j] -= static_cast<Real>(shift * wj * n[0]);
+            positions.y[j] -= static_cast<Real>(shift * wj * n[1]);
+            positions.z[j] -= static_cast<Real>(shift * wj * n[2]);
+        }
+    }
+    return statistics.impulses;
+}
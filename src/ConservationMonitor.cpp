@@ -0,0 +1,197 @@
+#include "ConservationMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "SimdPragmas.h"
+
+namespace
+{
+    // change / scale, treating a zero scale as "any change is infinite"
+    double relativeChange(double change, double scale)
+    {
+        if (std::isnan(change) || scale > 0.0)
+        {
+            return change / scale;
+        }
+        return change > 0.0 ? std::numeric_limits<double>::infinity() : 0.0;
+    }
+}
+
+// Moments of one block
+ParticleMoments ParticleMoments::measure(const ParticleSystem &system, std::size_t begin, std::size_t end, double kick)
+{
+    const Vector3Array &positions = system.getPositions();
+    const Vector3Array &velocities = system.getVelocities();
+    const Vector3Array &accelerations = system.getAccelerations();
+    const Real *__restrict x = positions.x.data();
+    const Real *__restrict y = positions.y.data();
+    const Real *__restrict z = positions.z.data();
+    const Real *__restrict vx = velocities.x.data();
+    const Real *__restrict vy = velocities.y.data();
+    const Real *__restrict vz = velocities.z.data();
+    const Real *__restrict ax = accelerations.x.data();
+    const Real *__restrict ay = accelerations.y.data();
+    const Real *__restrict az = accelerations.z.data();
+    const Real *__restrict m = system.getMasses().data();
+    const double halfKick = 0.5 * kick;
+
+    double mass = 0.0, twiceKinetic = 0.0, inertia = 0.0;
+    double px = 0.0, py = 0.0, pz = 0.0;
+    double lx = 0.0, ly = 0.0, lz = 0.0;
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+    ATOM_SIMD_LOOP(reduction(+ : mass, twiceKinetic, inertia, px, py, pz, lx, ly, lz, sx, sy, sz))
+    for (std::size_t i = begin; i < end; i++)
+    {
+        const double mi = m[i];
+        const double xi = x[i], yi = y[i], zi = z[i];
+        // m v_before . v_after = m |v_mid|^2 - m |a kick / 2|^2
+        const double vxi = vx[i] + halfKick * ax[i], vyi = vy[i] + halfKick * ay[i], vzi = vz[i] + halfKick * az[i];
+        const double dvx = halfKick * ax[i], dvy = halfKick * ay[i], dvz = halfKick * az[i];
+        const double mvx = mi * vxi, mvy = mi * vyi, mvz = mi * vzi;
+        mass += mi;
+        twiceKinetic += mvx * vxi + mvy * vyi + mvz * vzi - mi * (dvx * dvx + dvy * dvy + dvz * dvz);
+        inertia += mi * (xi * xi + yi * yi + zi * zi);
+        px += mvx;
+        py += mvy;
+        pz += mvz;
+        lx += yi * mvz - zi * mvy;
+        ly += zi * mvx - xi * mvz;
+        lz += xi * mvy - yi * mvx;
+        sx += mi * xi;
+        sy += mi * yi;
+        sz += mi * zi;
+    }
+
+    ParticleMoments result;
+    result.mass += mass;
+    result.kineticEnergy += 0.5 * twiceKinetic;
+    result.inertia += inertia;
+    result.momentum[0] += px;
+    result.momentum[1] += py;
+    result.momentum[2] += pz;
+    result.angularMomentum[0] += lx;
+    result.angularMomentum[1] += ly;
+    result.angularMomentum[2] += lz;
+    result.massMoment[0] += sx;
+    result.massMoment[1] += sy;
+    result.massMoment[2] += sz;
+    return result;
+}
+
+ParticleMoments &ParticleMoments::operator+=(const ParticleMoments &other)
+{
+    mass += other.mass;
+    kineticEnergy += other.kineticEnergy;
+    inertia += other.inertia;
+    for (int a = 0; a < 3; a++)
+    {
+        momentum[a] += other.momentum[a];
+        angularMomentum[a] += other.angularMomentum[a];
+        massMoment[a] += other.massMoment[a];
+    }
+    return *this;
+}
+
+// Constructor
+ConservationMonitor::ConservationMonitor(const ConservationTolerances &tolerances, std::size_t historyCapacity)
+    : tolerances(tolerances), samples(historyCapacity)
+{
+    if (historyCapacity == 0)
+    {
+        throw std::invalid_argument("History capacity must be positive.");
+    }
+}
+
+void ConservationMonitor::record(const ParticleSystem &system, const ParticleMoments &moments, double potentialEnergy, double deltaTime)
+{
+    time += deltaTime;
+
+    // Back to absolute coordinates: x = origin + stored position
+    const Vector3d &origin = system.getOrigin();
+    const Vector3d momentum(moments.momentum[0].value(), moments.momentum[1].value(), moments.momentum[2].value());
+    const Vector3d massMoment(moments.massMoment[0].value(), moments.massMoment[1].value(), moments.massMoment[2].value());
+    const Vector3d relativeAngular(moments.angularMomentum[0].value(), moments.angularMomentum[1].value(), moments.angularMomentum[2].value());
+
+    ConservedQuantities sample;
+    sample.time = time;
+    sample.kineticEnergy = moments.kineticEnergy.value();
+    sample.potentialEnergy = potentialEnergy;
+    sample.momentum = momentum;
+    sample.angularMomentum = relativeAngular + origin.cross(momentum);
+
+    if (!hasReference)
+    {
+        const double inertia = moments.inertia.value() + 2.0 * origin.dot(massMoment) + origin.dot(origin) * moments.mass.value();
+        reference = sample;
+        hasReference = true;
+        energyScale = std::fabs(sample.kineticEnergy) + std::fabs(sample.potentialEnergy);
+        momentumScale = std::sqrt(2.0 * moments.mass.value() * sample.kineticEnergy);
+        angularMomentumScale = std::sqrt(2.0 * std::max(inertia, 0.0) * sample.kineticEnergy);
+    }
+
+    const std::size_t capacity = samples.size();
+    if (count < capacity)
+    {
+        samples[(first + count) % capacity] = sample;
+        count++;
+    }
+    else
+    {
+        samples[first] = sample;
+        first = (first + 1) % capacity;
+    }
+
+    // NaN drifts (no potential energy) compare false and never trip, so flag them
+    alarms.energy = alarms.energy || energyDrift() > tolerances.energy;
+    alarms.energyUnmonitored = alarms.energyUnmonitored || std::isnan(potentialEnergy);
+    alarms.momentum = alarms.momentum || momentumDrift() > tolerances.momentum;
+    alarms.angularMomentum = alarms.angularMomentum || angularMomentumDrift() > tolerances.angularMomentum;
+}
+
+void ConservationMonitor::reset()
+{
+    alarms = ConservationAlarms();
+    hasReference = false;
+    first = 0;
+    count = 0;
+}
+
+// Drifts
+double ConservationMonitor::energyDrift() const
+{
+    if (empty())
+    {
+        return 0.0;
+    }
+    return relativeChange(std::fabs(latest().totalEnergy() - reference.totalEnergy()), energyScale);
+}
+
+double ConservationMonitor::momentumDrift() const
+{
+    if (empty())
+    {
+        return 0.0;
+    }
+    const Vector3d change = latest().momentum - reference.momentum;
+    return relativeChange(change.magnitude(), momentumScale);
+}
+
+double ConservationMonitor::angularMomentumDrift() const
+{
+    if (empty())
+    {
+        return 0.0;
+    }
+    const Vector3d change = latest().angularMomentum - reference.angularMomentum;
+    return relativeChange(change.magnitude(), angularMomentumScale);
+}
+
+const ConservedQuantities &ConservationMonitor::history(std::size_t index) const
+{
+    if (index >= count)
+    {
+        throw std::invalid_argument("History index out of range.");
+    }
+    return samples[(first + index) % samples.size()];
+}
@@ -0,0 +1,378 @@
+#include "CoulombForce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "CompensatedSum.h"
+#include "SimdPragmas.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // Raw views of the arrays the pair kernel reads and writes
+    struct PairKernelData
+    {
+        const Real *__restrict x;
+        const Real *__restrict y;
+        const Real *__restrict z;
+        const Real *__restrict q;
+        const Real *__restrict m;
+        AccumReal *__restrict fx;
+        AccumReal *__restrict fy;
+        AccumReal *__restrict fz;
+        Real k;
+        Real g;
+        Real eps2;
+        double *tileEnergy; // potential energy of tile pair (a, b) at a * tiles + b
+        std::size_t tiles;
+    };
+
+    // Reaction forces on the second tile of a tile pair, see interactTiles()
+    Vector3Array &scratchTile(std::size_t size)
+    {
+        thread_local Vector3Array tile;
+        tile.resize(size);
+        std::fill(tile.x.begin(), tile.x.end(), Real(0));
+        std::fill(tile.y.begin(), tile.y.end(), Real(0));
+        std::fill(tile.z.begin(), tile.z.end(), Real(0));
+        return tile;
+    }
+
+    // Accumulate the forces between particles [i0, i1) and [j0, j1) and
+    // return their potential energy. When the two ranges are the same tile
+    // only pairs with j > i are visited.
+    //
+    // The pair terms are summed in Real over at most one tile (the reaction
+    // forces into a tile-local buffer), and only those partial sums are added
+    // to the AccumReal force arrays, so the inner loop keeps the full SIMD
+    // width of Real under mixed precision.
+    template <bool Gravity>
+    double interactTiles(const PairKernelData &d, std::size_t i0, std::size_t i1, std::size_t j0, std::size_t j1, bool sameTile)
+    {
+        const Real *__restrict x = d.x + j0;
+        const Real *__restrict y = d.y + j0;
+        const Real *__restrict z = d.z + j0;
+        const Real *__restrict q = d.q + j0;
+        const Real *__restrict m = d.m + j0;
+        const std::size_t count = j1 - j0;
+        Vector3Array &tile = scratchTile(count);
+        Real *__restrict tx = tile.x.data();
+        Real *__restrict ty = tile.y.data();
+        Real *__restrict tz = tile.z.data();
+        double energy = 0.0;
+
+        for (std::size_t i = i0; i < i1; i++)
+        {
+            const Real xi = d.x[i], yi = d.y[i], zi = d.z[i];
+            const Real kqi = d.k * d.q[i];
+            const Real gmi = Gravity ? d.g * d.m[i] : Real(0);
+            Real fxi = 0, fyi = 0, fzi = 0, ei = 0;
+
+            const std::size_t kStart = sameTile ? i + 1 - j0 : 0;
+            ATOM_SIMD_LOOP(reduction(+ : fxi, fyi, fzi, ei))
+            for (std::size_t k = kStart; k < count; k++)
+            {
+                const Real dx = xi - x[k];
+                const Real dy = yi - y[k];
+                const Real dz = zi - z[k];
+                const Real r2 = dx * dx + dy * dy + dz * dz + d.eps2;
+                const Real invR = r2 > Real(0) ? Real(1) / std::sqrt(r2) : Real(0);
+                Real c = kqi * q[k];
+                if (Gravity)
+                {
+                    c -= gmi * m[k];
+                }
+                const Real u = c * invR;
+                const Real s = u * invR * invR;
+                ei += u;
+                fxi += s * dx;
+                fyi += s * dy;
+                fzi += s * dz;
+                tx[k] -= s * dx;
+                ty[k] -= s * dy;
+                tz[k] -= s * dz;
+            }
+
+            d.fx[i] += fxi;
+            d.fy[i] += fyi;
+            d.fz[i] += fzi;
+            energy += ei;
+        }
+        for (std::size_t k = 0; k < count; k++)
+        {
+            d.fx[j0 + k] += tx[k];
+            d.fy[j0 + k] += ty[k];
+            d.fz[j0 + k] += tz[k];
+        }
+        return energy;
+    }
+
+    // Tile pair (a, b) of tiles [a * tileSize, ...) and [b * tileSize, ...).
+    // Its energy goes to its own slot, so the total can be summed in a fixed
+    // order however the pairs were scheduled.
+    template <bool Gravity>
+    void interactTilePair(const PairKernelData &d, std::size_t n, std::size_t tileSize, std::size_t a, std::size_t b)
+    {
+        const std::size_t i0 = a * tileSize, j0 = b * tileSize;
+        d.tileEnergy[a * d.tiles + b] = interactTiles<Gravity>(d, i0, std::min(n, i0 + tileSize), j0, std::min(n, j0 + tileSize), a == b);
+    }
+
+    template <bool Gravity>
+    void accumulateForces(const PairKernelData &d, std::size_t n, std::size_t tileSize)
+    {
+        for (std::size_t a = 0; a < d.tiles; a++)
+        {
+            for (std::size_t b = a; b < d.tiles; b++)
+            {
+                interactTilePair<Gravity>(d, n, tileSize, a, b);
+            }
+        }
+    }
+
+    // Every task scatters its tile pairs into a private buffer
+    template <bool Gravity>
+    void accumulateForcesBuffered(const PairKernelData &d, std::size_t n, std::size_t tileSize,
+                                  ForceBufferPool &buffers, ForceArray &forces, ThreadPool &pool)
+    {
+        const std::size_t tiles = (n + tileSize - 1) / tileSize;
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> tilePairs;
+        tilePairs.reserve(tiles * (tiles + 1) / 2);
+        for (std::size_t a = 0; a < tiles; a++)
+        {
+            for (std::size_t b = a; b < tiles; b++)
+            {
+                tilePairs.push_back({static_cast<std::uint32_t>(a), static_cast<std::uint32_t>(b)});
+            }
+        }
+
+        buffers.begin(n);
+        pool.parallelFor(0, tilePairs.size(), [&](std::size_t begin, std::size_t end)
+                         {
+                             ForceArray &buffer = buffers.acquire();
+                             PairKernelData local = d;
+                             local.fx = buffer.x.data();
+                             local.fy = buffer.y.data();
+                             local.fz = buffer.z.data();
+                             for (std::size_t k = begin; k < end; k++)
+                             {
+                                 interactTilePair<Gravity>(local, n, tileSize, tilePairs[k].first, tilePairs[k].second);
+                             }
+                             buffers.release(buffer); });
+        buffers.reduceInto(forces, pool);
+    }
+
+    // Round-robin tournament over the tiles: within a round every tile meets
+    // at most one other, so the tile pairs of a round touch disjoint
+    // particles and run in parallel straight into the shared forces
+    template <bool Gravity>
+    void accumulateForcesColored(const PairKernelData &d, std::size_t n, std::size_t tileSize, ThreadPool &pool)
+    {
+        const std::size_t tiles = (n + tileSize - 1) / tileSize;
+        pool.parallelFor(0, tiles, [&](std::size_t begin, std::size_t end)
+                         {
+                             for (std::size_t a = begin; a < end; a++)
+                             {
+                                 interactTilePair<Gravity>(d, n, tileSize, a, a);
+                             } });
+
+        // Circle method: slot `slots - 1` stays fixed while the others rotate;
+        // with an odd tile count the extra slot is a bye
+        const std::size_t slots = tiles + tiles % 2;
+        for (std::size_t round = 0; round + 1 < slots; round++)
+        {
+            pool.parallelFor(0, slots / 2, [&](std::size_t begin, std::size_t end)
+                             {
+                                 for (std::size_t m = begin; m < end; m++)
+                                 {
+                                     const std::size_t a = (round + m) % (slots - 1);
+                                     const std::size_t b = m == 0 ? slots - 1 : (round + slots - 1 - m) % (slots - 1);
+                                     if (a < tiles && b < tiles)
+                                     {
+                                         interactTilePair<Gravity>(d, n, tileSize, std::min(a, b), std::max(a, b));
+                                     }
+                                 } });
+        }
+    }
+
+    // Pair interactions per task of the target-only evaluation
+    const std::size_t TARGET_TASK_WORK = 1 << 16;
+
+    // Force on every listed target from all particles, written to the
+    // target's own entry without reaction terms. Sums run in Real over one
+    // source tile and in AccumReal across tiles, as in interactTiles(); the
+    // target itself contributes zero (dx = 0).
+    template <bool Gravity>
+    void accumulateTargets(const PairKernelData &d, std::size_t n, std::size_t tileSize, const std::vector<std::uint32_t> &targets, ThreadPool &pool)
+    {
+        const std::size_t grain = std::max<std::size_t>(1, TARGET_TASK_WORK / std::max<std::size_t>(n, 1));
+        pool.parallelFor(0, targets.size(), [&](std::size_t begin, std::size_t end)
+                         {
+                             for (std::size_t t = begin; t < end; t++)
+                             {
+                                 const std::uint32_t i = targets[t];
+                                 const Real xi = d.x[i], yi = d.y[i], zi = d.z[i];
+                                 const Real kqi = d.k * d.q[i];
+                                 const Real gmi = Gravity ? d.g * d.m[i] : Real(0);
+                                 AccumReal fx = 0, fy = 0, fz = 0;
+                                 for (std::size_t j0 = 0; j0 < n; j0 += tileSize)
+                                 {
+                                     const std::size_t j1 = std::min(n, j0 + tileSize);
+                                     Real fxi = 0, fyi = 0, fzi = 0;
+                                     ATOM_SIMD_LOOP(reduction(+ : fxi, fyi, fzi))
+                                     for (std::size_t j = j0; j < j1; j++)
+                                     {
+                                         const Real dx = xi - d.x[j];
+                                         const Real dy = yi - d.y[j];
+                                         const Real dz = zi - d.z[j];
+                                         const Real r2 = dx * dx + dy * dy + dz * dz + d.eps2;
+                                         const Real invR = r2 > Real(0) ? Real(1) / std::sqrt(r2) : Real(0);
+                                         Real c = kqi * d.q[j];
+                                         if (Gravity)
+                                         {
+                                             c -= gmi * d.m[j];
+                                         }
+                                         const Real s = c * invR * invR * invR;
+                                         fxi += s * dx;
+                                         fyi += s * dy;
+                                         fzi += s * dz;
+                                     }
+                                     fx += fxi;
+                                     fy += fyi;
+                                     fz += fzi;
+                                 }
+                                 d.fx[i] = fx;
+                                 d.fy[i] = fy;
+                                 d.fz[i] = fz;
+                             } },
+                         grain);
+    }
+
+    template <bool Gravity>
+    void accumulateForces(const PairKernelData &d, std::size_t n, std::size_t tileSize, ForceAccumulation accumulation,
+                          ForceBufferPool &buffers, ForceArray &forces)
+    {
+        ThreadPool &pool = ThreadPool::global();
+        if (accumulation == ForceAccumulation::Deterministic)
+        {
+            // Same tournament on every thread count: each particle's tile
+            // pairs are added in round order
+            accumulateForcesColored<Gravity>(d, n, tileSize, pool);
+        }
+        else if (accumulation == ForceAccumulation::Serial || pool.size() == 1 || n <= tileSize)
+        {
+            accumulateForces<Gravity>(d, n, tileSize);
+        }
+        else if (accumulation == ForceAccumulation::ThreadBuffers)
+        {
+            accumulateForcesBuffered<Gravity>(d, n, tileSize, buffers, forces, pool);
+        }
+        else
+        {
+            accumulateForcesColored<Gravity>(d, n, tileSize, pool);
+        }
+    }
+}
+
+// Constructor
+CoulombForce::CoulombForce(const CoulombParameters &parameters, std::size_t tileSize)
+    : parameters(parameters), tileSize(tileSize)
+{
+    setTileSize(tileSize);
+}
+
+void CoulombForce::setTileSize(std::size_t size)
+{
+    if (size == 0)
+    {
+        throw std::invalid_argument("Tile size must be positive.");
+    }
+    tileSize = size;
+}
+
+void CoulombForce::computeActiveAccelerations(ParticleSystem &system, const std::vector<std::uint32_t> &active)
+{
+    const std::size_t n = system.size();
+    forces.resize(n);
+    const Vector3Array &positions = system.getPositions();
+    PairKernelData d = {
+        positions.x.data(), positions.y.data(), positions.z.data(),
+        system.getCharges().data(), system.getMasses().data(),
+        forces.x.data(), forces.y.data(), forces.z.data(),
+        static_cast<Real>(parameters.coulombConstant),
+        static_cast<Real>(parameters.gravitationalConstant),
+        static_cast<Real>(parameters.softening * parameters.softening),
+        nullptr, 0};
+
+    // Targets sum on their own, so the order is fixed in every accumulation mode
+    if (parameters.gravitationalConstant != 0.0)
+    {
+        accumulateTargets<true>(d, n, tileSize, active, ThreadPool::global());
+    }
+    else
+    {
+        accumulateTargets<false>(d, n, tileSize, active, ThreadPool::global());
+    }
+    potentialEnergy = std::numeric_limits<double>::quiet_NaN();
+
+    Vector3Array &accelerations = system.getAccelerations();
+    const Real *masses = system.getMasses().data();
+    for (std::uint32_t i : active)
+    {
+        const AccumReal invMass = masses[i] != Real(0) ? AccumReal(1) / masses[i] : AccumReal(0);
+        accelerations.x[i] = static_cast<Real>(forces.x[i] * invMass);
+        accelerations.y[i] = static_cast<Real>(forces.y[i] * invMass);
+        accelerations.z[i] = static_cast<Real>(forces.z[i] * invMass);
+    }
+}
+
+void CoulombForce::computeAccelerations(ParticleSystem &system)
+{
+    const std::size_t n = system.size();
+    forces.resize(n);
+    std::fill(forces.x.begin(), forces.x.end(), AccumReal(0));
+    std::fill(forces.y.begin(), forces.y.end(), AccumReal(0));
+    std::fill(forces.z.begin(), forces.z.end(), AccumReal(0));
+
+    const Vector3Array &positions = system.getPositions();
+    PairKernelData d = {
+        positions.x.data(), positions.y.data(), positions.z.data(),
+        system.getCharges().data(), system.getMasses().data(),
+        forces.x.data(), forces.y.data(), forces.z.data(),
+        static_cast<Real>(parameters.coulombConstant),
+        static_cast<Real>(parameters.gravitationalConstant),
+        static_cast<Real>(parameters.softening * parameters.softening),
+        nullptr, 0};
+    d.tiles = (n + tileSize - 1) / tileSize;
+    tileEnergy.assign(d.tiles * d.tiles, 0.0);
+    d.tileEnergy = tileEnergy.data();
+
+    if (parameters.gravitationalConstant != 0.0)
+    {
+        accumulateForces<true>(d, n, tileSize, accumulation, buffers, forces);
+    }
+    else
+    {
+        accumulateForces<false>(d, n, tileSize, accumulation, buffers, forces);
+    }
+    CompensatedSum<double> energy;
+    for (double e : tileEnergy)
+    {
+        energy += e;
+    }
+    potentialEnergy = energy.value();
+
+    // a = F / m, massless particles do not accelerate
+    Vector3Array &accelerations = system.getAccelerations();
+    const Real *masses = system.getMasses().data();
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const AccumReal invMass = masses[i] != Real(0) ? AccumReal(1) / masses[i] : AccumReal(0);
+        accelerations.x[i] = static_cast<Real>(forces.x[i] * invMass);
+        accelerations.y[i] = static_cast<Real>(forces.y[i] * invMass);
+        accelerations.z[i] = static_cast<Real>(forces.z[i] * invMass);
+    }
+}
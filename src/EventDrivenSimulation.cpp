@@ -0,0 +1,480 @@
+#include "EventDrivenSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    const std::uint32_t NONE = 0xffffffffu;
+    const double INF = std::numeric_limits<double>::infinity();
+
+    // At most this many cells per particle, but no smaller than a diameter:
+    // smaller cells mean fewer neighbours per prediction but more crossings
+    const double CELLS_PER_PARTICLE = 8.0;
+}
+
+// Constructor
+EventDrivenSimulation::EventDrivenSimulation(const Domain &domain, const EventDrivenParameters &parameters) : domain(domain)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        if (!(domain.upper[a] > domain.lower[a]))
+        {
+            throw std::invalid_argument("Event-driven simulation needs a bounded box.");
+        }
+    }
+    setParameters(parameters);
+}
+
+void EventDrivenSimulation::setParameters(const EventDrivenParameters &p)
+{
+    if (!(p.restitution >= 0.0 && p.restitution <= 1.0))
+    {
+        throw std::invalid_argument("Restitution must lie in [0, 1].");
+    }
+    if (!(p.contactDuration >= 0.0))
+    {
+        throw std::invalid_argument("Contact duration must not be negative.");
+    }
+    if (!(p.eventsPerBucket > 0.0))
+    {
+        throw std::invalid_argument("Events per bucket must be positive.");
+    }
+    parameters = p;
+}
+
+// Copy the particles in, lay out the cells and schedule every particle's first event
+void EventDrivenSimulation::load(const ParticleSystem &system)
+{
+    const std::size_t n = system.size();
+    const Vector3Array &positions = system.getPositions();
+    const Vector3Array &velocities = system.getVelocities();
+    states.resize(n);
+    inverseMass.resize(n);
+    version.assign(n, 0);
+    lastImpact.assign(n, -INF);
+    candidates.resize(n);
+    double maxRadius = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        State &s = states[i];
+        const double p[3] = {static_cast<double>(positions.x[i]), static_cast<double>(positions.y[i]), static_cast<double>(positions.z[i])};
+        s.radius = system.getRadius(i);
+        for (int a = 0; a < 3; a++)
+        {
+            // Centers into the box: wrapped along periodic axes, off the walls along the others
+            s.x[a] = domain.periodic[a] ? domain.wrap(p[a], a)
+                                        : std::min(std::max(p[a], domain.lower[a] + s.radius), domain.upper[a] - s.radius);
+        }
+        s.v[0] = velocities.x[i];
+        s.v[1] = velocities.y[i];
+        s.v[2] = velocities.z[i];
+        s.time = now;
+        inverseMass[i] = system.getMasses()[i] > 0 ? 1.0 / system.getMasses()[i] : 0.0;
+        maxRadius = std::max(maxRadius, s.radius);
+    }
+
+    // Cells at least a diameter wide, and no more than CELLS_PER_PARTICLE per particle
+    const double volume = domain.length(0) * domain.length(1) * domain.length(2);
+    const double size = std::max(2.0 * maxRadius, std::cbrt(volume / (CELLS_PER_PARTICLE * std::max<std::size_t>(n, 1))));
+    for (int a = 0; a < 3; a++)
+    {
+        dims[a] = std::max(1, static_cast<int>(domain.length(a) / size));
+        if (domain.periodic[a] && dims[a] < 3)
+        {
+            // Few particles ask for large cells, but the image shifts need three
+            if (domain.length(a) < 3.0 * 2.0 * maxRadius)
+            {
+                throw std::invalid_argument("Periodic box too small: it must be at least three largest diameters long.");
+            }
+            dims[a] = 3;
+        }
+        cellSize[a] = domain.length(a) / dims[a];
+    }
+    cellHead.assign(static_cast<std::size_t>(dims[0]) * dims[1] * dims[2], NONE);
+    next.resize(n);
+    previous.resize(n);
+    cell.resize(3 * n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            const int c = static_cast<int>(std::floor((states[i].x[a] - domain.lower[a]) / cellSize[a]));
+            cell[3 * i + a] = std::min(std::max(c, 0), dims[a] - 1);
+        }
+        link(static_cast<std::uint32_t>(i));
+    }
+
+    // Size the calendar days from the mean time to the first events
+    std::vector<Event> events;
+    events.reserve(n);
+    double sum = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        Event event;
+        if (nextEvent(static_cast<std::uint32_t>(i), event, nullptr))
+        {
+            events.push_back(event);
+            sum += event.time - now;
+        }
+    }
+    const double meanInterval = events.empty() ? 0.0 : sum / events.size();
+    const double width = meanInterval > 0.0 ? parameters.eventsPerBucket * meanInterval / events.size() : 1.0;
+    queue.reset(std::max<std::size_t>(n, 1), width, now);
+    for (const Event &event : events)
+    {
+        queue.push(event);
+    }
+
+    statistics.rebuilds++;
+    layoutVersion = system.getLayoutVersion();
+    valid = true;
+}
+
+// Write every particle, advanced to the current time, back
+void EventDrivenSimulation::store(ParticleSystem &system)
+{
+    Vector3Array &positions = system.getPositions();
+    Vector3Array &velocities = system.getVelocities();
+    for (std::uint32_t i = 0; i < states.size(); i++)
+    {
+        synchronize(i);
+        const State &s = states[i];
+        positions.x[i] = static_cast<Real>(domain.wrap(s.x[0], 0));
+        positions.y[i] = static_cast<Real>(domain.wrap(s.x[1], 1));
+        positions.z[i] = static_cast<Real>(domain.wrap(s.x[2], 2));
+        velocities.x[i] = static_cast<Real>(s.v[0]);
+        velocities.y[i] = static_cast<Real>(s.v[1]);
+        velocities.z[i] = static_cast<Real>(s.v[2]);
+    }
+}
+
+// Cell lists, doubly linked so that a crossing unlinks in O(1)
+void EventDrivenSimulation::link(std::uint32_t i)
+{
+    const std::size_t c = (static_cast<std::size_t>(cell[3 * i + 2]) * dims[1] + cell[3 * i + 1]) * dims[0] + cell[3 * i];
+    previous[i] = NONE;
+    next[i] = cellHead[c];
+    if (next[i] != NONE)
+    {
+        previous[next[i]] = i;
+    }
+    cellHead[c] = i;
+}
+
+void EventDrivenSimulation::unlink(std::uint32_t i)
+{
+    const std::size_t c = (static_cast<std::size_t>(cell[3 * i + 2]) * dims[1] + cell[3 * i + 1]) * dims[0] + cell[3 * i];
+    if (previous[i] != NONE)
+    {
+        next[previous[i]] = next[i];
+    }
+    else
+    {
+        cellHead[c] = next[i];
+    }
+    if (next[i] != NONE)
+    {
+        previous[next[i]] = previous[i];
+    }
+}
+
+// Advance a particle along its straight line to the current time
+void EventDrivenSimulation::synchronize(std::uint32_t i)
+{
+    State &s = states[i];
+    const double dt = now - s.time;
+    s.x[0] += s.v[0] * dt;
+    s.x[1] += s.v[1] * dt;
+    s.x[2] += s.v[2] * dt;
+    s.time = now;
+}
+
+// Earliest of the particle's wall contact or cell crossing and its impacts
+// with the spheres of the surrounding cells; false if it has none.
+//
+// Right after `crossing`, only the slab of cells that just became adjacent
+// is scanned: the earliest impact with the others was cached by the last
+// scan, and stays the earliest as long as that partner keeps its course,
+// since spheres that moved in or changed course since then have predicted
+// their impacts with this one themselves.
+bool EventDrivenSimulation::nextEvent(std::uint32_t i, Event &event, const Event *crossing)
+{
+    statistics.predictions++;
+    synchronize(i);
+    const State &s = states[i];
+    event.time = INF;
+    event.particle = i;
+    event.partner = NONE;
+    event.version = version[i];
+    event.partnerVersion = 0;
+
+    const std::int32_t *c = &cell[3 * i];
+    for (int a = 0; a < 3; a++)
+    {
+        const double v = s.v[a];
+        if (v == 0.0)
+        {
+            continue;
+        }
+        const int direction = v > 0.0 ? 1 : -1;
+        const bool edge = direction > 0 ? c[a] == dims[a] - 1 : c[a] == 0;
+        double target;
+        EventType type;
+        if (edge && !domain.periodic[a])
+        {
+            target = direction > 0 ? domain.upper[a] - s.radius : domain.lower[a] + s.radius;
+            type = EventType::Wall;
+        }
+        else
+        {
+            target = domain.lower[a] + (c[a] + (direction > 0 ? 1 : 0)) * cellSize[a];
+            type = EventType::Crossing;
+        }
+        const double t = now + std::max((target - s.x[a]) / v, 0.0);
+        if (t < event.time)
+        {
+            event.time = t;
+            event.type = type;
+            event.axis = static_cast<std::uint8_t>(a);
+            event.direction = static_cast<std::int8_t>(direction);
+        }
+    }
+
+    Candidate best = {INF, NONE, 0};
+    if (crossing != nullptr)
+    {
+        const Candidate &cached = candidates[i];
+        if (cached.partner != NONE && version[cached.partner] == cached.partnerVersion)
+        {
+            best = cached;
+        }
+        else if (cached.partner != NONE)
+        {
+            crossing = nullptr;
+        }
+    }
+
+    // Spheres in the 27 surrounding cells, with the image shift across
+    // periodic boundaries; the three neighbours along each axis first
+    int neighbors[3][3];
+    double shifts[3][3];
+    int counts[3] = {0, 0, 0};
+    for (int a = 0; a < 3; a++)
+    {
+        for (int offset = -1; offset <= 1; offset++)
+        {
+            if (crossing != nullptr && a == crossing->axis && offset != crossing->direction)
+            {
+                continue;
+            }
+            int neighbor = c[a] + offset;
+            double shift = 0.0;
+            if (neighbor < 0 || neighbor >= dims[a])
+            {
+                if (!domain.periodic[a])
+                {
+                    continue;
+                }
+                shift = neighbor < 0 ? -domain.length(a) : domain.length(a);
+                neighbor = (neighbor + dims[a]) % dims[a];
+            }
+            neighbors[a][counts[a]] = neighbor;
+            shifts[a][counts[a]] = shift;
+            counts[a]++;
+        }
+    }
+    const double sx = s.x[0], sy = s.x[1], sz = s.x[2];
+    const double su = s.v[0], sv = s.v[1], sw = s.v[2];
+    const bool immovable = inverseMass[i] == 0.0;
+    for (int kz = 0; kz < counts[2]; kz++)
+    {
+        for (int ky = 0; ky < counts[1]; ky++)
+        {
+            const std::size_t row = (static_cast<std::size_t>(neighbors[2][kz]) * dims[1] + neighbors[1][ky]) * dims[0];
+            for (int kx = 0; kx < counts[0]; kx++)
+            {
+                // Relative position with the image shift folded in
+                const double px = sx - shifts[0][kx], py = sy - shifts[1][ky], pz = sz - shifts[2][kz];
+                for (std::uint32_t j = cellHead[row + neighbors[0][kx]]; j != NONE; j = next[j])
+                {
+                    if (j == i || (immovable && inverseMass[j] == 0.0))
+                    {
+                        continue;
+                    }
+                    // |r + u t| = sigma for the relative position r and velocity u, earlier root
+                    const State &o = states[j];
+                    const double lag = now - o.time;
+                    const double rx = px - (o.x[0] + o.v[0] * lag), ry = py - (o.x[1] + o.v[1] * lag), rz = pz - (o.x[2] + o.v[2] * lag);
+                    const double ux = su - o.v[0], uy = sv - o.v[1], uz = sw - o.v[2];
+                    const double b = rx * ux + ry * uy + rz * uz;
+                    if (b >= 0.0)
+                    {
+                        continue;
+                    }
+                    const double sigma = s.radius + o.radius;
+                    const double gap = rx * rx + ry * ry + rz * rz - sigma * sigma;
+                    double t = now;
+                    if (gap > 0.0)
+                    {
+                        const double uu = ux * ux + uy * uy + uz * uz;
+                        const double discriminant = b * b - uu * gap;
+                        if (discriminant <= 0.0)
+                        {
+                            continue;
+                        }
+                        t = now + gap / (-b + std::sqrt(discriminant));
+                    }
+                    if (t < best.time)
+                    {
+                        best = {t, j, version[j]};
+                    }
+                }
+            }
+        }
+    }
+    candidates[i] = best;
+    if (best.time < event.time)
+    {
+        event.time = best.time;
+        event.type = EventType::Collision;
+        event.partner = best.partner;
+        event.partnerVersion = best.partnerVersion;
+    }
+    return event.time < INF;
+}
+
+void EventDrivenSimulation::predict(std::uint32_t i, const Event *crossing)
+{
+    Event event;
+    if (nextEvent(i, event, crossing))
+    {
+        queue.push(event);
+    }
+}
+
+// Impulse along the line of centers, as in CollisionSystem; elastic if
+// either sphere was hit less than contactDuration ago
+void EventDrivenSimulation::collide(std::uint32_t i, std::uint32_t j)
+{
+    synchronize(i);
+    synchronize(j);
+    State &a = states[i];
+    State &b = states[j];
+    double d[3] = {a.x[0] - b.x[0], a.x[1] - b.x[1], a.x[2] - b.x[2]};
+    domain.minimumImage(d);
+    const double distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    const double wi = inverseMass[i], wj = inverseMass[j];
+    if (distance > 0.0)
+    {
+        const double n[3] = {d[0] / distance, d[1] / distance, d[2] / distance};
+        const double approach = (a.v[0] - b.v[0]) * n[0] + (a.v[1] - b.v[1]) * n[1] + (a.v[2] - b.v[2]) * n[2];
+        if (approach < 0.0)
+        {
+            double restitution = parameters.restitution;
+            if (restitution < 1.0 && std::min(now - lastImpact[i], now - lastImpact[j]) < parameters.contactDuration)
+            {
+                restitution = 1.0;
+                statistics.elasticImpacts++;
+            }
+            const double impulse = -(1.0 + restitution) * approach / (wi + wj);
+            for (int k = 0; k < 3; k++)
+            {
+                a.v[k] += impulse * wi * n[k];
+                b.v[k] -= impulse * wj * n[k];
+            }
+        }
+    }
+    statistics.collisions++;
+    lastImpact[i] = lastImpact[j] = now;
+    version[i]++;
+    version[j]++;
+    predict(i);
+    predict(j);
+}
+
+// Elastic reflection off a wall, the center placed exactly one radius from it
+void EventDrivenSimulation::reflect(const Event &event)
+{
+    const std::uint32_t i = event.particle;
+    synchronize(i);
+    State &s = states[i];
+    const int a = event.axis;
+    s.x[a] = event.direction > 0 ? domain.upper[a] - s.radius : domain.lower[a] + s.radius;
+    s.v[a] = -s.v[a];
+    statistics.wallCollisions++;
+    version[i]++;
+    predict(i);
+}
+
+// Move into the next cell, the center placed exactly on the boundary and
+// wrapped around periodic ones; the trajectory, and so every prediction
+// involving the particle, stays valid
+void EventDrivenSimulation::cross(const Event &event)
+{
+    const std::uint32_t i = event.particle;
+    synchronize(i);
+    unlink(i);
+    State &s = states[i];
+    const int a = event.axis;
+    std::int32_t &c = cell[3 * i + a];
+    s.x[a] = domain.lower[a] + (c + (event.direction > 0 ? 1 : 0)) * cellSize[a];
+    c += event.direction;
+    if (c < 0)
+    {
+        c = dims[a] - 1;
+        s.x[a] = domain.upper[a];
+    }
+    else if (c >= dims[a])
+    {
+        c = 0;
+        s.x[a] = domain.lower[a];
+    }
+    link(i);
+    statistics.cellCrossings++;
+    predict(i, &event);
+}
+
+void EventDrivenSimulation::advance(ParticleSystem &system, double duration)
+{
+    if (!valid || system.size() != states.size() || system.getLayoutVersion() != layoutVersion)
+    {
+        load(system);
+    }
+    const double end = now + duration;
+    Event event;
+    while (queue.popBefore(end, event))
+    {
+        now = event.time;
+        if (version[event.particle] != event.version)
+        {
+            statistics.staleEvents++;
+            continue;
+        }
+        switch (event.type)
+        {
+        case EventType::Collision:
+            if (version[event.partner] != event.partnerVersion)
+            {
+                // The partner changed course: look again
+                statistics.staleEvents++;
+                predict(event.particle);
+            }
+            else
+            {
+                collide(event.particle, event.partner);
+            }
+            break;
+        case EventType::Wall:
+            reflect(event);
+            break;
+        case EventType::Crossing:
+            cross(event);
+            break;
+        }
+    }
+    now = end;
+    store(system);
+}
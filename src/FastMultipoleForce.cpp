@@ -0,0 +1,705 @@
+#include "FastMultipoleForce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "CompensatedSum.h"
+#include "Morton.h"
+#include "MortonOrder.h"
+#include "SimdPragmas.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    using Complex = std::complex<double>;
+
+    constexpr int MAX_DEPTH = Morton::BITS_PER_AXIS;
+    constexpr int MAX_ORDER = FastMultipoleForce::MAX_EXPANSION_ORDER;
+
+    // Harmonics of degree <= 2 p are needed by M2L
+    constexpr int MAX_HARMONICS = (2 * MAX_ORDER + 1) * (2 * MAX_ORDER + 1);
+
+    // (-1)^n
+    inline double oddOrEven(int n)
+    {
+        return (n & 1) ? -1.0 : 1.0;
+    }
+
+    // Plain complex product; std::complex's operator* checks for NaN/inf
+    // operands on every call
+    inline Complex times(const Complex &a, const Complex &b)
+    {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // Index of (n, m), -n <= m <= n, in a full harmonics array
+    inline int fullIndex(int n, int m)
+    {
+        return n * n + n + m;
+    }
+
+    // Index of (n, m), 0 <= m <= n, in an expansion; negative m are conjugates
+    inline int termIndex(int n, int m)
+    {
+        return n * (n + 1) / 2 + m;
+    }
+
+    // Offset d in spherical form: radius, cos/sin of the polar angle and e^(i phi)
+    struct Spherical
+    {
+        double rho;
+        double cosTheta;
+        double sinTheta;
+        Complex phase;
+    };
+
+    inline Spherical toSpherical(const double d[3])
+    {
+        const double rxy = std::sqrt(d[0] * d[0] + d[1] * d[1]);
+        const double rho = std::sqrt(rxy * rxy + d[2] * d[2]);
+        Spherical s = {rho, 1.0, 0.0, Complex(1.0, 0.0)};
+        if (rho > 0.0)
+        {
+            s.cosTheta = d[2] / rho;
+            s.sinTheta = rxy / rho;
+        }
+        if (rxy > 0.0)
+        {
+            s.phase = Complex(d[0] / rxy, d[1] / rxy);
+        }
+        return s;
+    }
+
+    // Regular solid harmonics r^n Y_n^m / (n + m)! (with the sign convention of
+    // the translation operators below) for every degree n <= degree
+    void regularHarmonics(const double d[3], int degree, Complex *Y)
+    {
+        const Spherical s = toSpherical(d);
+        const double rho = s.rho;
+        const double x = s.cosTheta;
+        const double y = s.sinTheta;
+        const Complex ei = s.phase;
+        Complex eim = 1.0;
+        double fact = 1.0;
+        double pn = 1.0;
+        double rhom = 1.0;
+        for (int m = 0; m <= degree; m++)
+        {
+            double p = pn;
+            Y[fullIndex(m, m)] = rhom * p * eim;
+            Y[fullIndex(m, -m)] = std::conj(Y[fullIndex(m, m)]);
+            double p1 = p;
+            p = x * (2 * m + 1) * p1;
+            rhom *= rho;
+            double rhon = rhom;
+            for (int n = m + 1; n <= degree; n++)
+            {
+                rhon /= -(n + m);
+                Y[fullIndex(n, m)] = rhon * p * eim;
+                Y[fullIndex(n, -m)] = std::conj(Y[fullIndex(n, m)]);
+                const double p2 = p1;
+                p1 = p;
+                p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);
+                rhon *= rho;
+            }
+            rhom /= -(2 * m + 2) * (2 * m + 1);
+            pn = -pn * fact * y;
+            fact += 2.0;
+            eim = times(eim, ei);
+        }
+    }
+
+    // Irregular solid harmonics (n - m)! Y_n^m / r^(n+1) for every degree n <= degree
+    void irregularHarmonics(const double d[3], int degree, Complex *Y)
+    {
+        const Spherical s = toSpherical(d);
+        const double x = s.cosTheta;
+        const double y = s.sinTheta;
+        const Complex ei = s.phase;
+        Complex eim = 1.0;
+        double fact = 1.0;
+        double pn = 1.0;
+        const double invR = -1.0 / s.rho;
+        double rhom = -invR;
+        for (int m = 0; m <= degree; m++)
+        {
+            double p = pn;
+            Y[fullIndex(m, m)] = rhom * p * eim;
+            Y[fullIndex(m, -m)] = std::conj(Y[fullIndex(m, m)]);
+            double p1 = p;
+            p = x * (2 * m + 1) * p1;
+            rhom *= invR;
+            double rhon = rhom;
+            for (int n = m + 1; n <= degree; n++)
+            {
+                Y[fullIndex(n, m)] = rhon * p * eim;
+                Y[fullIndex(n, -m)] = std::conj(Y[fullIndex(n, m)]);
+                const double p2 = p1;
+                p1 = p;
+                p = (x * (2 * n + 1) * p1 - (n + m) * p2) / (n - m + 1);
+                rhon *= invR * (n - m + 1);
+            }
+            pn = -pn * fact * y;
+            fact += 2.0;
+            eim = times(eim, ei);
+        }
+    }
+
+    // Expansion translations for a fixed order p. Each expansion holds
+    // (p + 1)(p + 2) / 2 coefficients.
+    struct Translations
+    {
+        int p;
+
+        // Multipole about `center` of point sources s at d = r - center
+        void p2m(const double d[3], const double *s, int kinds, Complex *const *M) const
+        {
+            // Conjugated harmonics are the harmonics of the offset mirrored in y
+            Complex Y[MAX_HARMONICS];
+            const double mirrored[3] = {d[0], -d[1], d[2]};
+            regularHarmonics(mirrored, p, Y);
+            for (int n = 0; n <= p; n++)
+            {
+                for (int m = 0; m <= n; m++)
+                {
+                    for (int kind = 0; kind < kinds; kind++)
+                    {
+                        M[kind][termIndex(n, m)] += s[kind] * Y[fullIndex(n, m)];
+                    }
+                }
+            }
+        }
+
+        // Shift the child multipole Mc into the parent multipole M; d = parent - child center
+        void m2m(const double d[3], const Complex *Mc, Complex *M) const
+        {
+            Complex Y[MAX_HARMONICS];
+            regularHarmonics(d, p, Y);
+            for (int j = 0; j <= p; j++)
+            {
+                for (int k = 0; k <= j; k++)
+                {
+                    Complex sum = 0.0;
+                    for (int n = 0; n <= j; n++)
+                    {
+                        for (int m = std::max(-n, -j + k + n); m <= std::min(k - 1, n); m++)
+                        {
+                            const double sign = (m < 0 ? oddOrEven(m) : 1.0) * oddOrEven(n);
+                            sum += sign * times(Mc[termIndex(j - n, k - m)], Y[fullIndex(n, -m)]);
+                        }
+                        for (int m = k; m <= std::min(n, j + k - n); m++)
+                        {
+                            sum += oddOrEven(k + n + m) * times(std::conj(Mc[termIndex(j - n, m - k)]), Y[fullIndex(n, -m)]);
+                        }
+                    }
+                    M[termIndex(j, k)] += sum;
+                }
+            }
+        }
+
+        // Convert the source multipoles M into the target locals L; d = target - source center
+        template <int Kinds>
+        void m2l(const double d[3], const Complex *const *M, Complex *const *L) const
+        {
+            constexpr int FULL = (MAX_ORDER + 1) * (MAX_ORDER + 1);
+            Complex Y[MAX_HARMONICS];
+            irregularHarmonics(d, 2 * p, Y);
+
+            // Real and imaginary parts in separate arrays so the m loops vectorize
+            double yRe[MAX_HARMONICS], yIm[MAX_HARMONICS];
+            for (int i = 0; i < (2 * p + 1) * (2 * p + 1); i++)
+            {
+                yRe[i] = Y[i].real();
+                yIm[i] = Y[i].imag();
+            }
+
+            // Source coefficients for -n <= m <= n, negative orders as conjugates
+            double mRe[Kinds][FULL], mIm[Kinds][FULL];
+            for (int kind = 0; kind < Kinds; kind++)
+            {
+                for (int n = 0; n <= p; n++)
+                {
+                    for (int m = 0; m <= n; m++)
+                    {
+                        const Complex c = M[kind][termIndex(n, m)];
+                        mRe[kind][fullIndex(n, m)] = c.real();
+                        mIm[kind][fullIndex(n, m)] = c.imag();
+                        mRe[kind][fullIndex(n, -m)] = c.real();
+                        mIm[kind][fullIndex(n, -m)] = -c.imag();
+                    }
+                }
+            }
+
+            // L_jk = (-1)^j sum_nm s(k, m) M_nm Y_(j+n)(m-k), where s = 1 for
+            // m < 0, (-1)^m for 0 <= m <= k and (-1)^k for m > k
+            double signs[2 * MAX_ORDER + 1];
+            double *sign = signs + MAX_ORDER;
+            for (int k = 0; k <= p; k++)
+            {
+                for (int m = -p; m <= p; m++)
+                {
+                    sign[m] = m < 0 ? 1.0 : oddOrEven(m <= k ? m : k);
+                }
+                for (int j = k; j <= p; j++)
+                {
+                    double sumRe[Kinds] = {}, sumIm[Kinds] = {};
+                    for (int n = 0; n <= p; n++)
+                    {
+                        const double *yr = &yRe[fullIndex(j + n, -k)];
+                        const double *yi = &yIm[fullIndex(j + n, -k)];
+                        for (int kind = 0; kind < Kinds; kind++)
+                        {
+                            const double *mr = &mRe[kind][fullIndex(n, 0)];
+                            const double *mi = &mIm[kind][fullIndex(n, 0)];
+                            double re = 0.0, im = 0.0;
+                            ATOM_SIMD_LOOP(reduction(+ : re, im))
+                            for (int m = -n; m <= n; m++)
+                            {
+                                re += sign[m] * (mr[m] * yr[m] - mi[m] * yi[m]);
+                                im += sign[m] * (mr[m] * yi[m] + mi[m] * yr[m]);
+                            }
+                            sumRe[kind] += re;
+                            sumIm[kind] += im;
+                        }
+                    }
+                    const double cj = oddOrEven(j);
+                    for (int kind = 0; kind < Kinds; kind++)
+                    {
+                        L[kind][termIndex(j, k)] += Complex(cj * sumRe[kind], cj * sumIm[kind]);
+                    }
+                }
+            }
+        }
+
+        // Coefficients (j, k), j <= maxDegree, of the local L re-expanded at
+        // offset d from its center
+        void shiftLocal(const Complex *Y, const Complex *L, int maxDegree, Complex *out) const
+        {
+            for (int j = 0; j <= maxDegree; j++)
+            {
+                for (int k = 0; k <= j; k++)
+                {
+                    Complex sum = 0.0;
+                    for (int n = j; n <= p; n++)
+                    {
+                        for (int m = j + k - n; m < 0; m++)
+                        {
+                            sum += oddOrEven(k) * times(std::conj(L[termIndex(n, -m)]), Y[fullIndex(n - j, m - k)]);
+                        }
+                        for (int m = 0; m <= n; m++)
+                        {
+                            if (n - j >= std::abs(m - k))
+                            {
+                                sum += oddOrEven(m < k ? m - k : 0) * times(L[termIndex(n, m)], Y[fullIndex(n - j, m - k)]);
+                            }
+                        }
+                    }
+                    out[termIndex(j, k)] += sum;
+                }
+            }
+        }
+
+        // Shift the parent local L into the child local Lc; d = child - parent center
+        void l2l(const double d[3], const Complex *L, Complex *Lc) const
+        {
+            Complex Y[MAX_HARMONICS];
+            regularHarmonics(d, p, Y);
+            shiftLocal(Y, L, p, Lc);
+        }
+
+        // Potential phi and field -grad(phi) of the local L at offset d from
+        // its center. The local re-expanded at the point holds phi as its
+        // degree-0 term and the gradient in its degree-1 terms.
+        void l2p(const double d[3], const Complex *L, double e[3], double &phi) const
+        {
+            Complex Y[MAX_HARMONICS];
+            regularHarmonics(d, p, Y);
+            Complex shifted[3] = {0.0, 0.0, 0.0};
+            shiftLocal(Y, L, 1, shifted);
+            phi += shifted[termIndex(0, 0)].real();
+            e[0] += -shifted[termIndex(1, 1)].real();
+            e[1] += shifted[termIndex(1, 1)].imag();
+            e[2] += shifted[termIndex(1, 0)].real();
+        }
+    };
+}
+
+// Constructor
+FastMultipoleForce::FastMultipoleForce(const CoulombParameters &parameters, const FastMultipoleParameters &fmmParameters)
+    : parameters(parameters)
+{
+    setFmmParameters(fmmParameters);
+}
+
+void FastMultipoleForce::setFmmParameters(const FastMultipoleParameters &p)
+{
+    if (p.expansionOrder < 0 || p.expansionOrder > MAX_EXPANSION_ORDER)
+    {
+        throw std::invalid_argument("Expansion order must be between 0 and " + std::to_string(MAX_EXPANSION_ORDER) + ".");
+    }
+    if (!(p.theta > 0.0 && p.theta < 1.0))
+    {
+        throw std::invalid_argument("FMM opening angle must be in (0, 1).");
+    }
+    fmmParameters = p;
+}
+
+void FastMultipoleForce::setExpansionOrder(int order)
+{
+    FastMultipoleParameters p = fmmParameters;
+    p.expansionOrder = order;
+    setFmmParameters(p);
+}
+
+void FastMultipoleForce::setTheta(double theta)
+{
+    FastMultipoleParameters p = fmmParameters;
+    p.theta = theta;
+    setFmmParameters(p);
+}
+
+std::size_t FastMultipoleForce::termCount() const
+{
+    const std::size_t p = static_cast<std::size_t>(fmmParameters.expansionOrder);
+    return (p + 1) * (p + 2) / 2;
+}
+
+void FastMultipoleForce::build(const ParticleSystem &system)
+{
+    cells.clear();
+    const std::size_t n = system.size();
+    if (n == 0)
+    {
+        return;
+    }
+    const Vector3Array &positions = system.getPositions();
+    const MortonCube cube = mortonOrder(system, keys, order);
+    FastMultipoleCell root = {};
+    for (int a = 0; a < 3; a++)
+    {
+        root.center[a] = cube.center[a];
+    }
+    root.halfSize = cube.halfSize;
+    root.end = static_cast<std::uint32_t>(n);
+
+    sortedX.resize(n);
+    sortedY.resize(n);
+    sortedZ.resize(n);
+    sortedCharge.resize(n);
+    sortedMass.resize(n);
+    for (std::size_t s = 0; s < n; s++)
+    {
+        const std::uint32_t i = order[s];
+        sortedX[s] = positions.x[i];
+        sortedY[s] = positions.y[i];
+        sortedZ[s] = positions.z[i];
+        sortedCharge[s] = system.getCharges()[i];
+        sortedMass[s] = system.getMasses()[i];
+    }
+
+    // Split cells until they hold at most leafSize particles. Children are
+    // appended contiguously, level by level within each subtree.
+    const std::size_t leafSize = std::max<std::size_t>(fmmParameters.leafSize, 1);
+    std::vector<std::pair<std::uint32_t, int>> pending = {{0, 0}};
+    cells.push_back(root);
+    while (!pending.empty())
+    {
+        const std::uint32_t index = pending.back().first;
+        const int level = pending.back().second;
+        pending.pop_back();
+        const FastMultipoleCell parent = cells[index];
+
+        if (parent.end - parent.begin > leafSize && level < MAX_DEPTH)
+        {
+            const std::uint32_t first = static_cast<std::uint32_t>(cells.size());
+            std::uint32_t begin = parent.begin;
+            const double quarter = 0.5 * parent.halfSize;
+            for (unsigned oct = 0; oct < 8; oct++)
+            {
+                const std::uint32_t end = static_cast<std::uint32_t>(
+                    std::partition_point(keys.begin() + begin, keys.begin() + parent.end,
+                                         [&](std::uint64_t key)
+                                         { return Morton::octant(key, level) <= oct; }) -
+                    keys.begin());
+                if (begin == end)
+                {
+                    continue;
+                }
+                FastMultipoleCell child = {};
+                child.center[0] = parent.center[0] + ((oct & 4) ? quarter : -quarter);
+                child.center[1] = parent.center[1] + ((oct & 2) ? quarter : -quarter);
+                child.center[2] = parent.center[2] + ((oct & 1) ? quarter : -quarter);
+                child.halfSize = quarter;
+                child.begin = begin;
+                child.end = end;
+                cells.push_back(child);
+                begin = end;
+            }
+            cells[index].firstChild = first;
+            cells[index].childCount = static_cast<std::uint32_t>(cells.size()) - first;
+            for (std::uint32_t c = cells[index].childCount; c-- > 0;)
+            {
+                pending.push_back({first + c, level + 1});
+            }
+        }
+
+        // Tight radius for the separation test
+        double r2 = 0.0;
+        for (std::uint32_t i = parent.begin; i < parent.end; i++)
+        {
+            const double dx = sortedX[i] - parent.center[0];
+            const double dy = sortedY[i] - parent.center[1];
+            const double dz = sortedZ[i] - parent.center[2];
+            r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+        }
+        cells[index].radius = std::sqrt(r2);
+    }
+}
+
+template <bool Gravity>
+void FastMultipoleForce::evaluate(ParticleSystem &system)
+{
+    constexpr int kinds = Gravity ? 2 : 1;
+    const std::size_t n = system.size();
+    const std::size_t terms = termCount();
+    const double theta2 = fmmParameters.theta * fmmParameters.theta;
+    const double eps2 = parameters.softening * parameters.softening;
+    const Translations translate = {fmmParameters.expansionOrder};
+    const double *__restrict sx = sortedX.data();
+    const double *__restrict sy = sortedY.data();
+    const double *__restrict sz = sortedZ.data();
+    const double *__restrict sq = sortedCharge.data();
+    const double *__restrict sm = sortedMass.data();
+
+    multipoles.assign(cells.size() * kinds * terms, Complex(0.0));
+    locals.assign(cells.size() * kinds * terms, Complex(0.0));
+    fieldX.assign(kinds * n, 0.0);
+    fieldY.assign(kinds * n, 0.0);
+    fieldZ.assign(kinds * n, 0.0);
+    potential.assign(kinds * n, 0.0);
+
+    auto multipole = [&](std::uint32_t cell, int kind)
+    { return &multipoles[(cell * kinds + kind) * terms]; };
+    auto local = [&](std::uint32_t cell, int kind)
+    { return &locals[(cell * kinds + kind) * terms]; };
+
+    const FastMultipoleCell &root = cells[0];
+
+    // Subtrees of cells holding at least forkSize particles are forked onto
+    // the thread pool; tasks never share a target cell, so they write
+    // disjoint expansions and fields
+    ThreadPool &pool = ThreadPool::global();
+    const std::size_t forkSize = n >= fmmParameters.parallelThreshold && pool.size() > 1
+                                     ? std::max<std::size_t>(4 * fmmParameters.leafSize, n / (8 * pool.size()))
+                                     : std::numeric_limits<std::size_t>::max();
+    auto forEachChild = [&](const FastMultipoleCell &cell, const auto &task)
+    {
+        if (cell.end - cell.begin < forkSize)
+        {
+            for (std::uint32_t c = cell.firstChild; c < cell.firstChild + cell.childCount; c++)
+            {
+                task(c);
+            }
+            return;
+        }
+        TaskGroup group(pool);
+        for (std::uint32_t c = cell.firstChild; c < cell.firstChild + cell.childCount; c++)
+        {
+            group.run([&task, c]()
+                      { task(c); });
+        }
+        group.wait();
+    };
+
+    // Upward pass: P2M at the leaves, M2M towards the root
+    std::function<void(std::uint32_t)> upward = [&](std::uint32_t index)
+    {
+        const FastMultipoleCell &cell = cells[index];
+        Complex *M[2] = {multipole(index, 0), multipole(index, kinds - 1)};
+        if (cell.childCount == 0)
+        {
+            for (std::uint32_t i = cell.begin; i < cell.end; i++)
+            {
+                const double d[3] = {sx[i] - cell.center[0], sy[i] - cell.center[1], sz[i] - cell.center[2]};
+                const double s[2] = {sq[i], sm[i]};
+                translate.p2m(d, s, kinds, M);
+            }
+            return;
+        }
+        forEachChild(cell, upward);
+        for (std::uint32_t c = cell.firstChild; c < cell.firstChild + cell.childCount; c++)
+        {
+            const double d[3] = {cell.center[0] - cells[c].center[0], cell.center[1] - cells[c].center[1], cell.center[2] - cells[c].center[2]};
+            for (int kind = 0; kind < kinds; kind++)
+            {
+                translate.m2m(d, multipole(c, kind), M[kind]);
+            }
+        }
+    };
+
+    // Direct sum of the particles of `source` onto the particles of `target`;
+    // a target adds no field of its own and is masked out of the potential
+    auto p2p = [&](const FastMultipoleCell &target, const FastMultipoleCell &source)
+    {
+        for (std::uint32_t t = target.begin; t < target.end; t++)
+        {
+            const double xt = sx[t], yt = sy[t], zt = sz[t];
+            double ex = 0.0, ey = 0.0, ez = 0.0, gx = 0.0, gy = 0.0, gz = 0.0, pq = 0.0, pm = 0.0;
+            ATOM_SIMD_LOOP(reduction(+ : ex, ey, ez, gx, gy, gz, pq, pm))
+            for (std::uint32_t j = source.begin; j < source.end; j++)
+            {
+                const double dx = xt - sx[j];
+                const double dy = yt - sy[j];
+                const double dz = zt - sz[j];
+                const double r2 = dx * dx + dy * dy + dz * dz + eps2;
+                const double invR = r2 > 0.0 ? 1.0 / std::sqrt(r2) : 0.0;
+                const double invR3 = invR * invR * invR;
+                const double other = j != t ? invR : 0.0;
+                ex += sq[j] * invR3 * dx;
+                ey += sq[j] * invR3 * dy;
+                ez += sq[j] * invR3 * dz;
+                pq += sq[j] * other;
+                if (Gravity)
+                {
+                    gx += sm[j] * invR3 * dx;
+                    gy += sm[j] * invR3 * dy;
+                    gz += sm[j] * invR3 * dz;
+                    pm += sm[j] * other;
+                }
+            }
+            fieldX[t] += ex;
+            fieldY[t] += ey;
+            fieldZ[t] += ez;
+            potential[t] += pq;
+            if (Gravity)
+            {
+                fieldX[n + t] += gx;
+                fieldY[n + t] += gy;
+                fieldZ[n + t] += gz;
+                potential[n + t] += pm;
+            }
+        }
+    };
+
+    // Dual tree traversal: M2L between well-separated cells, P2P between
+    // neighboring leaves, otherwise split the larger cell. Only the locals and
+    // fields of the target subtree are written.
+    std::function<void(std::uint32_t, std::uint32_t)> interact = [&](std::uint32_t targetIndex, std::uint32_t sourceIndex)
+    {
+        const FastMultipoleCell &target = cells[targetIndex];
+        const FastMultipoleCell &source = cells[sourceIndex];
+        const double d[3] = {target.center[0] - source.center[0], target.center[1] - source.center[1], target.center[2] - source.center[2]};
+        const double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        const double reach = target.radius + source.radius;
+        if (reach * reach < theta2 * d2)
+        {
+            const Complex *M[2] = {multipole(sourceIndex, 0), multipole(sourceIndex, kinds - 1)};
+            Complex *L[2] = {local(targetIndex, 0), local(targetIndex, kinds - 1)};
+            translate.m2l<kinds>(d, M, L);
+        }
+        else if (target.childCount == 0 && source.childCount == 0)
+        {
+            p2p(target, source);
+        }
+        else if (source.childCount == 0 || (target.childCount != 0 && target.radius >= source.radius))
+        {
+            forEachChild(target, [&](std::uint32_t c)
+                         { interact(c, sourceIndex); });
+        }
+        else
+        {
+            for (std::uint32_t c = source.firstChild; c < source.firstChild + source.childCount; c++)
+            {
+                interact(targetIndex, c);
+            }
+        }
+    };
+
+    // Downward pass: L2L towards the leaves, L2P at the leaves
+    std::function<void(std::uint32_t)> downward = [&](std::uint32_t index)
+    {
+        const FastMultipoleCell &cell = cells[index];
+        if (cell.childCount == 0)
+        {
+            for (std::uint32_t i = cell.begin; i < cell.end; i++)
+            {
+                const double d[3] = {sx[i] - cell.center[0], sy[i] - cell.center[1], sz[i] - cell.center[2]};
+                for (int kind = 0; kind < kinds; kind++)
+                {
+                    double e[3] = {0.0, 0.0, 0.0};
+                    translate.l2p(d, local(index, kind), e, potential[kind * n + i]);
+                    fieldX[kind * n + i] += e[0];
+                    fieldY[kind * n + i] += e[1];
+                    fieldZ[kind * n + i] += e[2];
+                }
+            }
+            return;
+        }
+        for (std::uint32_t c = cell.firstChild; c < cell.firstChild + cell.childCount; c++)
+        {
+            const double d[3] = {cells[c].center[0] - cell.center[0], cells[c].center[1] - cell.center[1], cells[c].center[2] - cell.center[2]};
+            for (int kind = 0; kind < kinds; kind++)
+            {
+                translate.l2l(d, local(index, kind), local(c, kind));
+            }
+        }
+        forEachChild(cell, downward);
+    };
+
+    // The root has no far field, so every pass can start at its children
+    if (root.childCount == 0)
+    {
+        upward(0);
+        interact(0, 0);
+        downward(0);
+    }
+    else
+    {
+        forEachChild(root, upward);
+        forEachChild(root, [&](std::uint32_t c)
+                     { interact(c, 0); });
+        forEachChild(root, downward);
+    }
+
+    // a = (k q E_q - G m E_m) / m, U = sum of (k q phi_q - G m phi_m) / 2 in sorted order
+    const double k = parameters.coulombConstant;
+    const double g = parameters.gravitationalConstant;
+    Vector3Array &accelerations = system.getAccelerations();
+    CompensatedSum<double> energy;
+    for (std::size_t t = 0; t < n; t++)
+    {
+        const std::uint32_t i = order[t];
+        const double mass = sm[t];
+        const double invMass = mass != 0.0 ? 1.0 / mass : 0.0;
+        const double kq = k * sq[t];
+        const double gm = Gravity ? g * mass : 0.0;
+        const std::size_t tm = Gravity ? n + t : t;
+        accelerations.x[i] = static_cast<Real>((kq * fieldX[t] - gm * fieldX[tm]) * invMass);
+        accelerations.y[i] = static_cast<Real>((kq * fieldY[t] - gm * fieldY[tm]) * invMass);
+        accelerations.z[i] = static_cast<Real>((kq * fieldZ[t] - gm * fieldZ[tm]) * invMass);
+        energy += 0.5 * (kq * potential[t] - (Gravity ? gm * potential[tm] : 0.0));
+    }
+    potentialEnergy = energy.value();
+}
+
+void FastMultipoleForce::computeAccelerations(ParticleSystem &system)
+{
+    build(system);
+    if (cells.empty())
+    {
+        potentialEnergy = 0.0;
+        return;
+    }
+    if (parameters.gravitationalConstant != 0.0)
+    {
+        evaluate<true>(system);
+    }
+    else
+    {
+        evaluate<false>(system);
+    }
+}
@@ -0,0 +1,112 @@
+#include "ForceAccumulation.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include "VectorKernels.h"
+
+ForceAccumulation forceAccumulationFromName(const std::string &name)
+{
+    if (name == "serial")
+        return ForceAccumulation::Serial;
+    if (name == "buffers")
+        return ForceAccumulation::ThreadBuffers;
+    if (name == "coloring")
+        return ForceAccumulation::Coloring;
+    if (name == "deterministic")
+        return ForceAccumulation::Deterministic;
+    throw std::invalid_argument("Unknown force accumulation: " + name);
+}
+
+const char *forceAccumulationName(ForceAccumulation accumulation)
+{
+    switch (accumulation)
+    {
+    case ForceAccumulation::Serial:
+        return "serial";
+    case ForceAccumulation::ThreadBuffers:
+        return "buffers";
+    case ForceAccumulation::Coloring:
+        return "coloring";
+    case ForceAccumulation::Deterministic:
+        return "deterministic";
+    }
+    throw std::invalid_argument("Unknown force accumulation.");
+}
+
+void ForceBufferPool::begin(std::size_t n)
+{
+    if (n != size)
+    {
+        size = n;
+        for (std::unique_ptr<ForceArray> &buffer : buffers)
+        {
+            buffer->resize(0);
+            buffer->resize(n);
+        }
+    }
+    else
+    {
+        // An earlier pass threw before reduceInto(): drop its partial sums
+        for (ForceArray *buffer : usedBuffers)
+        {
+            std::fill(buffer->x.begin(), buffer->x.end(), AccumReal(0));
+            std::fill(buffer->y.begin(), buffer->y.end(), AccumReal(0));
+            std::fill(buffer->z.begin(), buffer->z.end(), AccumReal(0));
+        }
+    }
+    usedBuffers.clear();
+
+    // Buffers a throwing task never released are free again
+    freeBuffers.clear();
+    for (std::unique_ptr<ForceArray> &buffer : buffers)
+    {
+        freeBuffers.push_back(buffer.get());
+    }
+}
+
+ForceArray &ForceBufferPool::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ForceArray *buffer;
+    if (freeBuffers.empty())
+    {
+        buffers.push_back(std::make_unique<ForceArray>());
+        buffer = buffers.back().get();
+        buffer->resize(size);
+    }
+    else
+    {
+        buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+    }
+    if (std::find(usedBuffers.begin(), usedBuffers.end(), buffer) == usedBuffers.end())
+    {
+        usedBuffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void ForceBufferPool::release(ForceArray &buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.push_back(&buffer);
+}
+
+void ForceBufferPool::reduceInto(ForceArray &forces, ThreadPool &pool)
+{
+    // Chunks of particles across threads, all buffers within a chunk, so
+    // every thread streams through its slice of each buffer once
+    pool.parallelFor(0, size, [&](std::size_t begin, std::size_t end)
+                     {
+                         const std::size_t count = end - begin;
+                         BasicVector3Span<AccumReal> sum = makeSpan(forces).subspan(begin, count);
+                         for (ForceArray *buffer : usedBuffers)
+                         {
+                             VectorKernels::add(sum, makeSpan(*buffer).subspan(begin, count), sum);
+                             std::fill(buffer->x.begin() + begin, buffer->x.begin() + end, AccumReal(0));
+                             std::fill(buffer->y.begin() + begin, buffer->y.begin() + end, AccumReal(0));
+                             std::fill(buffer->z.begin() + begin, buffer->z.begin() + end, AccumReal(0));
+                         } },
+                     4096);
+    usedBuffers.clear();
+}
@@ -0,0 +1,107 @@
+#include "ForcePartition.h"
+
+#include <stdexcept>
+#include "ThreadPool.h"
+#include "VectorKernels.h"
+
+namespace
+{
+    // Smallest chunk of particles worth handing to another thread
+    const std::size_t PARALLEL_GRAIN = 32768;
+}
+
+void ForcePartition::add(ForceModel &model, ForceGroup group)
+{
+    if (&model == this)
+    {
+        throw std::invalid_argument("A force partition cannot contain itself.");
+    }
+    for (const Member &member : members)
+    {
+        if (member.model == &model)
+        {
+            throw std::invalid_argument("Force model is already part of the partition.");
+        }
+    }
+    members.push_back({&model, group});
+}
+
+// Every member overwrites the accelerations, so the running sum is kept
+// aside while the next member is evaluated
+template <typename Selected>
+void ForcePartition::accumulate(ParticleSystem &system, const Selected &selected)
+{
+    Vector3Array &accelerations = system.getAccelerations();
+    bool first = true;
+    for (const Member &member : members)
+    {
+        if (!selected(member.group))
+        {
+            continue;
+        }
+        if (first)
+        {
+            member.model->computeAccelerations(system);
+            first = false;
+            continue;
+        }
+        partialSum = accelerations;
+        member.model->computeAccelerations(system);
+        ThreadPool::global().parallelFor(0, accelerations.size(), [&](std::size_t begin, std::size_t end)
+                                         { VectorKernels::axpy(Real(1), ConstVector3Span(makeSpan(partialSum)).subspan(begin, end - begin),
+                                                               makeSpan(accelerations).subspan(begin, end - begin)); },
+                                         PARALLEL_GRAIN);
+    }
+    if (first)
+    {
+        accelerations.fill(Vector3());
+    }
+}
+
+void ForcePartition::computeAccelerations(ParticleSystem &system)
+{
+    accumulate(system, [](ForceGroup)
+               { return true; });
+}
+
+void ForcePartition::computeGroupAccelerations(ParticleSystem &system, ForceGroup group)
+{
+    accumulate(system, [group](ForceGroup g)
+               { return g == group; });
+}
+
+// Energies
+double ForcePartition::getPotentialEnergy() const
+{
+    double energy = 0.0;
+    for (const Member &member : members)
+    {
+        energy += member.model->getPotentialEnergy();
+    }
+    return energy;
+}
+
+double ForcePartition::getGroupPotentialEnergy(ForceGroup group) const
+{
+    double energy = 0.0;
+    for (const Member &member : members)
+    {
+        if (member.group == group)
+        {
+            energy += member.model->getPotentialEnergy();
+        }
+    }
+    return energy;
+}
+
+bool ForcePartition::hasGroup(ForceGroup group) const
+{
+    for (const Member &member : members)
+    {
+        if (member.group == group)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,539 @@
+#include "Integrator.h"
+
+#include <cmath>
+#include <stdexcept>
+#include "ThreadPool.h"
+#include "VectorKernels.h"
+
+namespace
+{
+    // Smallest chunk of particles worth handing to another thread
+    const std::size_t PARALLEL_GRAIN = 32768;
+
+    // y += alpha * x, split across the thread pool for large systems
+    void axpy(Real alpha, ConstVector3Span x, Vector3Span y)
+    {
+        ThreadPool::global().parallelFor(0, y.size, [&](std::size_t begin, std::size_t end)
+                                         { VectorKernels::axpy(alpha, x.subspan(begin, end - begin), y.subspan(begin, end - begin)); },
+                                         PARALLEL_GRAIN);
+    }
+
+    // Particles per block of a measured update, small enough that the
+    // block is still in cache when its moments are taken
+    const std::size_t MONITOR_BLOCK = 2048;
+
+    // x += v * h. Mixed-precision builds carry the rounding error of every
+    // update in the system's compensation array (Kahan), so positions do not
+    // stall when v * h falls below half an ulp of x.
+    class Drift
+    {
+    public:
+        Drift(ParticleSystem &system, double h)
+            : positions(system.getPositions()), velocities(system.getVelocities()),
+              compensation(MIXED_PRECISION ? &system.getPositionCompensation() : nullptr), h(h)
+        {
+        }
+
+        void operator()(std::size_t begin, std::size_t end) const
+        {
+            if (!compensation)
+            {
+                VectorKernels::axpy(static_cast<Real>(h), ConstVector3Span(makeSpan(velocities)).subspan(begin, end - begin),
+                                    makeSpan(positions).subspan(begin, end - begin));
+                return;
+            }
+            const AlignedVector<Real> *v[3] = {&velocities.x, &velocities.y, &velocities.z};
+            AlignedVector<Real> *x[3] = {&positions.x, &positions.y, &positions.z};
+            AlignedVector<Real> *c[3] = {&compensation->x, &compensation->y, &compensation->z};
+            for (int a = 0; a < 3; a++)
+            {
+                const Real *__restrict va = v[a]->data();
+                Real *__restrict xa = x[a]->data();
+                Real *__restrict ca = c[a]->data();
+                for (std::size_t i = begin; i < end; i++)
+                {
+                    const Real step = static_cast<Real>(va[i] * h) - ca[i];
+                    const Real sum = xa[i] + step;
+                    ca[i] = (sum - xa[i]) - step;
+                    xa[i] = sum;
+                }
+            }
+        }
+
+    private:
+        Vector3Array &positions;
+        const Vector3Array &velocities;
+        Vector3Array *compensation;
+        double h;
+    };
+
+    // v += a * h
+    class Kick
+    {
+    public:
+        Kick(ParticleSystem &system, double h) : velocities(system.getVelocities()), accelerations(system.getAccelerations()), h(h) {}
+
+        void operator()(std::size_t begin, std::size_t end) const
+        {
+            VectorKernels::axpy(static_cast<Real>(h), ConstVector3Span(makeSpan(accelerations)).subspan(begin, end - begin),
+                                makeSpan(velocities).subspan(begin, end - begin));
+        }
+
+    private:
+        Vector3Array &velocities;
+        const Vector3Array &accelerations;
+        double h;
+    };
+
+    void drift(ParticleSystem &system, double h)
+    {
+        ThreadPool::global().parallelFor(0, system.size(), Drift(system, h), PARALLEL_GRAIN);
+    }
+
+    void kick(ParticleSystem &system, double h)
+    {
+        ThreadPool::global().parallelFor(0, system.size(), Kick(system, h), PARALLEL_GRAIN);
+    }
+
+    // When a monitored pass takes the moments of a block
+    enum class Measure
+    {
+        Before, // state the last force evaluation saw, the pass then moves on from it
+        After   // state the pass produces, synchronous with the last force evaluation
+    };
+
+    // Update pass that also feeds the monitor: every block is measured right
+    // before or after `update` touches it, while it is in cache, and the
+    // step is recorded. `kick` is the pending kick the Before moments are
+    // centered on (see ParticleMoments::measure()).
+    template <typename Update>
+    void monitoredPass(ParticleSystem &system, const ForceModel &forces, ConservationMonitor *monitor, double deltaTime,
+                       const Update &update, Measure measure, double kick = 0.0)
+    {
+        ThreadPool &pool = ThreadPool::global();
+        if (!monitor)
+        {
+            pool.parallelFor(0, system.size(), update, PARALLEL_GRAIN);
+            return;
+        }
+        const ParticleMoments moments = pool.orderedReduce(0, system.size(), MONITOR_BLOCK, ParticleMoments(), [&](std::size_t begin, std::size_t end)
+                                                           {
+                                                               if (measure == Measure::After)
+                                                               {
+                                                                   update(begin, end);
+                                                                   return ParticleMoments::measure(system, begin, end);
+                                                               }
+                                                               const ParticleMoments block = ParticleMoments::measure(system, begin, end, kick);
+                                                               update(begin, end);
+                                                               return block; });
+        monitor->record(system, moments, forces.getPotentialEnergy(), deltaTime);
+    }
+}
+
+// Explicit Euler
+void EulerIntegrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    forces.computeAccelerations(system);
+    const Drift driftStep(system, deltaTime);
+    const Kick kickStep(system, deltaTime);
+    monitoredPass(
+        system, forces, monitor, deltaTime, [&](std::size_t begin, std::size_t end)
+        {
+            driftStep(begin, end);
+            kickStep(begin, end); },
+        Measure::Before);
+}
+
+// Velocity Verlet (kick-drift-kick), reuses a(t) from the previous step
+void VelocityVerletIntegrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    if (!primed)
+    {
+        forces.computeAccelerations(system);
+        primed = true;
+    }
+    kick(system, 0.5 * deltaTime);
+    drift(system, deltaTime);
+    forces.computeAccelerations(system);
+    monitoredPass(system, forces, monitor, deltaTime, Kick(system, 0.5 * deltaTime), Measure::After);
+}
+
+// Leapfrog (drift-kick-drift)
+void LeapfrogIntegrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    drift(system, 0.5 * deltaTime);
+    forces.computeAccelerations(system);
+    monitoredPass(system, forces, monitor, deltaTime, Kick(system, deltaTime), Measure::Before, deltaTime);
+    drift(system, 0.5 * deltaTime);
+}
+
+// Yoshida 4th order: triple-jump composition of leapfrog
+void Yoshida4Integrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    static const double cbrt2 = std::cbrt(2.0);
+    static const double w1 = 1.0 / (2.0 - cbrt2);
+    static const double w0 = -cbrt2 / (2.0 - cbrt2);
+    static const double c[4] = {0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1};
+    static const double d[3] = {w1, w0, w1};
+
+    for (int i = 0; i < 3; i++)
+    {
+        drift(system, c[i] * deltaTime);
+        forces.computeAccelerations(system);
+        if (i < 2)
+        {
+            kick(system, d[i] * deltaTime);
+        }
+    }
+    monitoredPass(system, forces, monitor, deltaTime, Kick(system, d[2] * deltaTime), Measure::Before, d[2] * deltaTime);
+    drift(system, c[3] * deltaTime);
+}
+
+// Classic 4th order Runge-Kutta
+void RK4Integrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    Vector3Array &positions = system.getPositions();
+    Vector3Array &velocities = system.getVelocities();
+    const Real dt = static_cast<Real>(deltaTime);
+    const Real halfDt = static_cast<Real>(0.5 * deltaTime);
+
+    startPositions = positions;
+    startVelocities = velocities;
+
+    // k1
+    forces.computeAccelerations(system);
+    positionSlope = velocities;
+    velocitySlope = system.getAccelerations();
+
+    // k2, k3 at the half step, k4 at the full step
+    const Real stageStep[3] = {halfDt, halfDt, dt};
+    const Real stageWeight[3] = {2, 2, 1};
+    for (int stage = 0; stage < 3; stage++)
+    {
+        // Move to the trial point using the previous stage's slopes
+        positions = startPositions;
+        axpy(stageStep[stage], makeSpan(velocities), makeSpan(positions));
+        velocities = startVelocities;
+        axpy(stageStep[stage], makeSpan(system.getAccelerations()), makeSpan(velocities));
+
+        forces.computeAccelerations(system);
+        axpy(stageWeight[stage], makeSpan(velocities), makeSpan(positionSlope));
+        axpy(stageWeight[stage], makeSpan(system.getAccelerations()), makeSpan(velocitySlope));
+    }
+
+    positions = startPositions;
+    velocities = startVelocities;
+    monitoredPass(
+        system, forces, monitor, deltaTime, [&](std::size_t begin, std::size_t end)
+        {
+            VectorKernels::axpy(dt / 6, ConstVector3Span(makeSpan(positionSlope)).subspan(begin, end - begin), makeSpan(positions).subspan(begin, end - begin));
+            VectorKernels::axpy(dt / 6, ConstVector3Span(makeSpan(velocitySlope)).subspan(begin, end - begin), makeSpan(velocities).subspan(begin, end - begin)); },
+        Measure::After);
+}
+
+// Block time steps
+BlockTimeStepIntegrator::BlockTimeStepIntegrator(const BlockTimeStepParameters &parameters)
+{
+    setParameters(parameters);
+}
+
+void BlockTimeStepIntegrator::setParameters(const BlockTimeStepParameters &p)
+{
+    if (p.maxLevel < 0 || p.maxLevel > 30)
+    {
+        throw std::invalid_argument("Block time step levels must be in [0, 30].");
+    }
+    if (!(p.accuracy > 0.0) || !(p.courant > 0.0) || !(p.lengthScale > 0.0))
+    {
+        throw std::invalid_argument("Block time step criteria must be positive.");
+    }
+    parameters = p;
+    primed = false;
+}
+
+std::uint8_t BlockTimeStepIntegrator::selectLevel(const ParticleSystem &system, std::size_t index, double deltaTime, std::uint32_t tick)
+{
+    const Vector3Array &a = system.getAccelerations();
+    const Vector3Array &v = system.getVelocities();
+    const double a2 = static_cast<double>(a.x[index]) * a.x[index] + static_cast<double>(a.y[index]) * a.y[index] + static_cast<double>(a.z[index]) * a.z[index];
+    const double v2 = static_cast<double>(v.x[index]) * v.x[index] + static_cast<double>(v.y[index]) * v.y[index] + static_cast<double>(v.z[index]) * v.z[index];
+    double dt = deltaTime;
+    if (a2 > 0.0)
+    {
+        dt = std::min(dt, std::sqrt(2.0 * parameters.accuracy * parameters.lengthScale / std::sqrt(a2)));
+    }
+    if (v2 > 0.0)
+    {
+        dt = std::min(dt, parameters.courant * parameters.lengthScale / std::sqrt(v2));
+    }
+
+    // Finest level first satisfied, then finer until the step starts on the current tick
+    int level = 0;
+    while (level < parameters.maxLevel && std::ldexp(deltaTime, -level) > dt)
+    {
+        level++;
+    }
+    if (std::ldexp(deltaTime, -level) > dt)
+    {
+        clampedSelections++;
+    }
+    while (level < parameters.maxLevel && tick % (1u << (parameters.maxLevel - level)) != 0)
+    {
+        level++;
+    }
+    deepestLevel = std::max(deepestLevel, level);
+    return static_cast<std::uint8_t>(level);
+}
+
+// Kick-drift-kick over the ticks of the finest level; only ticks at which
+// some particle's step ends are visited
+void BlockTimeStepIntegrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    const std::size_t n = system.size();
+    const int maxLevel = parameters.maxLevel;
+    const std::uint32_t ticks = 1u << maxLevel;
+    const double tickTime = deltaTime / ticks;
+    ThreadPool &pool = ThreadPool::global();
+
+    lastForceCalls = 0;
+    activeEvaluations = 0;
+    deepestLevel = 0;
+    clampedSelections = 0;
+    if (!primed)
+    {
+        forces.computeAccelerations(system);
+        lastForceCalls++;
+        activeEvaluations += n;
+        primed = true;
+    }
+
+    // Every particle starts a step at tick 0: choose levels, opening half kicks
+    levels.resize(n);
+    levelCounts.assign(maxLevel + 1, 0);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        levels[i] = selectLevel(system, i, deltaTime, 0);
+        levelCounts[levels[i]]++;
+    }
+    Vector3Array &velocities = system.getVelocities();
+    const Vector3Array &accelerations = system.getAccelerations();
+    auto halfStep = [&](int level)
+    { return static_cast<Real>(0.5 * std::ldexp(deltaTime, -level)); };
+    pool.parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                     {
+                         for (std::size_t i = begin; i < end; i++)
+                         {
+                             const Real h = halfStep(levels[i]);
+                             velocities.x[i] += accelerations.x[i] * h;
+                             velocities.y[i] += accelerations.y[i] * h;
+                             velocities.z[i] += accelerations.z[i] * h;
+                         } },
+                     PARALLEL_GRAIN);
+
+    std::uint32_t tick = 0;
+    while (tick < ticks)
+    {
+        // Next tick at which the step of some occupied level ends
+        std::uint32_t next = ticks;
+        for (int level = 0; level <= maxLevel; level++)
+        {
+            if (levelCounts[level] > 0)
+            {
+                const std::uint32_t stride = 1u << (maxLevel - level);
+                next = std::min(next, (tick / stride + 1) * stride);
+            }
+        }
+        drift(system, (next - tick) * tickTime);
+        tick = next;
+
+        if (tick == ticks)
+        {
+            // Everyone ends here: full evaluation, closing kicks synchronize all velocities
+            forces.computeAccelerations(system);
+            lastForceCalls++;
+            activeEvaluations += n;
+            monitoredPass(
+                system, forces, monitor, deltaTime, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; i++)
+                    {
+                        const Real h = halfStep(levels[i]);
+                        velocities.x[i] += accelerations.x[i] * h;
+                        velocities.y[i] += accelerations.y[i] * h;
+                        velocities.z[i] += accelerations.z[i] * h;
+                    } },
+                Measure::After);
+            break;
+        }
+
+        active.clear();
+        for (std::size_t i = 0; i < n; i++)
+        {
+            if (tick % (1u << (maxLevel - levels[i])) == 0)
+            {
+                active.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        forces.computeActiveAccelerations(system, active);
+        lastForceCalls++;
+        activeEvaluations += active.size();
+
+        // Closing half kick of the ended step, new level, opening half kick of the next one
+        for (std::uint32_t i : active)
+        {
+            const Real closing = halfStep(levels[i]);
+            levelCounts[levels[i]]--;
+            levels[i] = selectLevel(system, i, deltaTime, tick);
+            levelCounts[levels[i]]++;
+            const Real h = closing + halfStep(levels[i]);
+            velocities.x[i] += accelerations.x[i] * h;
+            velocities.y[i] += accelerations.y[i] * h;
+            velocities.z[i] += accelerations.z[i] * h;
+        }
+    }
+}
+
+// r-RESPA
+RespaIntegrator::RespaIntegrator(const RespaParameters &parameters)
+{
+    setParameters(parameters);
+}
+
+void RespaIntegrator::setParameters(const RespaParameters &p)
+{
+    if (p.innerSteps < 1)
+    {
+        throw std::invalid_argument("RESPA needs at least one inner step.");
+    }
+    parameters = p;
+    primed = false;
+}
+
+// Slow half kick, k fast velocity Verlet steps, slow half kick. Within the
+// inner loop the system's accelerations are the fast ones; the closing and
+// opening fast half kicks of consecutive inner steps are fused.
+void RespaIntegrator::step(ParticleSystem &system, ForceModel &forces, double deltaTime)
+{
+    system.maintainLocality();
+    ForcePartition *partition = dynamic_cast<ForcePartition *>(&forces);
+    auto evaluate = [&](ForceGroup group)
+    {
+        if (partition)
+        {
+            partition->computeGroupAccelerations(system, group);
+        }
+        else if (group == ForceGroup::Fast)
+        {
+            forces.computeAccelerations(system);
+        }
+        else
+        {
+            system.getAccelerations().fill(Vector3());
+        }
+    };
+
+    Vector3Array &velocities = system.getVelocities();
+    Vector3Array &accelerations = system.getAccelerations();
+    const std::size_t n = system.size();
+    if (!primed || layoutVersion != system.getLayoutVersion() || slowAccelerations.size() != n)
+    {
+        evaluate(ForceGroup::Fast);
+        fastAccelerations = accelerations;
+        evaluate(ForceGroup::Slow);
+        slowAccelerations = accelerations;
+        primed = true;
+    }
+
+    // v += a_fast * fastKick + a_slow * slowKick; with `sum`, also a = a_fast + a_slow
+    auto splitKick = [&](double fastKick, double slowKick, bool sum)
+    {
+        const Real hf = static_cast<Real>(fastKick);
+        const Real hs = static_cast<Real>(slowKick);
+        return [&, hf, hs, sum](std::size_t begin, std::size_t end)
+        {
+            const Vector3Array &f = fastAccelerations;
+            const Vector3Array &s = slowAccelerations;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                velocities.x[i] += f.x[i] * hf + s.x[i] * hs;
+                velocities.y[i] += f.y[i] * hf + s.y[i] * hs;
+                velocities.z[i] += f.z[i] * hf + s.z[i] * hs;
+            }
+            if (sum)
+            {
+                for (std::size_t i = begin; i < end; i++)
+                {
+                    accelerations.x[i] = f.x[i] + s.x[i];
+                    accelerations.y[i] = f.y[i] + s.y[i];
+                    accelerations.z[i] = f.z[i] + s.z[i];
+                }
+            }
+        };
+    };
+
+    const int k = parameters.innerSteps;
+    const double innerStep = deltaTime / k;
+    ThreadPool::global().parallelFor(0, n, splitKick(0.5 * innerStep, 0.5 * deltaTime, false), PARALLEL_GRAIN);
+    for (int s = 0; s < k; s++)
+    {
+        if (s > 0)
+        {
+            kick(system, innerStep);
+        }
+        drift(system, innerStep);
+        evaluate(ForceGroup::Fast);
+    }
+    fastAccelerations = accelerations;
+    evaluate(ForceGroup::Slow);
+    slowAccelerations = accelerations;
+    monitoredPass(system, forces, monitor, deltaTime, splitKick(0.5 * innerStep, 0.5 * deltaTime, true), Measure::After);
+    layoutVersion = system.getLayoutVersion();
+}
+
+// Factory
+std::unique_ptr<Integrator> makeIntegrator(IntegratorType type)
+{
+    switch (type)
+    {
+    case IntegratorType::Euler:
+        return std::make_unique<EulerIntegrator>();
+    case IntegratorType::VelocityVerlet:
+        return std::make_unique<VelocityVerletIntegrator>();
+    case IntegratorType::Leapfrog:
+        return std::make_unique<LeapfrogIntegrator>();
+    case IntegratorType::Yoshida4:
+        return std::make_unique<Yoshida4Integrator>();
+    case IntegratorType::RK4:
+        return std::make_unique<RK4Integrator>();
+    case IntegratorType::BlockTimeStep:
+        return std::make_unique<BlockTimeStepIntegrator>();
+    case IntegratorType::Respa:
+        return std::make_unique<RespaIntegrator>();
+    }
+    throw std::invalid_argument("Unknown integrator type.");
+}
+
+IntegratorType integratorTypeFromName(const std::string &name)
+{
+    if (name == "euler")
+        return IntegratorType::Euler;
+    if (name == "verlet")
+        return IntegratorType::VelocityVerlet;
+    if (name == "leapfrog")
+        return IntegratorType::Leapfrog;
+    if (name == "yoshida4")
+        return IntegratorType::Yoshida4;
+    if (name == "rk4")
+        return IntegratorType::RK4;
+    if (name == "block")
+        return IntegratorType::BlockTimeStep;
+    if (name == "respa")
+        return IntegratorType::Respa;
+    throw std::invalid_argument("Unknown integrator: " + name);
+}
@@ -0,0 +1,57 @@
+#include "MortonOrder.h"
+
+#include <algorithm>
+#include <limits>
+#include "Morton.h"
+#include "RadixSort.h"
+
+namespace
+{
+    const std::size_t PARALLEL_GRAIN = 16384;
+}
+
+MortonCube mortonOrder(const ParticleSystem &system, std::vector<std::uint64_t> &keys, std::vector<std::uint32_t> &order, ThreadPool &pool)
+{
+    const std::size_t n = system.size();
+    const Vector3Array &positions = system.getPositions();
+
+    // Bounding cube
+    double lo[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double hi[3] = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const double p[3] = {positions.x[i], positions.y[i], positions.z[i]};
+        for (int a = 0; a < 3; a++)
+        {
+            lo[a] = std::min(lo[a], p[a]);
+            hi[a] = std::max(hi[a], p[a]);
+        }
+    }
+    MortonCube cube = {};
+    double extent = 0.0;
+    for (int a = 0; a < 3; a++)
+    {
+        cube.center[a] = 0.5 * (lo[a] + hi[a]);
+        extent = std::max(extent, hi[a] - lo[a]);
+    }
+    cube.halfSize = 0.5 * extent * (1.0 + 1e-9) + std::numeric_limits<double>::min();
+
+    // Morton keys relative to the cube
+    keys.resize(n);
+    order.resize(n);
+    const double corner[3] = {cube.center[0] - cube.halfSize, cube.center[1] - cube.halfSize, cube.center[2] - cube.halfSize};
+    const double invSize = 1.0 / (2.0 * cube.halfSize);
+    pool.parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                     {
+                         for (std::size_t i = begin; i < end; i++)
+                         {
+                             const std::uint32_t ix = Morton::quantize((positions.x[i] - corner[0]) * invSize);
+                             const std::uint32_t iy = Morton::quantize((positions.y[i] - corner[1]) * invSize);
+                             const std::uint32_t iz = Morton::quantize((positions.z[i] - corner[2]) * invSize);
+                             keys[i] = Morton::encode(ix, iy, iz);
+                             order[i] = static_cast<std::uint32_t>(i);
+                         } },
+                     PARALLEL_GRAIN);
+    radixSort(keys, order, pool);
+    return cube;
+}
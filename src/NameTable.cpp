@@ -0,0 +1,64 @@
+#include "NameTable.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    struct Table
+    {
+        std::shared_mutex mutex;
+        std::deque<std::string> names{std::string()}; // deque: elements never move, so lookup() may hand out references
+        std::unordered_map<std::string_view, NameId> ids{{std::string_view(), NameTable::EMPTY}};
+    };
+
+    Table &table()
+    {
+        static Table instance;
+        return instance;
+    }
+}
+
+NameId NameTable::intern(std::string_view name)
+{
+    Table &t = table();
+    {
+        std::shared_lock<std::shared_mutex> lock(t.mutex);
+        auto it = t.ids.find(name);
+        if (it != t.ids.end())
+        {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(t.mutex);
+    auto it = t.ids.find(name);
+    if (it != t.ids.end())
+    {
+        return it->second; // interned by another thread in the meantime
+    }
+    const NameId id = static_cast<NameId>(t.names.size());
+    t.names.emplace_back(name);
+    t.ids.emplace(t.names.back(), id);
+    return id;
+}
+
+const std::string &NameTable::lookup(NameId id)
+{
+    Table &t = table();
+    std::shared_lock<std::shared_mutex> lock(t.mutex);
+    if (id >= t.names.size())
+    {
+        throw std::invalid_argument("Unknown name id " + std::to_string(id) + ".");
+    }
+    return t.names[id];
+}
+
+std::size_t NameTable::size()
+{
+    Table &t = table();
+    std::shared_lock<std::shared_mutex> lock(t.mutex);
+    return t.names.size();
+}
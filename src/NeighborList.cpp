@@ -0,0 +1,104 @@
+#include "NeighborList.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Constructor
+NeighborList::NeighborList(double cutoff, double skin) : cutoff(cutoff), skin(skin), grid(cutoff + skin)
+{
+    setCutoff(cutoff);
+    setSkin(skin);
+}
+
+void NeighborList::setCutoff(double c)
+{
+    if (!(c > 0.0))
+    {
+        throw std::invalid_argument("Cutoff must be positive.");
+    }
+    cutoff = c;
+    valid = false;
+}
+
+void NeighborList::setSkin(double s)
+{
+    if (!(s >= 0.0))
+    {
+        throw std::invalid_argument("Skin must not be negative.");
+    }
+    skin = s;
+    valid = false;
+}
+
+double NeighborList::maxDisplacement(const ParticleSystem &system) const
+{
+    const Vector3Array &positions = system.getPositions();
+    const bool periodic = domain.isPeriodic();
+    double max2 = 0.0;
+    for (std::size_t i = 0; i < system.size(); i++)
+    {
+        double d[3] = {positions.x[i] - referenceX[i], positions.y[i] - referenceY[i], positions.z[i] - referenceZ[i]};
+        if (periodic)
+        {
+            domain.minimumImage(d);
+        }
+        max2 = std::max(max2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    return std::sqrt(max2);
+}
+
+bool NeighborList::update(const ParticleSystem &system, const Domain &d)
+{
+    statistics.updates++;
+    if (valid && system.size() + 1 == offsets.size() && system.getLayoutVersion() == layoutVersion)
+    {
+        statistics.maxDisplacement = maxDisplacement(system);
+        if (2.0 * statistics.maxDisplacement <= skin)
+        {
+            return false;
+        }
+    }
+    build(system, d);
+    return true;
+}
+
+void NeighborList::build(const ParticleSystem &system, const Domain &d)
+{
+    domain = d;
+    layoutVersion = system.getLayoutVersion();
+    const std::size_t n = system.size();
+
+    // Candidate pairs from the cell grid, then a counting sort by first particle
+    grid.setCutoff(cutoff + skin);
+    grid.build(system, domain);
+    pairs.clear();
+    grid.forEachPair([this](std::uint32_t i, std::uint32_t j, double, double, double, double)
+                     { pairs.push_back({i, j}); });
+
+    offsets.assign(n + 1, 0);
+    for (const auto &pair : pairs)
+    {
+        offsets[pair.first + 1]++;
+    }
+    for (std::size_t i = 0; i < n; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    neighbors.resize(pairs.size());
+    cursor.assign(offsets.begin(), offsets.end() - 1);
+    for (const auto &pair : pairs)
+    {
+        neighbors[cursor[pair.first]++] = pair.second;
+    }
+
+    const Vector3Array &positions = system.getPositions();
+    referenceX.assign(positions.x.begin(), positions.x.end());
+    referenceY.assign(positions.y.begin(), positions.y.end());
+    referenceZ.assign(positions.z.begin(), positions.z.end());
+
+    valid = true;
+    statistics.builds++;
+    statistics.pairs = pairs.size();
+    statistics.maxDisplacement = 0.0;
+}
@@ -0,0 +1,524 @@
+#include "PairPotentialForce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include "CompensatedSum.h"
+#include "SimdPragmas.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // Energy U of one pair. Energy and force are separate scalar functions
+    // (the compiler merges their common terms) because anything returned
+    // through a reference or struct keeps the SIMD loop from vectorizing.
+    template <PairPotentialForm Form>
+    inline double pairEnergy(double r2, double a, double b, double c)
+    {
+        const double inv6 = 1.0 / (r2 * r2 * r2);
+        if (Form == PairPotentialForm::LennardJones)
+        {
+            return (a * inv6 - b) * inv6;
+        }
+        return a * std::exp(-b * std::sqrt(r2)) - c * inv6;
+    }
+
+    // Force magnitude over distance, F / r = -U'(r) / r, of one pair
+    template <PairPotentialForm Form>
+    inline double pairForceOverR(double r2, double a, double b, double c)
+    {
+        const double inv2 = 1.0 / r2;
+        const double inv6 = inv2 * inv2 * inv2;
+        if (Form == PairPotentialForm::LennardJones)
+        {
+            return (12.0 * a * inv6 - 6.0 * b) * inv6 * inv2;
+        }
+        const double r = std::sqrt(r2);
+        return a * std::exp(-b * r) * b / r - 6.0 * c * inv6 * inv2;
+    }
+
+    // Arithmetic type of the pair kernel: double unless the mixed-precision
+    // build asks for float SIMD width (the row sums are still added up in
+    // AccumReal)
+    using KernelReal = std::conditional<MIXED_PRECISION, Real, double>::type;
+
+    // Particles below which the force loop stays on the calling thread, and
+    // rows per task of the buffered strategy
+    const std::size_t PARALLEL_THRESHOLD = 4096;
+    const std::size_t ROW_GRAIN = 256;
+
+    // Cells per block of the deterministic energy sum
+    const std::size_t ENERGY_BLOCK = 1024;
+
+    // Raw views and constants the row kernel reads
+    struct PairKernelData
+    {
+        const Real *x;
+        const Real *y;
+        const Real *z;
+        const std::uint16_t *species;
+        const std::uint32_t *offsets;
+        const std::uint32_t *list;
+        const double *a;
+        const double *b;
+        const double *c;
+        const double *energyShift;
+        const double *forceShift;
+        std::size_t speciesCount;
+        double rc, rc2, rs2, switchingScale;
+        double period[3];        // zero on open axes
+        double inversePeriod[3]; // zero on open axes
+    };
+
+    // Packed neighbor data of one row, see accumulateRow()
+    struct NeighborBatch
+    {
+        AlignedVector<KernelReal> dx, dy, dz;
+        AlignedVector<KernelReal> a, b, c, energyShift, forceShift;
+        AlignedVector<KernelReal> forceOverR;
+
+        void reserve(std::size_t n)
+        {
+            if (n <= dx.size())
+            {
+                return;
+            }
+            for (AlignedVector<KernelReal> *v : {&dx, &dy, &dz, &a, &b, &c, &energyShift, &forceShift, &forceOverR})
+            {
+                v->resize(n);
+            }
+        }
+    };
+
+    // Scratch batch of the calling thread
+    NeighborBatch &scratchBatch()
+    {
+        thread_local NeighborBatch batch;
+        return batch;
+    }
+
+    // Forces between particle i and its listed partners, added to both ends
+    // in `forces`; returns their potential energy.
+    //
+    // The partners' displacements and pair coefficients are first gathered
+    // into contiguous buffers, so the potential itself is evaluated in a
+    // loop that vectorizes without hardware gathers; the reaction forces are
+    // scattered afterwards.
+    template <PairPotentialForm Form, CutoffTreatment Treatment, bool Periodic>
+    double accumulateRow(const PairKernelData &d, std::uint32_t i, NeighborBatch &batch, ForceArray &forces)
+    {
+        const std::uint32_t begin = d.offsets[i];
+        const std::uint32_t count = d.offsets[i + 1] - begin;
+        batch.reserve(count);
+        KernelReal *__restrict bx = batch.dx.data();
+        KernelReal *__restrict by = batch.dy.data();
+        KernelReal *__restrict bz = batch.dz.data();
+        KernelReal *__restrict ba = batch.a.data();
+        KernelReal *__restrict bb = batch.b.data();
+        KernelReal *__restrict bc = batch.c.data();
+        KernelReal *__restrict bue = batch.energyShift.data();
+        KernelReal *__restrict buf = batch.forceShift.data();
+        KernelReal *__restrict bfr = batch.forceOverR.data();
+        AccumReal *__restrict fx = forces.x.data();
+        AccumReal *__restrict fy = forces.y.data();
+        AccumReal *__restrict fz = forces.z.data();
+        const KernelReal rc = static_cast<KernelReal>(d.rc), rc2 = static_cast<KernelReal>(d.rc2);
+        const KernelReal rs2 = static_cast<KernelReal>(d.rs2), switchingScale = static_cast<KernelReal>(d.switchingScale);
+
+        const KernelReal px = static_cast<KernelReal>(d.period[0]), py = static_cast<KernelReal>(d.period[1]), pz = static_cast<KernelReal>(d.period[2]);
+        const KernelReal ipx = static_cast<KernelReal>(d.inversePeriod[0]), ipy = static_cast<KernelReal>(d.inversePeriod[1]),
+                         ipz = static_cast<KernelReal>(d.inversePeriod[2]);
+
+        const KernelReal xi = d.x[i], yi = d.y[i], zi = d.z[i];
+        const std::size_t row = d.species[i] * d.speciesCount;
+        for (std::uint32_t k = 0; k < count; k++)
+        {
+            const std::uint32_t j = d.list[begin + k];
+            KernelReal dx = xi - d.x[j];
+            KernelReal dy = yi - d.y[j];
+            KernelReal dz = zi - d.z[j];
+            if (Periodic)
+            {
+                // Minimum image over any number of box lengths, as Domain::minimumImage(),
+                // so positions never need wrapping; open axes have a zero period
+                dx -= px * std::nearbyint(dx * ipx);
+                dy -= py * std::nearbyint(dy * ipy);
+                dz -= pz * std::nearbyint(dz * ipz);
+            }
+            bx[k] = dx;
+            by[k] = dy;
+            bz[k] = dz;
+            const std::size_t p = row + d.species[j];
+            ba[k] = static_cast<KernelReal>(d.a[p]);
+            bb[k] = static_cast<KernelReal>(d.b[p]);
+            bc[k] = static_cast<KernelReal>(d.c[p]);
+            bue[k] = static_cast<KernelReal>(d.energyShift[p]);
+            buf[k] = static_cast<KernelReal>(d.forceShift[p]);
+        }
+
+        KernelReal fxi = 0, fyi = 0, fzi = 0, energy = 0;
+        ATOM_SIMD_LOOP(reduction(+ : fxi, fyi, fzi, energy))
+        for (std::uint32_t k = 0; k < count; k++)
+        {
+            const KernelReal r2 = bx[k] * bx[k] + by[k] * by[k] + bz[k] * bz[k];
+            const bool inside = (r2 < rc2) & (r2 > KernelReal(0));
+            const KernelReal safeR2 = inside ? r2 : rc2;
+
+            KernelReal u = pairEnergy<Form>(safeR2, ba[k], bb[k], bc[k]);
+            KernelReal fr = pairForceOverR<Form>(safeR2, ba[k], bb[k], bc[k]);
+            if (Treatment == CutoffTreatment::ShiftedForce)
+            {
+                const KernelReal r = std::sqrt(safeR2);
+                u += (r - rc) * buf[k] - bue[k];
+                fr -= buf[k] / r;
+            }
+            else
+            {
+                // S = (rc^2 - r^2)^2 (rc^2 + 2 r^2 - 3 rs^2) / (rc^2 - rs^2)^3 between rs and rc
+                const bool switching = safeR2 > rs2;
+                const KernelReal outer = rc2 - safeR2;
+                const KernelReal s = switching ? outer * outer * (rc2 + KernelReal(2) * safeR2 - KernelReal(3) * rs2) * switchingScale : KernelReal(1);
+                const KernelReal dsdr2 = switching ? KernelReal(6) * outer * (rs2 - safeR2) * switchingScale : KernelReal(0);
+                fr = fr * s - KernelReal(2) * u * dsdr2;
+                u *= s;
+            }
+            fr = inside ? fr : KernelReal(0);
+            energy += inside ? u : KernelReal(0);
+            bfr[k] = fr;
+            fxi += fr * bx[k];
+            fyi += fr * by[k];
+            fzi += fr * bz[k];
+        }
+
+        // Newton's third law
+        for (std::uint32_t k = 0; k < count; k++)
+        {
+            const std::uint32_t j = d.list[begin + k];
+            fx[j] -= static_cast<AccumReal>(bfr[k] * bx[k]);
+            fy[j] -= static_cast<AccumReal>(bfr[k] * by[k]);
+            fz[j] -= static_cast<AccumReal>(bfr[k] * bz[k]);
+        }
+        fx[i] += static_cast<AccumReal>(fxi);
+        fy[i] += static_cast<AccumReal>(fyi);
+        fz[i] += static_cast<AccumReal>(fzi);
+        return energy;
+    }
+}
+
+// Constructor
+PairPotentialForce::PairPotentialForce(const PairPotentialParameters &parameters)
+    : parameters(parameters), neighbors(parameters.cutoff, parameters.skin)
+{
+    setParameters(parameters);
+}
+
+void PairPotentialForce::setParameters(const PairPotentialParameters &p)
+{
+    if (!(p.cutoff > 0.0))
+    {
+        throw std::invalid_argument("Cutoff must be positive.");
+    }
+    if (p.cutoffTreatment == CutoffTreatment::Switching && !(p.switchingRadius >= 0.0 && p.switchingRadius < p.cutoff))
+    {
+        throw std::invalid_argument("Switching radius must be in [0, cutoff).");
+    }
+
+    // Coefficients of one form mean nothing to the other
+    if (p.form != parameters.form)
+    {
+        speciesLennardJones.clear();
+        pairEntries.clear();
+    }
+    parameters = p;
+    neighbors.setCutoff(p.cutoff);
+    neighbors.setSkin(p.skin);
+    tableDirty = true;
+}
+
+void PairPotentialForce::setLennardJones(std::uint16_t species, double epsilon, double sigma)
+{
+    if (parameters.form != PairPotentialForm::LennardJones)
+    {
+        throw std::invalid_argument("Force field is not Lennard-Jones.");
+    }
+    if (species >= speciesLennardJones.size())
+    {
+        speciesLennardJones.resize(species + 1, SpeciesLennardJones{0.0, 0.0, false});
+    }
+    speciesLennardJones[species] = {epsilon, sigma, true};
+    tableDirty = true;
+}
+
+void PairPotentialForce::setLennardJonesPair(std::uint16_t a, std::uint16_t b, double epsilon, double sigma)
+{
+    if (parameters.form != PairPotentialForm::LennardJones)
+    {
+        throw std::invalid_argument("Force field is not Lennard-Jones.");
+    }
+    const double sigma6 = std::pow(sigma, 6);
+    pairEntries[{std::min(a, b), std::max(a, b)}] = {4.0 * epsilon * sigma6 * sigma6, 4.0 * epsilon * sigma6, 0.0};
+    tableDirty = true;
+}
+
+void PairPotentialForce::setBuckinghamPair(std::uint16_t a, std::uint16_t b, double A, double rho, double C)
+{
+    if (parameters.form != PairPotentialForm::Buckingham)
+    {
+        throw std::invalid_argument("Force field is not Buckingham.");
+    }
+    if (!(rho > 0.0))
+    {
+        throw std::invalid_argument("Buckingham rho must be positive.");
+    }
+    pairEntries[{std::min(a, b), std::max(a, b)}] = {A, 1.0 / rho, C};
+    tableDirty = true;
+}
+
+void PairPotentialForce::buildTable()
+{
+    const std::size_t s = speciesCount;
+    coefficientA.assign(s * s, 0.0);
+    coefficientB.assign(s * s, 0.0);
+    coefficientC.assign(s * s, 0.0);
+    cutoffEnergy.assign(s * s, 0.0);
+    cutoffForce.assign(s * s, 0.0);
+
+    auto store = [&](std::size_t a, std::size_t b, const PairEntry &e)
+    {
+        if (a >= s || b >= s)
+        {
+            return;
+        }
+        for (std::size_t index : {a * s + b, b * s + a})
+        {
+            coefficientA[index] = e.a;
+            coefficientB[index] = e.b;
+            coefficientC[index] = e.c;
+        }
+    };
+
+    // Lorentz-Berthelot mixing, then explicit pairs on top
+    for (std::size_t a = 0; a < speciesLennardJones.size(); a++)
+    {
+        for (std::size_t b = a; b < speciesLennardJones.size(); b++)
+        {
+            const SpeciesLennardJones &sa = speciesLennardJones[a];
+            const SpeciesLennardJones &sb = speciesLennardJones[b];
+            if (!sa.defined || !sb.defined)
+            {
+                continue;
+            }
+            const double epsilon = std::sqrt(sa.epsilon * sb.epsilon);
+            const double sigma6 = std::pow(0.5 * (sa.sigma + sb.sigma), 6);
+            store(a, b, {4.0 * epsilon * sigma6 * sigma6, 4.0 * epsilon * sigma6, 0.0});
+        }
+    }
+    for (const auto &entry : pairEntries)
+    {
+        store(entry.first.first, entry.first.second, entry.second);
+    }
+
+    const double rc2 = parameters.cutoff * parameters.cutoff;
+    for (std::size_t index = 0; index < s * s; index++)
+    {
+        const double a = coefficientA[index], b = coefficientB[index], c = coefficientC[index];
+        if (parameters.form == PairPotentialForm::LennardJones)
+        {
+            cutoffEnergy[index] = pairEnergy<PairPotentialForm::LennardJones>(rc2, a, b, c);
+            cutoffForce[index] = pairForceOverR<PairPotentialForm::LennardJones>(rc2, a, b, c) * parameters.cutoff;
+        }
+        else
+        {
+            cutoffEnergy[index] = pairEnergy<PairPotentialForm::Buckingham>(rc2, a, b, c);
+            cutoffForce[index] = pairForceOverR<PairPotentialForm::Buckingham>(rc2, a, b, c) * parameters.cutoff;
+        }
+    }
+    tableDirty = false;
+}
+
+template <PairPotentialForm Form, CutoffTreatment Treatment, bool Periodic>
+double PairPotentialForce::accumulateForces(const ParticleSystem &system)
+{
+    const Vector3Array &positions = system.getPositions();
+    PairKernelData d;
+    d.x = positions.x.data();
+    d.y = positions.y.data();
+    d.z = positions.z.data();
+    d.species = system.getSpecies().data();
+    d.offsets = neighbors.getOffsets().data();
+    d.list = neighbors.getNeighbors().data();
+    d.a = coefficientA.data();
+    d.b = coefficientB.data();
+    d.c = coefficientC.data();
+    d.energyShift = cutoffEnergy.data();
+    d.forceShift = cutoffForce.data();
+    d.speciesCount = speciesCount;
+    d.rc = parameters.cutoff;
+    d.rc2 = d.rc * d.rc;
+    d.rs2 = parameters.switchingRadius * parameters.switchingRadius;
+    d.switchingScale = Treatment == CutoffTreatment::Switching ? 1.0 / ((d.rc2 - d.rs2) * (d.rc2 - d.rs2) * (d.rc2 - d.rs2)) : 0.0;
+    for (int a = 0; a < 3; a++)
+    {
+        d.period[a] = parameters.domain.periodic[a] ? parameters.domain.length(a) : 0.0;
+        d.inversePeriod[a] = parameters.domain.periodic[a] ? 1.0 / d.period[a] : 0.0;
+    }
+
+    const std::size_t n = system.size();
+    ThreadPool &pool = ThreadPool::global();
+    const bool deterministic = parameters.accumulation == ForceAccumulation::Deterministic;
+    const ForceAccumulation accumulation = !deterministic && (pool.size() == 1 || n < PARALLEL_THRESHOLD) ? ForceAccumulation::Serial : parameters.accumulation;
+    if (accumulation == ForceAccumulation::Serial)
+    {
+        NeighborBatch &batch = scratchBatch();
+        CompensatedSum<double> energy;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            energy += accumulateRow<Form, Treatment, Periodic>(d, static_cast<std::uint32_t>(i), batch, forces);
+        }
+        return energy.value();
+    }
+
+    // Per-task energies are summed once per task, not per pair
+    std::mutex energyMutex;
+    CompensatedSum<double> energy;
+    auto addEnergy = [&](const CompensatedSum<double> &e)
+    {
+        std::lock_guard<std::mutex> lock(energyMutex);
+        energy += e;
+    };
+
+    if (accumulation == ForceAccumulation::ThreadBuffers)
+    {
+        buffers.begin(n);
+        pool.parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                         {
+                             NeighborBatch &batch = scratchBatch();
+                             ForceArray &buffer = buffers.acquire();
+                             CompensatedSum<double> e;
+                             for (std::size_t i = begin; i < end; i++)
+                             {
+                                 e += accumulateRow<Form, Treatment, Periodic>(d, static_cast<std::uint32_t>(i), batch, buffer);
+                             }
+                             buffers.release(buffer);
+                             addEnergy(e); },
+                         ROW_GRAIN);
+        buffers.reduceInto(forces, pool);
+        return energy.value();
+    }
+
+    // Coloring: rows are grouped by the cell of the grid the list was built
+    // on. Partners of a row lie in the adjacent cells, so cells of one color
+    // touch disjoint particles, and every particle receives its pair terms in
+    // color order whatever the thread count. The deterministic mode also
+    // keeps the energy per cell and adds it up in cell order.
+    const CellGrid &grid = neighbors.getGrid();
+    if (colorsDirty)
+    {
+        cellColors = grid.cellColors();
+        colorsDirty = false;
+    }
+    const std::uint32_t *cellStart = grid.getCellStart().data();
+    const std::uint32_t *cellParticles = grid.getCellParticles().data();
+    if (deterministic)
+    {
+        cellEnergy.assign(grid.cellCount(), 0.0);
+    }
+    for (const std::vector<std::uint32_t> &cells : cellColors)
+    {
+        pool.parallelFor(0, cells.size(), [&](std::size_t begin, std::size_t end)
+                         {
+                             NeighborBatch &batch = scratchBatch();
+                             CompensatedSum<double> e;
+                             for (std::size_t k = begin; k < end; k++)
+                             {
+                                 CompensatedSum<double> cell;
+                                 for (std::uint32_t slot = cellStart[cells[k]]; slot < cellStart[cells[k] + 1]; slot++)
+                                 {
+                                     cell += accumulateRow<Form, Treatment, Periodic>(d, cellParticles[slot], batch, forces);
+                                 }
+                                 if (deterministic)
+                                 {
+                                     cellEnergy[cells[k]] = cell.value();
+                                 }
+                                 e += cell;
+                             }
+                             if (!deterministic)
+                             {
+                                 addEnergy(e);
+                             } });
+    }
+    if (deterministic)
+    {
+        return pool.orderedReduce(0, cellEnergy.size(), ENERGY_BLOCK, 0.0, [&](std::size_t begin, std::size_t end)
+                                  {
+                                      CompensatedSum<double> e;
+                                      for (std::size_t c = begin; c < end; c++)
+                                      {
+                                          e += cellEnergy[c];
+                                      }
+                                      return e.value(); });
+    }
+    return energy.value();
+}
+
+void PairPotentialForce::computeAccelerations(ParticleSystem &system)
+{
+    const std::size_t n = system.size();
+    const AlignedVector<std::uint16_t> &species = system.getSpecies();
+    const std::size_t needed = n > 0 ? static_cast<std::size_t>(*std::max_element(species.begin(), species.end())) + 1 : 0;
+    if (needed > speciesCount)
+    {
+        speciesCount = needed;
+        tableDirty = true;
+    }
+    if (tableDirty)
+    {
+        buildTable();
+    }
+
+    if (neighbors.update(system, parameters.domain))
+    {
+        colorsDirty = true;
+    }
+    forces.resize(n);
+    std::fill(forces.x.begin(), forces.x.end(), AccumReal(0));
+    std::fill(forces.y.begin(), forces.y.end(), AccumReal(0));
+    std::fill(forces.z.begin(), forces.z.end(), AccumReal(0));
+
+    const bool periodic = parameters.domain.isPeriodic();
+    const bool lennardJones = parameters.form == PairPotentialForm::LennardJones;
+    const bool shifted = parameters.cutoffTreatment == CutoffTreatment::ShiftedForce;
+    if (lennardJones && shifted)
+    {
+        potentialEnergy = periodic ? accumulateForces<PairPotentialForm::LennardJones, CutoffTreatment::ShiftedForce, true>(system)
+                                   : accumulateForces<PairPotentialForm::LennardJones, CutoffTreatment::ShiftedForce, false>(system);
+    }
+    else if (lennardJones)
+    {
+        potentialEnergy = periodic ? accumulateForces<PairPotentialForm::LennardJones, CutoffTreatment::Switching, true>(system)
+                                   : accumulateForces<PairPotentialForm::LennardJones, CutoffTreatment::Switching, false>(system);
+    }
+    else if (shifted)
+    {
+        potentialEnergy = periodic ? accumulateForces<PairPotentialForm::Buckingham, CutoffTreatment::ShiftedForce, true>(system)
+                                   : accumulateForces<PairPotentialForm::Buckingham, CutoffTreatment::ShiftedForce, false>(system);
+    }
+    else
+    {
+        potentialEnergy = periodic ? accumulateForces<PairPotentialForm::Buckingham, CutoffTreatment::Switching, true>(system)
+                                   : accumulateForces<PairPotentialForm::Buckingham, CutoffTreatment::Switching, false>(system);
+    }
+
+    // a = F / m, massless particles do not accelerate
+    Vector3Array &accelerations = system.getAccelerations();
+    const Real *masses = system.getMasses().data();
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const AccumReal invMass = masses[i] != Real(0) ? AccumReal(1) / masses[i] : AccumReal(0);
+        accelerations.x[i] = static_cast<Real>(forces.x[i] * invMass);
+        accelerations.y[i] = static_cast<Real>(forces.y[i] * invMass);
+        accelerations.z[i] = static_cast<Real>(forces.z[i] * invMass);
+    }
+}
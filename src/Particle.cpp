@@ -1,30 +1,41 @@
 #include "Particle.h"
+#include "Species.h"
 
 // Constructor
 Particle::Particle(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
-                   const Vector3 &color, double mass, double radius, double charge, const std::string &name)
+                   const Vector3 &color, Real mass, Real radius, Real charge, std::string_view name,
+                   std::uint16_t species)
     : position(position), velocity(velocity), acceleration(acceleration),
-      color(color), mass(mass), radius(radius), charge(charge), name(name) {}
+      color(color), mass(mass), radius(radius), charge(charge), name(NameTable::intern(name)), species(species) {}
+
+Particle::Particle(std::uint16_t species, const Vector3 &position, const Vector3 &velocity)
+    : Particle(position, velocity, Vector3(), Species::get(species).color, static_cast<Real>(Species::get(species).mass),
+               static_cast<Real>(Species::get(species).radius), static_cast<Real>(Species::get(species).charge),
+               Species::get(species).symbol, species) {}
 
 // Getters
 Vector3 Particle::getPosition() const { return position; }
 Vector3 Particle::getVelocity() const { return velocity; }
 Vector3 Particle::getAcceleration() const { return acceleration; }
 Vector3 Particle::getColor() const { return color; }
-double Particle::getMass() const { return mass; }
-double Particle::getRadius() const { return radius; }
-double Particle::getCharge() const { return charge; }
-std::string Particle::getName() const { return name; }
+Real Particle::getMass() const { return mass; }
+Real Particle::getRadius() const { return radius; }
+Real Particle::getCharge() const { return charge; }
+const std::string &Particle::getName() const { return NameTable::lookup(name); }
+NameId Particle::getNameId() const { return name; }
+std::uint16_t Particle::getSpecies() const { return species; }
 
 // Setters
 void Particle::setPosition(const Vector3 &pos) { position = pos; }
 void Particle::setVelocity(const Vector3 &vel) { velocity = vel; }
 void Particle::setAcceleration(const Vector3 &acc) { acceleration = acc; }
 void Particle::setColor(const Vector3 &col) { color = col; }
-void Particle::setMass(double m) { mass = m; }
-void Particle::setRadius(double r) { radius = r; }
-void Particle::setCharge(double c) { charge = c; }
-void Particle::setName(const std::string &n) { name = n; }
+void Particle::setMass(Real m) { mass = m; }
+void Particle::setRadius(Real r) { radius = r; }
+void Particle::setCharge(Real c) { charge = c; }
+void Particle::setName(std::string_view n) { name = NameTable::intern(n); }
+void Particle::setNameId(NameId n) { name = n; }
+void Particle::setSpecies(std::uint16_t s) { species = s; }
 
 // Update particle state
 void Particle::update(double deltaTime)
@@ -0,0 +1,477 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include "Hilbert.h"
+#include "Morton.h"
+#include "RadixSort.h"
+#include "ThreadPool.h"
+#include "VectorKernels.h"
+
+namespace
+{
+    const std::size_t PARALLEL_GRAIN = 16384;
+
+    // data[i] = old data[order[i]]
+    template <typename Vector>
+    void gather(Vector &data, const std::vector<std::uint32_t> &order, ThreadPool &pool)
+    {
+        Vector result(data.size());
+        pool.parallelFor(0, order.size(), [&](std::size_t begin, std::size_t end)
+                         {
+                             for (std::size_t i = begin; i < end; i++)
+                             {
+                                 result[i] = std::move(data[order[i]]);
+                             } },
+                         PARALLEL_GRAIN);
+        data.swap(result);
+    }
+
+    void gather(Vector3Array &data, const std::vector<std::uint32_t> &order, ThreadPool &pool)
+    {
+        gather(data.x, order, pool);
+        gather(data.y, order, pool);
+        gather(data.z, order, pool);
+    }
+}
+
+// Constructor
+ParticleSystem::ParticleSystem(const std::vector<Particle> &particles)
+{
+    reserve(particles.size());
+    for (const Particle &p : particles)
+    {
+        add(p);
+    }
+}
+
+// Size management
+void ParticleSystem::reserve(std::size_t n)
+{
+    positions.reserve(n);
+    velocities.reserve(n);
+    accelerations.reserve(n);
+    masses.reserve(n);
+    charges.reserve(n);
+    species.reserve(n);
+    if (!radii.empty())
+    {
+        radii.reserve(n);
+    }
+    if (!colors.empty())
+    {
+        colors.reserve(n);
+    }
+    if (!positionCompensation.empty())
+    {
+        positionCompensation.reserve(n);
+    }
+    names.reserve(n);
+    slotOf.reserve(n);
+    slots.reserve(n);
+}
+
+void ParticleSystem::clear()
+{
+    positions.clear();
+    velocities.clear();
+    accelerations.clear();
+    masses.clear();
+    charges.clear();
+    species.clear();
+    radii = AlignedVector<Real>();
+    colors = Vector3Array();
+    positionCompensation = Vector3Array();
+    names.clear();
+    for (std::uint32_t slot : slotOf)
+    {
+        releaseSlot(slot);
+    }
+    slotOf.clear();
+    layoutVersion++;
+    localitySorted = false;
+}
+
+// Append a particle
+std::size_t ParticleSystem::add(const Particle &p)
+{
+    return append(p.getPosition(), p.getVelocity(), p.getAcceleration(), p.getColor(),
+                  p.getMass(), p.getRadius(), p.getCharge(), p.getNameId(), p.getSpecies());
+}
+
+std::size_t ParticleSystem::add(std::uint16_t speciesIndex, const Vector3 &position, const Vector3 &velocity)
+{
+    const SpeciesInfo &info = Species::get(speciesIndex);
+    return append(position, velocity, Vector3(), info.color, static_cast<Real>(info.mass), static_cast<Real>(info.radius),
+                  static_cast<Real>(info.charge), NameTable::intern(info.symbol), speciesIndex);
+}
+
+std::size_t ParticleSystem::add(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
+                                const Vector3 &color, Real mass, Real radius, Real charge, std::string_view name,
+                                std::uint16_t speciesIndex)
+{
+    return append(position, velocity, acceleration, color, mass, radius, charge, NameTable::intern(name), speciesIndex);
+}
+
+std::size_t ParticleSystem::append(const Vector3 &position, const Vector3 &velocity, const Vector3 &acceleration,
+                                   const Vector3 &color, Real mass, Real radius, Real charge, NameId name,
+                                   std::uint16_t speciesIndex)
+{
+    positions.push_back(position);
+    velocities.push_back(velocity);
+    accelerations.push_back(acceleration);
+    masses.push_back(mass);
+    charges.push_back(charge);
+    species.push_back(speciesIndex);
+    names.push_back(name);
+    setRadius(size() - 1, radius);
+    setColor(size() - 1, color);
+    if (!positionCompensation.empty())
+    {
+        positionCompensation.push_back(Vector3());
+    }
+
+    const std::uint32_t index = static_cast<std::uint32_t>(size() - 1);
+    std::uint32_t slot = freeSlot;
+    if (slot != ParticleHandle::NO_SLOT)
+    {
+        freeSlot = slots[slot].index;
+        slots[slot].index = index;
+    }
+    else
+    {
+        slot = static_cast<std::uint32_t>(slots.size());
+        slots.push_back({index, 0});
+    }
+    slotOf.push_back(slot);
+    layoutVersion++;
+    return index;
+}
+
+// Remove a particle (swap with last)
+void ParticleSystem::remove(std::size_t index)
+{
+    std::size_t last = size() - 1;
+    releaseSlot(slotOf[index]);
+    if (index != last)
+    {
+        positions.set(index, positions.get(last));
+        velocities.set(index, velocities.get(last));
+        accelerations.set(index, accelerations.get(last));
+        masses[index] = masses[last];
+        charges[index] = charges[last];
+        species[index] = species[last];
+        names[index] = names[last];
+        if (!radii.empty())
+        {
+            radii[index] = radii[last];
+        }
+        if (!colors.empty())
+        {
+            colors.set(index, colors.get(last));
+        }
+        if (!positionCompensation.empty())
+        {
+            positionCompensation.set(index, positionCompensation.get(last));
+        }
+        slotOf[index] = slotOf[last];
+        slots[slotOf[index]].index = static_cast<std::uint32_t>(index);
+    }
+    layoutVersion++;
+    slotOf.pop_back();
+    positions.pop_back();
+    velocities.pop_back();
+    accelerations.pop_back();
+    masses.pop_back();
+    charges.pop_back();
+    species.pop_back();
+    names.pop_back();
+    if (!radii.empty())
+    {
+        radii.pop_back();
+    }
+    if (!colors.empty())
+    {
+        colors.pop_back();
+    }
+    if (!positionCompensation.empty())
+    {
+        positionCompensation.pop_back();
+    }
+}
+
+// Single-particle access
+Particle ParticleSystem::get(std::size_t index) const
+{
+    Particle p(positions.get(index), velocities.get(index), accelerations.get(index),
+               getColor(index), masses[index], getRadius(index), charges[index], std::string_view(), species[index]);
+    p.setNameId(names[index]);
+    return p;
+}
+
+void ParticleSystem::set(std::size_t index, const Particle &p)
+{
+    positions.set(index, p.getPosition());
+    velocities.set(index, p.getVelocity());
+    accelerations.set(index, p.getAcceleration());
+    masses[index] = p.getMass();
+    charges[index] = p.getCharge();
+    names[index] = p.getNameId();
+    species[index] = p.getSpecies();
+    setRadius(index, p.getRadius());
+    setColor(index, p.getColor());
+    if (!positionCompensation.empty())
+    {
+        positionCompensation.set(index, Vector3());
+    }
+}
+
+// Radius and color overrides
+void ParticleSystem::setRadius(std::size_t index, Real radius)
+{
+    if (radii.empty() && radius == static_cast<Real>(Species::get(species[index]).radius))
+    {
+        return;
+    }
+    materializeRadii();
+    radii[index] = radius;
+}
+
+void ParticleSystem::setColor(std::size_t index, const Vector3 &color)
+{
+    const Vector3 standard = Species::get(species[index]).color;
+    if (colors.empty() && color.getX() == standard.getX() && color.getY() == standard.getY() && color.getZ() == standard.getZ())
+    {
+        return;
+    }
+    materializeColors();
+    colors.set(index, color);
+}
+
+// Fill the override array up to size() with species defaults
+void ParticleSystem::materializeRadii()
+{
+    std::size_t first = radii.size();
+    radii.resize(size());
+    for (std::size_t i = first; i < size(); i++)
+    {
+        radii[i] = static_cast<Real>(Species::get(species[i]).radius);
+    }
+}
+
+void ParticleSystem::materializeColors()
+{
+    std::size_t first = colors.size();
+    colors.resize(size());
+    for (std::size_t i = first; i < size(); i++)
+    {
+        colors.set(i, Species::get(species[i]).color);
+    }
+}
+
+// Handles
+std::size_t ParticleSystem::indexOf(ParticleHandle handle) const
+{
+    if (!contains(handle))
+    {
+        throw std::invalid_argument("Particle handle is stale or null.");
+    }
+    return slots[handle.slot].index;
+}
+
+void ParticleSystem::releaseSlot(std::uint32_t slot)
+{
+    slots[slot].generation++;
+    slots[slot].index = freeSlot;
+    freeSlot = slot;
+}
+
+// Storage order
+void ParticleSystem::permute(const std::vector<std::uint32_t> &order)
+{
+    const std::size_t n = size();
+    if (order.size() != n)
+    {
+        throw std::invalid_argument("Permutation size does not match the particle count.");
+    }
+    std::vector<bool> seen(n, false);
+    for (std::uint32_t i : order)
+    {
+        if (i >= n || seen[i])
+        {
+            throw std::invalid_argument("Order is not a permutation of the particle indices.");
+        }
+        seen[i] = true;
+    }
+
+    ThreadPool &pool = ThreadPool::global();
+    gather(positions, order, pool);
+    gather(velocities, order, pool);
+    gather(accelerations, order, pool);
+    gather(masses, order, pool);
+    gather(charges, order, pool);
+    gather(species, order, pool);
+    if (!radii.empty())
+    {
+        gather(radii, order, pool);
+    }
+    if (!colors.empty())
+    {
+        gather(colors, order, pool);
+    }
+    if (!positionCompensation.empty())
+    {
+        gather(positionCompensation, order, pool);
+    }
+    gather(names, order, pool);
+    gather(slotOf, order, pool);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        slots[slotOf[i]].index = static_cast<std::uint32_t>(i);
+    }
+    layoutVersion++;
+}
+
+void ParticleSystem::sortSpatially(SpaceFillingCurve curve)
+{
+    const std::size_t n = size();
+    if (n > 1)
+    {
+        double low[3], extent[3];
+        const AlignedVector<Real> *axes[3] = {&positions.x, &positions.y, &positions.z};
+        for (int a = 0; a < 3; a++)
+        {
+            const auto range = std::minmax_element(axes[a]->begin(), axes[a]->end());
+            low[a] = *range.first;
+            extent[a] = static_cast<double>(*range.second) - low[a];
+        }
+        // Cubic box, so the curve does not stretch along the longest axis
+        const double side = std::max({extent[0], extent[1], extent[2]});
+        const double scale = side > 0.0 ? 1.0 / side : 0.0;
+
+        std::vector<std::uint64_t> keys(n);
+        std::vector<std::uint32_t> order(n);
+        ThreadPool &pool = ThreadPool::global();
+        pool.parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                         {
+                             for (std::size_t i = begin; i < end; i++)
+                             {
+                                 const std::uint32_t x = Morton::quantize((positions.x[i] - low[0]) * scale);
+                                 const std::uint32_t y = Morton::quantize((positions.y[i] - low[1]) * scale);
+                                 const std::uint32_t z = Morton::quantize((positions.z[i] - low[2]) * scale);
+                                 keys[i] = curve == SpaceFillingCurve::Hilbert ? Hilbert::encode(x, y, z) : Morton::encode(x, y, z);
+                                 order[i] = static_cast<std::uint32_t>(i);
+                             } },
+                         PARALLEL_GRAIN);
+        radixSort(keys, order, pool);
+        permute(order);
+    }
+    sortedLocality = localityMetric();
+    localitySorted = true;
+    callsSinceCheck = 0;
+}
+
+double ParticleSystem::localityMetric() const
+{
+    const std::size_t n = size();
+    if (n < 2)
+    {
+        return 0.0;
+    }
+    const double sum = ThreadPool::global().orderedReduce(1, n, PARALLEL_GRAIN, 0.0, [this](std::size_t begin, std::size_t end)
+                                                          {
+                                                              double partial = 0.0;
+                                                              for (std::size_t i = begin; i < end; i++)
+                                                              {
+                                                                  const double dx = positions.x[i] - positions.x[i - 1];
+                                                                  const double dy = positions.y[i] - positions.y[i - 1];
+                                                                  const double dz = positions.z[i] - positions.z[i - 1];
+                                                                  partial += std::sqrt(dx * dx + dy * dy + dz * dz);
+                                                              }
+                                                              return partial; });
+    return sum / static_cast<double>(n - 1);
+}
+
+bool ParticleSystem::maintainLocality()
+{
+    if (!reorderPolicy.enabled || ++callsSinceCheck < reorderPolicy.checkInterval)
+    {
+        return false;
+    }
+    callsSinceCheck = 0;
+    if (localitySorted && localityMetric() <= reorderPolicy.degradation * sortedLocality)
+    {
+        return false;
+    }
+    sortSpatially(reorderPolicy.curve);
+    return true;
+}
+
+void ParticleSystem::setReorderPolicy(const ReorderPolicy &policy)
+{
+    if (!(policy.degradation >= 1.0))
+    {
+        throw std::invalid_argument("Locality degradation factor must be at least 1.");
+    }
+    reorderPolicy = policy;
+    callsSinceCheck = 0;
+}
+
+// Relative coordinates
+void ParticleSystem::recenter()
+{
+    if (empty())
+    {
+        return;
+    }
+    double center[3];
+    AlignedVector<Real> *axes[3] = {&positions.x, &positions.y, &positions.z};
+    for (int a = 0; a < 3; a++)
+    {
+        const auto range = std::minmax_element(axes[a]->begin(), axes[a]->end());
+        center[a] = 0.5 * (static_cast<double>(*range.first) + static_cast<double>(*range.second));
+    }
+    const Vector3d shift(center[0], center[1], center[2]);
+    ThreadPool::global().parallelFor(0, size(), [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t i = begin; i < end; i++)
+                                         {
+                                             for (int a = 0; a < 3; a++)
+                                             {
+                                                 Real &x = (*axes[a])[i];
+                                                 x = static_cast<Real>(static_cast<double>(x) - center[a]);
+                                             }
+                                         } },
+                                     PARALLEL_GRAIN);
+    origin += shift;
+    layoutVersion++; // caches built in the old coordinates are stale too
+}
+
+Vector3Array &ParticleSystem::getPositionCompensation()
+{
+    if (positionCompensation.size() != size())
+    {
+        positionCompensation.resize(size());
+    }
+    return positionCompensation;
+}
+
+std::vector<Particle> ParticleSystem::toParticles() const
+{
+    std::vector<Particle> result;
+    result.reserve(size());
+    for (std::size_t i = 0; i < size(); i++)
+    {
+        result.push_back(get(i));
+    }
+    return result;
+}
+
+// Update all particles (explicit Euler, matches Particle::update)
+void ParticleSystem::update(double deltaTime)
+{
+    VectorKernels::axpy(static_cast<Real>(deltaTime), makeSpan(velocities), makeSpan(positions));
+    VectorKernels::axpy(static_cast<Real>(deltaTime), makeSpan(accelerations), makeSpan(velocities));
+}
@@ -0,0 +1,103 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace
+{
+    const int RADIX_BITS = 8;
+    const std::size_t RADIX = std::size_t(1) << RADIX_BITS;
+    const std::size_t MIN_BLOCK = 16384; // keys per block below which counting is not worth a task
+}
+
+void radixSort(std::vector<std::uint64_t> &keys, std::vector<std::uint32_t> &values, ThreadPool &pool)
+{
+    if (keys.size() != values.size())
+    {
+        throw std::invalid_argument("Radix sort needs one value per key.");
+    }
+    const std::size_t n = keys.size();
+    if (n < 2)
+    {
+        return;
+    }
+
+    const std::size_t blockCount = std::min((n + MIN_BLOCK - 1) / MIN_BLOCK, 4 * pool.size());
+    const std::size_t blockSize = (n + blockCount - 1) / blockCount;
+
+    // Bits that differ between any key and the first one
+    std::vector<std::uint64_t> blockDiffer(blockCount, 0);
+    const std::uint64_t first = keys[0];
+    pool.parallelFor(0, blockCount, [&](std::size_t b0, std::size_t b1)
+                     {
+                         for (std::size_t b = b0; b < b1; b++)
+                         {
+                             std::uint64_t differ = 0;
+                             const std::size_t end = std::min(n, (b + 1) * blockSize);
+                             for (std::size_t i = b * blockSize; i < end; i++)
+                             {
+                                 differ |= keys[i] ^ first;
+                             }
+                             blockDiffer[b] = differ;
+                         } });
+    std::uint64_t differ = 0;
+    for (std::uint64_t d : blockDiffer)
+    {
+        differ |= d;
+    }
+
+    std::vector<std::uint64_t> keyScratch(n);
+    std::vector<std::uint32_t> valueScratch(n);
+    std::vector<std::array<std::size_t, RADIX>> offsets(blockCount);
+
+    for (int shift = 0; shift < 64; shift += RADIX_BITS)
+    {
+        if (((differ >> shift) & (RADIX - 1)) == 0)
+        {
+            continue;
+        }
+
+        // Digit histogram of every block
+        pool.parallelFor(0, blockCount, [&](std::size_t b0, std::size_t b1)
+                         {
+                             for (std::size_t b = b0; b < b1; b++)
+                             {
+                                 std::array<std::size_t, RADIX> &count = offsets[b];
+                                 count.fill(0);
+                                 const std::size_t end = std::min(n, (b + 1) * blockSize);
+                                 for (std::size_t i = b * blockSize; i < end; i++)
+                                 {
+                                     count[(keys[i] >> shift) & (RADIX - 1)]++;
+                                 }
+                             } });
+
+        // Exclusive prefix over (digit, block), which keeps equal digits in input order
+        std::size_t running = 0;
+        for (std::size_t digit = 0; digit < RADIX; digit++)
+        {
+            for (std::size_t b = 0; b < blockCount; b++)
+            {
+                const std::size_t count = offsets[b][digit];
+                offsets[b][digit] = running;
+                running += count;
+            }
+        }
+
+        pool.parallelFor(0, blockCount, [&](std::size_t b0, std::size_t b1)
+                         {
+                             for (std::size_t b = b0; b < b1; b++)
+                             {
+                                 std::array<std::size_t, RADIX> &next = offsets[b];
+                                 const std::size_t end = std::min(n, (b + 1) * blockSize);
+                                 for (std::size_t i = b * blockSize; i < end; i++)
+                                 {
+                                     const std::size_t target = next[(keys[i] >> shift) & (RADIX - 1)]++;
+                                     keyScratch[target] = keys[i];
+                                     valueScratch[target] = values[i];
+                                 }
+                             } });
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
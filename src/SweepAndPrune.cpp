@@ -0,0 +1,446 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "RadixSort.h"
+#include "SimdPragmas.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // Smallest chunk of particles worth handing to another thread
+    const std::size_t PARALLEL_GRAIN = 32768;
+
+    // Insertion sort shifts allowed per entry before falling back to the radix sort
+    const std::size_t MOVES_PER_ENTRY = 4;
+
+    // Rebuild with the radix sort once more than one in this many entries is new
+    const std::size_t MAX_ENTERED_FRACTION = 8;
+
+    // Column grid: columns at least this many largest diameters wide (so
+    // most boxes fit into one column), at most one column per this many
+    // particles, at most 2^24 columns (the column takes the top bits of the
+    // radix sort key), and a margin of this fraction of the extent around
+    // the particles
+    const double COLUMN_DIAMETERS = 3.0;
+    const std::size_t PARTICLES_PER_COLUMN = 8;
+    const std::size_t MAX_COLUMNS = std::size_t(1) << 24;
+    const double GRID_MARGIN = 0.1;
+
+    // Bits of the quantized x extent in the radix sort key
+    const int LOWER_BITS = 40;
+
+    // Narrow phase candidates tested per vectorized batch
+    const std::size_t NARROW_BATCH = 64;
+
+    bool entryLess(std::uint32_t columnA, double lowerA, std::uint32_t columnB, double lowerB)
+    {
+        return columnA < columnB || (columnA == columnB && lowerA < lowerB);
+    }
+}
+
+// Column grid
+std::uint32_t SweepAndPrune::columnOf(double py, double pz) const
+{
+    const int cy = std::min(std::max(static_cast<int>((py - origin[0]) * inverseColumnSize), 0), dims[0] - 1);
+    const int cz = std::min(std::max(static_cast<int>((pz - origin[1]) * inverseColumnSize), 0), dims[1] - 1);
+    return static_cast<std::uint32_t>(cz) * static_cast<std::uint32_t>(dims[0]) + static_cast<std::uint32_t>(cy);
+}
+
+// Whether column `c` is one of the (up to four) columns of a box
+bool SweepAndPrune::inBox(std::uint32_t c, std::uint32_t first, unsigned char boxSpan) const
+{
+    const std::uint32_t d = c - first;
+    const std::uint32_t row = static_cast<std::uint32_t>(dims[0]);
+    return d == 0 || (d == 1 && (boxSpan & 1)) || (d == row && (boxSpan & 2)) || (d == row + 1 && boxSpan == 3);
+}
+
+// Keep the grid while it still covers every particle with columns at least
+// one diameter wide; otherwise fit a new one and return false
+bool SweepAndPrune::fitGrid(const ParticleSystem &system)
+{
+    const Vector3Array &positions = system.getPositions();
+    const std::size_t n = system.size();
+    double lo[2] = {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+    double hi[2] = {-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    double maxRadius = 0.0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        lo[0] = std::min(lo[0], static_cast<double>(positions.y[i]));
+        hi[0] = std::max(hi[0], static_cast<double>(positions.y[i]));
+        lo[1] = std::min(lo[1], static_cast<double>(positions.z[i]));
+        hi[1] = std::max(hi[1], static_cast<double>(positions.z[i]));
+        maxRadius = std::max(maxRadius, static_cast<double>(system.getRadius(i)));
+    }
+    if (n == 0)
+    {
+        lo[0] = lo[1] = hi[0] = hi[1] = 0.0;
+    }
+
+    const bool covered = columnSize > 0.0 && lo[0] >= origin[0] && lo[1] >= origin[1] &&
+                         hi[0] < origin[0] + dims[0] * columnSize && hi[1] < origin[1] + dims[1] * columnSize;
+    if (valid && covered && 2.0 * maxRadius <= columnSize)
+    {
+        return true;
+    }
+
+    const double margin = GRID_MARGIN * std::max(hi[0] - lo[0], hi[1] - lo[1]) + 2.0 * maxRadius;
+    const double extent[2] = {hi[0] - lo[0] + 2.0 * margin, hi[1] - lo[1] + 2.0 * margin};
+    const double columns = static_cast<double>(std::min(std::max<std::size_t>(n / PARTICLES_PER_COLUMN, 1), MAX_COLUMNS / 4));
+    columnSize = std::max(COLUMN_DIAMETERS * 2.0 * maxRadius, std::sqrt(extent[0] * extent[1] / columns));
+    if (!(columnSize > 0.0))
+    {
+        columnSize = 1.0;
+    }
+    inverseColumnSize = 1.0 / columnSize;
+    for (int a = 0; a < 2; a++)
+    {
+        origin[a] = lo[a] - margin;
+        dims[a] = static_cast<int>(extent[a] * inverseColumnSize) + 1;
+    }
+    return false;
+}
+
+// Boxes of every particle, keeping the columns of the previous update
+void SweepAndPrune::computeBoxes(const ParticleSystem &system)
+{
+    const Vector3Array &positions = system.getPositions();
+    const std::size_t n = system.size();
+    const bool keep = boxes.size() == n;
+    previousFirstColumn.resize(n);
+    previousSpan.resize(n);
+    boxes.resize(n);
+    const std::uint32_t row = static_cast<std::uint32_t>(dims[0]);
+    ThreadPool::global().parallelFor(0, n, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t i = begin; i < end; i++)
+                                         {
+                                             Box &box = boxes[i];
+                                             if (keep)
+                                             {
+                                                 previousFirstColumn[i] = box.firstColumn;
+                                                 previousSpan[i] = box.span;
+                                             }
+                                             box.x = positions.x[i];
+                                             box.y = positions.y[i];
+                                             box.z = positions.z[i];
+                                             box.radius = system.getRadius(i);
+                                             const std::uint32_t first = columnOf(box.y - box.radius, box.z - box.radius);
+                                             const std::uint32_t last = columnOf(box.y + box.radius, box.z + box.radius);
+                                             box.firstColumn = first;
+                                             box.span = static_cast<unsigned char>((last % row != first % row ? 1 : 0) | (last / row != first / row ? 2 : 0));
+                                         } },
+                                     PARALLEL_GRAIN);
+}
+
+// Entries
+SweepAndPrune::Entry SweepAndPrune::entry(std::size_t k) const
+{
+    return {particle[k], column[k], lower[k], x[k], y[k], z[k], radius[k]};
+}
+
+void SweepAndPrune::store(std::size_t k, const Entry &e)
+{
+    particle[k] = e.particle;
+    column[k] = e.column;
+    lower[k] = e.lower;
+    x[k] = e.x;
+    y[k] = e.y;
+    z[k] = e.z;
+    radius[k] = e.radius;
+}
+
+void SweepAndPrune::resize(std::size_t count)
+{
+    particle.resize(count);
+    column.resize(count);
+    lower.resize(count);
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+    kept.resize(count);
+}
+
+// Sort entries [0, count) by (column, lower) shifting entries down; gives
+// up once more than `budget` shifts were needed, leaving a permutation
+bool SweepAndPrune::insertionSort(std::size_t count, std::size_t budget)
+{
+    std::size_t moves = 0;
+    for (std::size_t k = 1; k < count; k++)
+    {
+        const std::uint32_t c = column[k];
+        const double l = lower[k];
+        if (!entryLess(c, l, column[k - 1], lower[k - 1]))
+        {
+            continue;
+        }
+        const Entry e = entry(k);
+        std::size_t j = k;
+        while (j > 0 && entryLess(c, l, column[j - 1], lower[j - 1]))
+        {
+            store(j, entry(j - 1));
+            j--;
+        }
+        store(j, e);
+        moves += k - j;
+        if (moves > budget)
+        {
+            statistics.moves += moves;
+            return false;
+        }
+    }
+    statistics.moves += moves;
+    return true;
+}
+
+// Bring the entries of the last update up to date: refresh the keys, drop
+// the entries of columns a particle left, insertion sort the rest (they
+// only drift within their column) and merge in sorted entries for the
+// columns particles entered. Returns false when too much changed for this
+// to pay off; the entries are then unusable and must be rebuilt.
+bool SweepAndPrune::refresh()
+{
+    const std::size_t count = particle.size();
+    const std::uint32_t row = static_cast<std::uint32_t>(dims[0]);
+
+    ThreadPool::global().parallelFor(0, count, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t k = begin; k < end; k++)
+                                         {
+                                             const Box &box = boxes[particle[k]];
+                                             kept[k] = inBox(column[k], box.firstColumn, box.span);
+                                             x[k] = box.x;
+                                             y[k] = box.y;
+                                             z[k] = box.z;
+                                             radius[k] = box.radius;
+                                             lower[k] = box.x - box.radius;
+                                         } },
+                                     PARALLEL_GRAIN);
+
+    entered.clear();
+    for (std::size_t i = 0; i < boxes.size(); i++)
+    {
+        const Box &box = boxes[i];
+        const std::uint32_t first = box.firstColumn, previous = previousFirstColumn[i];
+        if (first == previous && box.span == previousSpan[i])
+        {
+            continue;
+        }
+        const std::uint32_t columns[4] = {first, first + 1, first + row, first + row + 1};
+        for (const std::uint32_t c : columns)
+        {
+            if (inBox(c, first, box.span) && !inBox(c, previous, previousSpan[i]))
+            {
+                entered.push_back({static_cast<std::uint32_t>(i), c, box.x - box.radius, box.x, box.y, box.z, box.radius});
+            }
+        }
+        if (entered.size() > count / MAX_ENTERED_FRACTION)
+        {
+            return false;
+        }
+    }
+
+    std::size_t remaining = 0;
+    for (std::size_t k = 0; k < count; k++)
+    {
+        if (kept[k])
+        {
+            if (remaining != k)
+            {
+                store(remaining, entry(k));
+            }
+            remaining++;
+        }
+    }
+    if (!insertionSort(remaining, MOVES_PER_ENTRY * count))
+    {
+        return false;
+    }
+
+    // Merge from the back, so the remaining entries are moved at most once
+    std::sort(entered.begin(), entered.end(), [](const Entry &a, const Entry &b)
+              { return entryLess(a.column, a.lower, b.column, b.lower); });
+    resize(remaining + entered.size());
+    std::size_t k = remaining + entered.size(), m = entered.size();
+    while (m > 0)
+    {
+        const Entry &e = entered[m - 1];
+        if (remaining > 0 && entryLess(e.column, e.lower, column[remaining - 1], lower[remaining - 1]))
+        {
+            store(--k, entry(--remaining));
+        }
+        else
+        {
+            store(--k, e);
+            m--;
+        }
+    }
+    statistics.moves += entered.size();
+    return true;
+}
+
+// Entries of every particle's box from scratch, radix sorted by column and
+// quantized lower end, then insertion sorted within each quantum
+void SweepAndPrune::rebuild()
+{
+    const std::uint32_t row = static_cast<std::uint32_t>(dims[0]);
+    std::size_t count = 0;
+    for (const Box &box : boxes)
+    {
+        count += static_cast<std::size_t>(1 + (box.span & 1)) * (1 + (box.span >> 1));
+    }
+    resize(count);
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < boxes.size(); i++)
+    {
+        const Box &box = boxes[i];
+        const std::uint32_t first = box.firstColumn;
+        const std::uint32_t columns[4] = {first, first + 1, first + row, first + row + 1};
+        for (const std::uint32_t c : columns)
+        {
+            if (inBox(c, first, box.span))
+            {
+                store(k++, {static_cast<std::uint32_t>(i), c, box.x - box.radius, box.x, box.y, box.z, box.radius});
+            }
+        }
+        lo = std::min(lo, box.x - box.radius);
+        hi = std::max(hi, box.x - box.radius);
+    }
+
+    const double maxQuantum = static_cast<double>((std::uint64_t(1) << LOWER_BITS) - 1);
+    const double scale = hi > lo ? maxQuantum / (hi - lo) : 0.0;
+    keys.resize(count);
+    permutation.resize(count);
+    for (k = 0; k < count; k++)
+    {
+        const double q = std::min((lower[k] - lo) * scale, maxQuantum);
+        keys[k] = (static_cast<std::uint64_t>(column[k]) << LOWER_BITS) | static_cast<std::uint64_t>(q);
+        permutation[k] = static_cast<std::uint32_t>(k);
+    }
+    radixSort(keys, permutation);
+
+    auto apply = [&](auto &values)
+    {
+        auto copy = values;
+        for (std::size_t e = 0; e < count; e++)
+        {
+            values[e] = copy[permutation[e]];
+        }
+    };
+    apply(particle);
+    apply(column);
+    apply(lower);
+    apply(x);
+    apply(y);
+    apply(z);
+    apply(radius);
+    insertionSort(count, std::numeric_limits<std::size_t>::max());
+    statistics.fullSorts++;
+}
+
+void SweepAndPrune::update(const ParticleSystem &system)
+{
+    statistics.updates++;
+    const bool gridKept = fitGrid(system);
+    const bool incremental = valid && gridKept && boxes.size() == system.size() && layoutVersion == system.getLayoutVersion();
+    computeBoxes(system);
+    if (!incremental || !refresh())
+    {
+        rebuild();
+    }
+    valid = true;
+    layoutVersion = system.getLayoutVersion();
+
+    // Column ranges
+    const std::size_t columns = static_cast<std::size_t>(dims[0]) * dims[1];
+    columnStart.assign(columns + 1, 0);
+    for (const std::uint32_t c : column)
+    {
+        columnStart[c + 1]++;
+    }
+    for (std::size_t c = 0; c < columns; c++)
+    {
+        columnStart[c + 1] += columnStart[c];
+    }
+    statistics.entries = particle.size();
+    findContacts();
+}
+
+// Sweeps
+void SweepAndPrune::narrowPhase(std::size_t a, std::size_t begin, std::size_t end, std::uint32_t c, std::vector<CollisionPair> &out) const
+{
+    const double xa = x[a], ya = y[a], za = z[a], ra = radius[a];
+    const double *xs = x.data(), *ys = y.data(), *zs = z.data(), *rs = radius.data();
+    unsigned char hit[NARROW_BATCH];
+    for (std::size_t batch = begin; batch < end; batch += NARROW_BATCH)
+    {
+        const std::size_t count = std::min(NARROW_BATCH, end - batch);
+        ATOM_SIMD_LOOP()
+        for (std::size_t t = 0; t < count; t++)
+        {
+            const std::size_t b = batch + t;
+            const double dx = xa - xs[b];
+            const double dy = ya - ys[b];
+            const double dz = za - zs[b];
+            const double s = ra + rs[b];
+            hit[t] = dx * dx + dy * dy + dz * dz < s * s;
+        }
+        for (std::size_t t = 0; t < count; t++)
+        {
+            const std::size_t b = batch + t;
+            // Report a pair once: from the column of the lower corner of the boxes' intersection
+            if (hit[t] && columnOf(std::max(ya - ra, ys[b] - rs[b]), std::max(za - ra, zs[b] - rs[b])) == c)
+            {
+                out.push_back({particle[a], particle[b]});
+            }
+        }
+    }
+}
+
+// Each entry of column c against the later ones whose extent starts before its own ends
+void SweepAndPrune::sweep(std::uint32_t c, std::vector<CollisionPair> &out, std::size_t &candidates) const
+{
+    const std::size_t end = columnStart[c + 1];
+    for (std::size_t a = columnStart[c]; a < end; a++)
+    {
+        const double upper = lower[a] + 2.0 * radius[a];
+        std::size_t last = a + 1;
+        while (last < end && lower[last] <= upper)
+        {
+            last++;
+        }
+        candidates += last - a - 1;
+        narrowPhase(a, a + 1, last, c, out);
+    }
+}
+
+// Every column on its own, one block of contacts per z row
+void SweepAndPrune::findContacts()
+{
+    const std::size_t rows = static_cast<std::size_t>(dims[1]);
+    rowContacts.resize(rows);
+    rowCandidates.assign(rows, 0);
+    ThreadPool::global().parallelFor(0, rows, [&](std::size_t begin, std::size_t end)
+                                     {
+                                         for (std::size_t r = begin; r < end; r++)
+                                         {
+                                             rowContacts[r].clear();
+                                             for (std::size_t c = r * dims[0]; c < (r + 1) * dims[0]; c++)
+                                             {
+                                                 sweep(static_cast<std::uint32_t>(c), rowContacts[r], rowCandidates[r]);
+                                             }
+                                         } });
+
+    contacts.clear();
+    statistics.candidates = 0;
+    for (std::size_t r = 0; r < rows; r++)
+    {
+        contacts.insert(contacts.end(), rowContacts[r].begin(), rowContacts[r].end());
+        statistics.candidates += rowCandidates[r];
+    }
+    statistics.contacts = contacts.size();
+}
@@ -0,0 +1,199 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    // Pool and deque index of the calling thread when it is a worker
+    struct WorkerIdentity
+    {
+        const ThreadPool *pool = nullptr;
+        std::size_t index = 0;
+    };
+
+    thread_local WorkerIdentity currentWorker;
+
+    // ATOM_THREADS, or 0 (all hardware threads) when unset
+    std::size_t configuredThreadCount()
+    {
+        const char *threads = std::getenv("ATOM_THREADS");
+        return threads ? static_cast<std::size_t>(std::strtoul(threads, nullptr, 10)) : 0;
+    }
+}
+
+// Constructor
+ThreadPool::ThreadPool(std::size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::size_t workerCount = threadCount - 1;
+    for (std::size_t i = 0; i <= workerCount; i++)
+    {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+    workers.reserve(workerCount);
+    for (std::size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back([this, i]()
+                             { workerLoop(i); });
+    }
+}
+
+// Destructor
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::global()
+{
+    static ThreadPool pool(configuredThreadCount());
+    return pool;
+}
+
+void ThreadPool::submit(Task task)
+{
+    const bool isWorker = currentWorker.pool == this;
+    TaskQueue &queue = *queues[isWorker ? currentWorker.index : workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        // Taken so a worker between its empty check and its wait cannot miss the wake-up
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::pop(Task &task)
+{
+    if (queued.load(std::memory_order_acquire) == 0)
+    {
+        return false;
+    }
+    const bool isWorker = currentWorker.pool == this;
+    const std::size_t self = isWorker ? currentWorker.index : workers.size();
+
+    // Own deque from the back
+    if (isWorker)
+    {
+        TaskQueue &queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Steal from the front of the others, starting next to our own
+    for (std::size_t k = 1; k <= queues.size(); k++)
+    {
+        TaskQueue &queue = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task &task)
+{
+    try
+    {
+        task.work();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(task.group->errorMutex);
+        if (!task.group->error)
+        {
+            task.group->error = std::current_exception();
+        }
+    }
+    task.work = nullptr;
+    task.group->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+bool ThreadPool::runPendingTask()
+{
+    Task task;
+    if (!pop(task))
+    {
+        return false;
+    }
+    execute(task);
+    return true;
+}
+
+void ThreadPool::workerLoop(std::size_t index)
+{
+    currentWorker = WorkerIdentity{this, index};
+    for (;;)
+    {
+        if (runPendingTask())
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]()
+                  { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping && queued.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
+
+// Destructor
+TaskGroup::~TaskGroup()
+{
+    join();
+}
+
+void TaskGroup::join()
+{
+    // Help instead of blocking: the tasks we wait for, or tasks they are
+    // waiting for, may be queued behind us
+    while (pending.load(std::memory_order_acquire) > 0)
+    {
+        if (!pool.runPendingTask())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskGroup::wait()
+{
+    join();
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::swap(e, error);
+    }
+    if (e)
+    {
+        std::rethrow_exception(e);
+    }
+}
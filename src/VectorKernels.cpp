@@ -0,0 +1,282 @@
+#include "VectorKernelsImpl.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ATOM_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+const VectorKernelSet *scalarVectorKernels() { return kernelSet<ScalarOps<float>, ScalarOps<double>>(); }
+
+namespace
+{
+#if defined(ATOM_X86)
+    void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+    {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; i++)
+        {
+            regs[i] = static_cast<unsigned>(r[i]);
+        }
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // Register state the OS saves on context switch (XCR0)
+    unsigned long long xgetbv0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    }
+#endif
+
+    const VectorKernelSet *tableFor(SimdLevel level)
+    {
+        const VectorKernelSet *table = nullptr;
+        switch (level)
+        {
+        case SimdLevel::AVX512:
+            table = avx512VectorKernels();
+            break;
+        case SimdLevel::AVX2:
+            table = avx2VectorKernels();
+            break;
+        case SimdLevel::SSE2:
+            table = sse2VectorKernels();
+            break;
+        case SimdLevel::Scalar:
+            break;
+        }
+        return table ? table : scalarVectorKernels();
+    }
+
+    // Highest level that is both supported by the CPU and compiled into this binary
+    SimdLevel usableLevel(SimdLevel requested)
+    {
+        SimdLevel level = requested;
+        if (level > VectorKernels::detectSimdLevel())
+        {
+            level = VectorKernels::detectSimdLevel();
+        }
+        while (level != SimdLevel::Scalar && tableFor(level) == scalarVectorKernels())
+        {
+            level = static_cast<SimdLevel>(static_cast<int>(level) - 1);
+        }
+        return level;
+    }
+
+    struct Dispatch
+    {
+        std::atomic<SimdLevel> level;
+        std::atomic<const VectorKernelSet *> table;
+
+        Dispatch()
+        {
+            SimdLevel best = usableLevel(SimdLevel::AVX512);
+            level.store(best);
+            table.store(tableFor(best));
+        }
+    };
+
+    Dispatch &dispatch()
+    {
+        static Dispatch instance;
+        return instance;
+    }
+
+    template <typename T>
+    const VectorKernelTable<T> &kernels();
+
+    template <>
+    const VectorKernelTable<float> &kernels<float>()
+    {
+        return dispatch().table.load(std::memory_order_relaxed)->f32;
+    }
+
+    template <>
+    const VectorKernelTable<double> &kernels<double>()
+    {
+        return dispatch().table.load(std::memory_order_relaxed)->f64;
+    }
+
+    void checkSize(std::size_t expected, std::size_t actual)
+    {
+        if (expected != actual)
+        {
+            throw std::invalid_argument("Vector span sizes do not match.");
+        }
+    }
+
+    // Resolve the dispatch table during static initialization, so the CPUID
+    // probe happens once at startup rather than on the first hot-loop call
+    [[maybe_unused]] const bool dispatchInitialized = (dispatch(), true);
+
+    template <typename T>
+    using Span = BasicVector3Span<T>;
+
+    template <typename T>
+    using ConstSpan = BasicVector3Span<const T>;
+
+    template <typename T>
+    void addImpl(ConstSpan<T> a, ConstSpan<T> b, Span<T> out)
+    {
+        checkSize(out.size, a.size);
+        checkSize(out.size, b.size);
+        kernels<T>().add(a, b, out);
+    }
+
+    template <typename T>
+    void subImpl(ConstSpan<T> a, ConstSpan<T> b, Span<T> out)
+    {
+        checkSize(out.size, a.size);
+        checkSize(out.size, b.size);
+        kernels<T>().sub(a, b, out);
+    }
+
+    template <typename T>
+    void scaleImpl(ConstSpan<T> a, T s, Span<T> out)
+    {
+        checkSize(out.size, a.size);
+        kernels<T>().scale(a, s, out);
+    }
+
+    template <typename T>
+    void axpyImpl(T alpha, ConstSpan<T> x, Span<T> y)
+    {
+        checkSize(y.size, x.size);
+        kernels<T>().axpy(alpha, x, y);
+    }
+
+    template <typename T>
+    void dotImpl(ConstSpan<T> a, ConstSpan<T> b, T *out)
+    {
+        checkSize(a.size, b.size);
+        kernels<T>().dot(a, b, out);
+    }
+
+    template <typename T>
+    void crossImpl(ConstSpan<T> a, ConstSpan<T> b, Span<T> out)
+    {
+        checkSize(out.size, a.size);
+        checkSize(out.size, b.size);
+        kernels<T>().cross(a, b, out);
+    }
+
+    template <typename T>
+    void normalizeImpl(ConstSpan<T> a, Span<T> out)
+    {
+        checkSize(out.size, a.size);
+        kernels<T>().normalize(a, out);
+    }
+}
+
+namespace VectorKernels
+{
+    void add(ConstSpan<float> a, ConstSpan<float> b, Span<float> out) { addImpl<float>(a, b, out); }
+    void add(ConstSpan<double> a, ConstSpan<double> b, Span<double> out) { addImpl<double>(a, b, out); }
+
+    void sub(ConstSpan<float> a, ConstSpan<float> b, Span<float> out) { subImpl<float>(a, b, out); }
+    void sub(ConstSpan<double> a, ConstSpan<double> b, Span<double> out) { subImpl<double>(a, b, out); }
+
+    void scale(ConstSpan<float> a, float s, Span<float> out) { scaleImpl<float>(a, s, out); }
+    void scale(ConstSpan<double> a, double s, Span<double> out) { scaleImpl<double>(a, s, out); }
+
+    void axpy(float alpha, ConstSpan<float> x, Span<float> y) { axpyImpl<float>(alpha, x, y); }
+    void axpy(double alpha, ConstSpan<double> x, Span<double> y) { axpyImpl<double>(alpha, x, y); }
+
+    void dot(ConstSpan<float> a, ConstSpan<float> b, float *out) { dotImpl<float>(a, b, out); }
+    void dot(ConstSpan<double> a, ConstSpan<double> b, double *out) { dotImpl<double>(a, b, out); }
+
+    void cross(ConstSpan<float> a, ConstSpan<float> b, Span<float> out) { crossImpl<float>(a, b, out); }
+    void cross(ConstSpan<double> a, ConstSpan<double> b, Span<double> out) { crossImpl<double>(a, b, out); }
+
+    void magnitude(ConstSpan<float> a, float *out) { kernels<float>().magnitude(a, out); }
+    void magnitude(ConstSpan<double> a, double *out) { kernels<double>().magnitude(a, out); }
+
+    void normalize(ConstSpan<float> a, Span<float> out) { normalizeImpl<float>(a, out); }
+    void normalize(ConstSpan<double> a, Span<double> out) { normalizeImpl<double>(a, out); }
+
+    SimdLevel detectSimdLevel()
+    {
+#if defined(ATOM_X86)
+        unsigned regs[4];
+        cpuid(0, 0, regs);
+        const unsigned maxLeaf = regs[0];
+
+        cpuid(1, 0, regs);
+        const unsigned ecx1 = regs[2];
+        const unsigned edx1 = regs[3];
+        if (!(edx1 & (1u << 26)))
+        {
+            return SimdLevel::Scalar;
+        }
+
+        const bool osxsave = ecx1 & (1u << 27);
+        const bool avx = ecx1 & (1u << 28);
+        const bool fma = ecx1 & (1u << 12);
+        if (!osxsave || !avx || !fma || maxLeaf < 7)
+        {
+            return SimdLevel::SSE2;
+        }
+
+        // The OS must save YMM (bits 1-2) and, for AVX-512, opmask/ZMM state (bits 5-7)
+        const unsigned long long xcr0 = xgetbv0();
+        cpuid(7, 0, regs);
+        const unsigned ebx7 = regs[1];
+        if ((xcr0 & 0x6) != 0x6 || !(ebx7 & (1u << 5)))
+        {
+            return SimdLevel::SSE2;
+        }
+        if ((xcr0 & 0xE6) != 0xE6 || !(ebx7 & (1u << 16)))
+        {
+            return SimdLevel::AVX2;
+        }
+        return SimdLevel::AVX512;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    SimdLevel activeSimdLevel()
+    {
+        return dispatch().level.load();
+    }
+
+    SimdLevel setSimdLevel(SimdLevel level)
+    {
+        SimdLevel usable = usableLevel(level);
+        dispatch().level.store(usable);
+        dispatch().table.store(tableFor(usable));
+        return usable;
+    }
+
+    const char *simdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::Scalar:
+            return "scalar";
+        case SimdLevel::SSE2:
+            return "SSE2";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        }
+        return "unknown";
+    }
+}
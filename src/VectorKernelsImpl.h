@@ -0,0 +1,188 @@
+#pragma once
+
+// Internal to the VectorKernels*.cpp translation units.
+//
+// The kernels are written once against a small "Ops" interface and
+// instantiated per instruction set in a translation unit compiled with the
+// matching flags. Everything here lives in an anonymous namespace so that
+// code generated with e.g. AVX2 enabled can never be picked by the linker
+// for a translation unit that must run on a plain SSE2 host. That includes
+// the inline functions of the standard headers: an unoptimized build emits
+// them as weak symbols compiled with this file's flags, and the linker may
+// keep that copy for the whole program. Call the C library instead.
+
+#include <math.h>
+#include <cstddef>
+#include "VectorKernels.h"
+
+// Per-instruction-set tables, nullptr when the ISA was not compiled in
+const VectorKernelSet *scalarVectorKernels();
+const VectorKernelSet *sse2VectorKernels();
+const VectorKernelSet *avx2VectorKernels();
+const VectorKernelSet *avx512VectorKernels();
+
+namespace
+{
+    // Out-of-line libm calls rather than the inline std::sqrt overloads
+    inline float scalarSqrt(float a) { return ::sqrtf(a); }
+    inline double scalarSqrt(double a) { return ::sqrt(a); }
+
+    // One lane, used as the fallback and for loop remainders
+    template <typename T>
+    struct ScalarOps
+    {
+        using Scalar = T;
+        using Vec = T;
+        static constexpr std::size_t width = 1;
+
+        static Vec load(const T *p) { return *p; }
+        static void store(T *p, Vec v) { *p = v; }
+        static Vec set1(T s) { return s; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return a * b + c; }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return a * b - c; }
+        static Vec sqrt(Vec a) { return scalarSqrt(a); }
+        static Vec invOrZero(Vec a) { return a > T(0) ? T(1) / a : T(0); }
+    };
+
+    template <typename Ops>
+    struct OpsTag
+    {
+        using type = Ops;
+    };
+
+    // Run `body(OpsTag<Ops>, i)` over full vectors, then the remainder one lane at a time
+    template <typename Ops, typename Body>
+    void forEachLane(std::size_t n, Body &&body)
+    {
+        std::size_t i = 0;
+        for (; i + Ops::width <= n; i += Ops::width)
+        {
+            body(OpsTag<Ops>(), i);
+        }
+        for (; i < n; i++)
+        {
+            body(OpsTag<ScalarOps<typename Ops::Scalar>>(), i);
+        }
+    }
+
+    template <typename Ops>
+    struct BatchKernels
+    {
+        using T = typename Ops::Scalar;
+        using Span = BasicVector3Span<T>;
+        using ConstSpan = BasicVector3Span<const T>;
+
+        static void add(ConstSpan a, ConstSpan b, Span out)
+        {
+            forEachLane<Ops>(out.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                O::store(out.x + i, O::add(O::load(a.x + i), O::load(b.x + i)));
+                O::store(out.y + i, O::add(O::load(a.y + i), O::load(b.y + i)));
+                O::store(out.z + i, O::add(O::load(a.z + i), O::load(b.z + i)));
+            });
+        }
+
+        static void sub(ConstSpan a, ConstSpan b, Span out)
+        {
+            forEachLane<Ops>(out.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                O::store(out.x + i, O::sub(O::load(a.x + i), O::load(b.x + i)));
+                O::store(out.y + i, O::sub(O::load(a.y + i), O::load(b.y + i)));
+                O::store(out.z + i, O::sub(O::load(a.z + i), O::load(b.z + i)));
+            });
+        }
+
+        static void scale(ConstSpan a, T s, Span out)
+        {
+            forEachLane<Ops>(out.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                const auto vs = O::set1(s);
+                O::store(out.x + i, O::mul(O::load(a.x + i), vs));
+                O::store(out.y + i, O::mul(O::load(a.y + i), vs));
+                O::store(out.z + i, O::mul(O::load(a.z + i), vs));
+            });
+        }
+
+        static void axpy(T alpha, ConstSpan x, Span y)
+        {
+            forEachLane<Ops>(y.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                const auto va = O::set1(alpha);
+                O::store(y.x + i, O::fmadd(va, O::load(x.x + i), O::load(y.x + i)));
+                O::store(y.y + i, O::fmadd(va, O::load(x.y + i), O::load(y.y + i)));
+                O::store(y.z + i, O::fmadd(va, O::load(x.z + i), O::load(y.z + i)));
+            });
+        }
+
+        static void dot(ConstSpan a, ConstSpan b, T *out)
+        {
+            forEachLane<Ops>(a.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                auto d = O::mul(O::load(a.x + i), O::load(b.x + i));
+                d = O::fmadd(O::load(a.y + i), O::load(b.y + i), d);
+                d = O::fmadd(O::load(a.z + i), O::load(b.z + i), d);
+                O::store(out + i, d);
+            });
+        }
+
+        static void cross(ConstSpan a, ConstSpan b, Span out)
+        {
+            forEachLane<Ops>(out.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                const auto ax = O::load(a.x + i), ay = O::load(a.y + i), az = O::load(a.z + i);
+                const auto bx = O::load(b.x + i), by = O::load(b.y + i), bz = O::load(b.z + i);
+                const auto cx = O::fmsub(ay, bz, O::mul(az, by));
+                const auto cy = O::fmsub(az, bx, O::mul(ax, bz));
+                const auto cz = O::fmsub(ax, by, O::mul(ay, bx));
+                O::store(out.x + i, cx);
+                O::store(out.y + i, cy);
+                O::store(out.z + i, cz);
+            });
+        }
+
+        static void magnitude(ConstSpan a, T *out)
+        {
+            forEachLane<Ops>(a.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                const auto ax = O::load(a.x + i), ay = O::load(a.y + i), az = O::load(a.z + i);
+                O::store(out + i, O::sqrt(O::fmadd(az, az, O::fmadd(ay, ay, O::mul(ax, ax)))));
+            });
+        }
+
+        static void normalize(ConstSpan a, Span out)
+        {
+            forEachLane<Ops>(out.size, [&](auto tag, std::size_t i)
+            {
+                using O = typename decltype(tag)::type;
+                const auto ax = O::load(a.x + i), ay = O::load(a.y + i), az = O::load(a.z + i);
+                const auto inv = O::invOrZero(O::sqrt(O::fmadd(az, az, O::fmadd(ay, ay, O::mul(ax, ax)))));
+                O::store(out.x + i, O::mul(ax, inv));
+                O::store(out.y + i, O::mul(ay, inv));
+                O::store(out.z + i, O::mul(az, inv));
+            });
+        }
+
+        static VectorKernelTable<T> table()
+        {
+            return {&add, &sub, &scale, &axpy, &dot, &cross, &magnitude, &normalize};
+        }
+    };
+
+    // Float and double kernels for one instruction set
+    template <typename FloatOps, typename DoubleOps>
+    const VectorKernelSet *kernelSet()
+    {
+        static const VectorKernelSet kernels = {BatchKernels<FloatOps>::table(), BatchKernels<DoubleOps>::table()};
+        return &kernels;
+    }
+}
@@ -0,0 +1,62 @@
+// Compiled with -mavx2 -mfma
+#include "VectorKernelsImpl.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx2FloatOps
+    {
+        using Scalar = float;
+        using Vec = __m256;
+        static constexpr std::size_t width = 8;
+
+        static Vec load(const float *p) { return _mm256_loadu_ps(p); }
+        static void store(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm256_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm256_fmsub_ps(a, b, c); }
+        static Vec sqrt(Vec a) { return _mm256_sqrt_ps(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const Vec positive = _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ);
+            return _mm256_and_ps(positive, _mm256_div_ps(_mm256_set1_ps(1.0f), a));
+        }
+    };
+
+    struct Avx2DoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m256d;
+        static constexpr std::size_t width = 4;
+
+        static Vec load(const double *p) { return _mm256_loadu_pd(p); }
+        static void store(double *p, Vec v) { _mm256_storeu_pd(p, v); }
+        static Vec set1(double s) { return _mm256_set1_pd(s); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm256_fmsub_pd(a, b, c); }
+        static Vec sqrt(Vec a) { return _mm256_sqrt_pd(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const Vec positive = _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ);
+            return _mm256_and_pd(positive, _mm256_div_pd(_mm256_set1_pd(1.0), a));
+        }
+    };
+}
+
+const VectorKernelSet *avx2VectorKernels() { return kernelSet<Avx2FloatOps, Avx2DoubleOps>(); }
+
+#else
+
+const VectorKernelSet *avx2VectorKernels() { return nullptr; }
+
+#endif
@@ -0,0 +1,62 @@
+// Compiled with -mavx512f -mfma
+#include "VectorKernelsImpl.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx512FloatOps
+    {
+        using Scalar = float;
+        using Vec = __m512;
+        static constexpr std::size_t width = 16;
+
+        static Vec load(const float *p) { return _mm512_loadu_ps(p); }
+        static void store(float *p, Vec v) { _mm512_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm512_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm512_fmsub_ps(a, b, c); }
+        static Vec sqrt(Vec a) { return _mm512_sqrt_ps(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const __mmask16 positive = _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ);
+            return _mm512_maskz_div_ps(positive, _mm512_set1_ps(1.0f), a);
+        }
+    };
+
+    struct Avx512DoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m512d;
+        static constexpr std::size_t width = 8;
+
+        static Vec load(const double *p) { return _mm512_loadu_pd(p); }
+        static void store(double *p, Vec v) { _mm512_storeu_pd(p, v); }
+        static Vec set1(double s) { return _mm512_set1_pd(s); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm512_fmsub_pd(a, b, c); }
+        static Vec sqrt(Vec a) { return _mm512_sqrt_pd(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const __mmask8 positive = _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_GT_OQ);
+            return _mm512_maskz_div_pd(positive, _mm512_set1_pd(1.0), a);
+        }
+    };
+}
+
+const VectorKernelSet *avx512VectorKernels() { return kernelSet<Avx512FloatOps, Avx512DoubleOps>(); }
+
+#else
+
+const VectorKernelSet *avx512VectorKernels() { return nullptr; }
+
+#endif
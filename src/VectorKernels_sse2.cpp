@@ -0,0 +1,62 @@
+// Compiled with -msse2 (baseline on x86-64)
+#include "VectorKernelsImpl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace
+{
+    struct Sse2FloatOps
+    {
+        using Scalar = float;
+        using Vec = __m128;
+        static constexpr std::size_t width = 4;
+
+        static Vec load(const float *p) { return _mm_loadu_ps(p); }
+        static void store(float *p, Vec v) { _mm_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm_sub_ps(_mm_mul_ps(a, b), c); }
+        static Vec sqrt(Vec a) { return _mm_sqrt_ps(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const Vec positive = _mm_cmpgt_ps(a, _mm_setzero_ps());
+            return _mm_and_ps(positive, _mm_div_ps(_mm_set1_ps(1.0f), a));
+        }
+    };
+
+    struct Sse2DoubleOps
+    {
+        using Scalar = double;
+        using Vec = __m128d;
+        static constexpr std::size_t width = 2;
+
+        static Vec load(const double *p) { return _mm_loadu_pd(p); }
+        static void store(double *p, Vec v) { _mm_storeu_pd(p, v); }
+        static Vec set1(double s) { return _mm_set1_pd(s); }
+        static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static Vec fmsub(Vec a, Vec b, Vec c) { return _mm_sub_pd(_mm_mul_pd(a, b), c); }
+        static Vec sqrt(Vec a) { return _mm_sqrt_pd(a); }
+
+        static Vec invOrZero(Vec a)
+        {
+            const Vec positive = _mm_cmpgt_pd(a, _mm_setzero_pd());
+            return _mm_and_pd(positive, _mm_div_pd(_mm_set1_pd(1.0), a));
+        }
+    };
+}
+
+const VectorKernelSet *sse2VectorKernels() { return kernelSet<Sse2FloatOps, Sse2DoubleOps>(); }
+
+#else
+
+const VectorKernelSet *sse2VectorKernels() { return nullptr; }
+
+#endif